@@ -0,0 +1,108 @@
+#pragma once
+
+#include <algorithm>
+#include <functional>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <easy/reader.h>
+
+/*
+	An easy_profiler capture loaded into block trees with easy_profiler's reader, for the tools that analyze captures offline.
+	Timestamps and durations are nanoseconds. Linking against easy_profiler or the in-tree ProfilerBackend is needed for the reader.
+*/
+
+struct Capture
+{
+	std::string path;
+	profiler::BeginEndTime range = { 0, 0 };
+	profiler::SerializedData blocksData;
+	profiler::SerializedData descriptorsData;
+	profiler::descriptors_list_t descriptors;
+	profiler::blocks_t blocks;
+	profiler::thread_blocks_tree_t threads;
+	profiler::bookmarks_t bookmarks;
+	uint32_t descriptorsCount = 0;
+	uint32_t version = 0;
+	profiler::processid_t pid = 0;
+
+	const profiler::SerializedBlockDescriptor* Descriptor(const profiler::BlocksTree& tree) const
+	{
+		const profiler::block_id_t id = tree.node->id();
+		return id < descriptors.size() ? descriptors[id] : nullptr;
+	}
+
+	profiler::BlockType Type(const profiler::BlocksTree& tree) const
+	{
+		const profiler::SerializedBlockDescriptor* descriptor = Descriptor(tree);
+		return descriptor ? descriptor->type() : profiler::BlockType::Block;
+	}
+
+	// Run-time name if the block has one, the name it was declared with otherwise.
+	std::string Name(const profiler::BlocksTree& tree) const
+	{
+		if (Type(tree) != profiler::BlockType::Value && tree.node->name()[0]) return tree.node->name();
+		const profiler::SerializedBlockDescriptor* descriptor = Descriptor(tree);
+		return descriptor ? descriptor->name() : "Unknown block " + std::to_string(tree.node->id());
+	}
+
+	std::string ThreadName(const profiler::BlocksTreeRoot& root) const
+	{
+		return root.got_name() ? root.thread_name : "Thread " + std::to_string(root.thread_id);
+	}
+
+	// Threads ordered by id, the map they're loaded into has no order.
+	std::vector<const profiler::BlocksTreeRoot*> SortedThreads() const
+	{
+		std::vector<const profiler::BlocksTreeRoot*> sorted;
+		for (const auto& [id, root] : threads) sorted.push_back(&root);
+		std::sort(sorted.begin(), sorted.end(), [](const profiler::BlocksTreeRoot* a, const profiler::BlocksTreeRoot* b) { return a->thread_id < b->thread_id; });
+		return sorted;
+	}
+
+	// Calls visit(index, depth) on every block, event and value of a thread, parents before their children.
+	void Walk(const profiler::BlocksTreeRoot& root, const std::function<void(profiler::block_index_t index, size_t depth)>& visit) const
+	{
+		std::vector<std::pair<profiler::block_index_t, size_t>> stack;
+		for (auto child = root.children.rbegin(); child != root.children.rend(); ++child) stack.emplace_back(*child, 0);
+		while (!stack.empty())
+		{
+			const auto [index, depth] = stack.back();
+			stack.pop_back();
+			visit(index, depth);
+			const profiler::BlocksTree& tree = blocks[index];
+			for (auto child = tree.children.rbegin(); child != tree.children.rend(); ++child) stack.emplace_back(*child, depth + 1);
+		}
+	}
+
+	// Durations in nanoseconds of the blocks of every thread, by name. Events and values aren't timed, they're left out.
+	std::map<std::string, std::vector<double>> DurationsByName() const
+	{
+		std::map<std::string, std::vector<double>> durations;
+		for (const auto& [id, root] : threads)
+		{
+			Walk(root, [&](const profiler::block_index_t index, size_t)
+			{
+				const profiler::BlocksTree& tree = blocks[index];
+				if (Type(tree) == profiler::BlockType::Block) durations[Name(tree)].push_back((double)tree.node->duration());
+			});
+		}
+		return durations;
+	}
+};
+
+// Throws std::runtime_error with the reader's explanation if the capture can't be loaded.
+inline std::unique_ptr<Capture> LoadCapture(const std::string& path, const bool gatherStatistics = true)
+{
+	std::unique_ptr<Capture> capture = std::make_unique<Capture>();
+	capture->path = path;
+	std::ostringstream log;
+	const profiler::block_index_t count = fillTreesFromFile(path.c_str(), capture->range, capture->blocksData, capture->descriptorsData, capture->descriptors, capture->blocks, capture->threads,
+		capture->bookmarks, capture->descriptorsCount, capture->version, capture->pid, gatherStatistics, log);
+	if (count == 0) throw std::runtime_error("Can't load \"" + path + "\": " + (log.str().empty() ? std::string("no blocks") : log.str()) + ".");
+	return capture;
+}
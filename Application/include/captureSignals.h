@@ -0,0 +1,112 @@
+#pragma once
+
+#include <functional>
+#include <thread>
+
+#if defined(__linux__)
+#include <cerrno>
+#include <csignal>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+/*
+	Capture windows driven by signals, to profile a long-running process only once something looks slow: "kill -USR1 <pid>" toggles capturing, "kill -USR2 <pid>" writes the capture.
+	The handlers only write the signal number to a pipe, one of the few things allowed in a signal handler; a helper thread reads the pipe and does the actual work,
+	which takes locks, allocates and writes files.
+	A single instance at a time, Linux only: elsewhere Installed() is false.
+*/
+class CaptureSignals
+{
+public:
+	CaptureSignals(std::function<void()> toggle, std::function<void()> dump) : toggle_(std::move(toggle)), dump_(std::move(dump))
+	{
+#if defined(__linux__)
+		int fds[2];
+		if (pipe2(fds, O_CLOEXEC) != 0) return;
+		if (fcntl(fds[1], F_SETFL, O_NONBLOCK) != 0) // Only the handler's end: a burst of signals can't block the interrupted thread, the helper still waits on a blocking read.
+		{
+			close(fds[0]);
+			close(fds[1]);
+			return;
+		}
+		readFd_ = fds[0];
+		WriteFd() = fds[1];
+		struct sigaction action = {};
+		action.sa_handler = &CaptureSignals::Handler;
+		sigemptyset(&action.sa_mask);
+		action.sa_flags = SA_RESTART; // The workers' blocking calls don't fail with EINTR because of a capture.
+		sigaction(SIGUSR1, &action, &previousUsr1_);
+		sigaction(SIGUSR2, &action, &previousUsr2_);
+		helper_ = std::thread(&CaptureSignals::Run, this);
+#endif
+	}
+
+	~CaptureSignals()
+	{
+#if defined(__linux__)
+		if (!helper_.joinable()) return;
+		sigaction(SIGUSR1, &previousUsr1_, nullptr);
+		sigaction(SIGUSR2, &previousUsr2_, nullptr);
+		const char stop = 0;
+		while (write(WriteFd(), &stop, 1) < 0 && (errno == EINTR || errno == EAGAIN)) std::this_thread::yield(); // A full pipe gets drained by the helper.
+		helper_.join();
+		close(readFd_);
+		close(WriteFd());
+		WriteFd() = -1;
+#endif
+	}
+
+	CaptureSignals(const CaptureSignals&) = delete;
+	CaptureSignals& operator=(const CaptureSignals&) = delete;
+
+	bool Installed() const { return helper_.joinable(); }
+
+	// What to send the signals to.
+	static long ProcessId()
+	{
+#if defined(__linux__)
+		return (long)getpid();
+#else
+		return 0;
+#endif
+	}
+
+private:
+#if defined(__linux__)
+	// Where the handler writes, static since a handler has no other way to find it.
+	static int& WriteFd()
+	{
+		static int fd = -1;
+		return fd;
+	}
+
+	static void Handler(const int signal)
+	{
+		const int savedErrno = errno; // write() may change it under the interrupted code's feet.
+		const char number = (char)signal;
+		if (WriteFd() >= 0) (void)!write(WriteFd(), &number, 1); // Async-signal-safe. A full pipe drops the signal with EAGAIN, as a signal already pending would be.
+		errno = savedErrno;
+	}
+
+	void Run()
+	{
+		char number = 0;
+		for (;;)
+		{
+			const ssize_t got = read(readFd_, &number, 1);
+			if (got < 0 && errno == EINTR) continue;
+			if (got <= 0 || number == 0) return;
+			if (number == SIGUSR1) toggle_();
+			else if (number == SIGUSR2) dump_();
+		}
+	}
+
+	int readFd_ = -1;
+	struct sigaction previousUsr1_ = {};
+	struct sigaction previousUsr2_ = {};
+#endif
+	std::function<void()> toggle_;
+	std::function<void()> dump_;
+	std::thread helper_;
+};
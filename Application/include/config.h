@@ -0,0 +1,302 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <algorithm>
+#include <cmath>
+#include <functional>
+
+#include "sampler.h"
+#include "topology.h"
+#include "workerCount.h"
+
+/*
+	Run-time configuration of the benchmark driver.
+	Every setting can be given on the command line as "--name=value" or "--name value", or in a config file passed with "--config <file>" holding one "name = value" per line.
+	Lists are comma separated and numbers accept scientific notation, ex: --iterations=1e6,1e7 --workers=1,2,4
+	Command line settings win over the config file's, whatever their order.
+*/
+
+#if USE_WORKING_IMPLEMENTATION
+constexpr const char* DEFAULT_IMPLEMENTATION = "working";
+#else
+constexpr const char* DEFAULT_IMPLEMENTATION = "exercise";
+#endif // USE_WORKING_IMPLEMENTATION
+
+// The only random engine and hit test the strategies are written with. Listed so that configurations and results can name them explicitly.
+constexpr const char* AVAILABLE_ENGINES[] = { "default_random_engine" };
+constexpr const char* AVAILABLE_KERNELS[] = { "magnitude" };
+
+struct BenchmarkConfig
+{
+	std::vector<size_t> iterations = { 1000000 }; // How many iterations we'll go through before returning an approximation of PI.
+	std::vector<size_t> workers = { DefaultWorkerCount() }; // Number of worker threads of the multithreaded strategies.
+	std::vector<std::string> implementations = { DEFAULT_IMPLEMENTATION }; // "working", "exercise" or both.
+	std::vector<std::string> strategies = { "SingleThread", "Async", "Threads" };
+	std::vector<std::string> engines = { AVAILABLE_ENGINES[0] };
+	std::vector<std::string> kernels = { AVAILABLE_KERNELS[0] };
+	size_t warmups = 1; // Unrecorded runs of each combination before the measured ones.
+	size_t repetitions = 5; // How many times each combination is measured.
+	PlacementPolicy placement = PlacementPolicy::OsDefault;
+	bool counters = true; // Whether to read the hardware performance counters of every strategy and worker.
+	size_t precisionDigits = 4; // Time-to-precision is reported for a 95% confidence interval of +-10^-precisionDigits.
+	double targetHalfWidth = 0.0; // If set, Async and Threads stop as soon as the 95% confidence interval of PI is this narrow, the iterations become a cap.
+	size_t valueIntervalMs = 50; // When built with easy_profiler, how often workers record their progress as arbitrary values, 0 for never.
+	size_t monitorIntervalMs = 0; // If set, stream the running estimate of Async and Threads every that many milliseconds.
+	std::string monitorOutput = "-"; // File the stream gets written to, "-" for stdout.
+	bool streamCapture = false; // With easy_profiler, flush the capture to disk as the run goes rather than keeping it in memory until the end.
+	bool signalCapture = false; // With easy_profiler, capture only between two SIGUSR1 and write the capture on SIGUSR2 rather than capturing the whole run.
+	size_t captureMemoryMb = 64; // Hard cap on the memory a streamed capture buffers, records beyond it are dropped and counted.
+	size_t flushIntervalMs = 200; // How often a streamed capture gets flushed.
+	bool contextSwitches = true; // With easy_profiler, record when every thread gets switched out and why: perf_event_open on Linux, ETW with easy_profiler's library on Windows.
+	size_t listenPort = 0; // With easy_profiler, listen for capture clients on that port instead of capturing the whole run, 0 for off.
+	std::string listenAddress = "127.0.0.1"; // Interface the capture clients connect to, others can only be listened on when asked for explicitly.
+	size_t samplingHz = 0; // If set, sample the stacks of the main thread and of the workers that many times per second of cpu time and write them as folded stacks, 0 for off.
+	bool help = false;
+};
+
+inline const char* ConfigUsage()
+{
+	return
+		"Usage: Application [--name=value ...]\n"
+		"  --config=<file>          Read settings from a file of \"name = value\" lines ('#' starts a comment).\n"
+		"  --iterations=<n,...>     Samples drawn per approximation (default 1e6).\n"
+		"  --workers=<n,...>        Worker threads of Async and Threads (default: detected CPU budget).\n"
+		"  --implementations=<...>  working, exercise (default: the USE_WORKING_IMPLEMENTATION CMake option).\n"
+		"  --strategies=<...>       SingleThread, Async, Threads (default: all).\n"
+		"  --engines=<...>          default_random_engine.\n"
+		"  --kernels=<...>          magnitude.\n"
+		"  --warmups=<n>            Unrecorded runs of every combination before measuring it, 0 for none (default 1).\n"
+		"  --repetitions=<n>        Measured runs of every combination (default 5).\n"
+		"  --placement=<policy>     os, compact, scatter, physical, isolated (default os).\n"
+		"  --counters=<on|off>      Hardware performance counters per strategy and per worker, Linux only (default on).\n"
+		"  --precision=<digits>     Report the time needed to reach +-1e-<digits> at 95% confidence (default 4).\n"
+		"  --target=<half width>    Stop Async and Threads as soon as PI is known to +-<half width> at 95% confidence, ex: 1e-3. Iterations become a cap (default: off).\n"
+		"  --values=<ms>            With easy_profiler, record every worker's hits, samples and throughput every <ms> milliseconds, 0 for never (default 50).\n"
+		"  --monitor=<ms>           Stream the running estimate of Async and Threads as CSV every <ms> milliseconds, 0 for none (default 0).\n"
+		"  --monitor-output=<file>  Where the stream goes, - for stdout where it interleaves with the report (default -).\n"
+		"  --capture=<mode>         With easy_profiler, end: dump the capture at the end of the run, stream: stream it to disk as it goes (in-tree backend only),\n"
+		"                           signal: capture on demand, SIGUSR1 starts or stops capturing and SIGUSR2 writes the capture (Linux only) (default end).\n"
+		"  --capture-memory=<MB>    Memory a streamed capture may buffer, records beyond are dropped and counted (default 64).\n"
+		"  --flush=<ms>             How often a streamed capture is flushed to disk (default 200).\n"
+		"  --cswitches=<on|off>     With easy_profiler, record when every thread was switched out and why (preempted or waiting) on the capture's timeline (default on).\n"
+		"  --listen=[<address>:]<port|on|off>\n"
+		"                           With easy_profiler, let CaptureClient or the GUI start and stop captures over the network instead of capturing the whole run, on = 28077 (default off).\n"
+		"                           Only local clients can connect unless an address is given, 0.0.0.0 for every interface.\n"
+		"  --sampling=<Hz|on|off>   Sample the stacks of the strategies' threads and write them as folded stacks for flame graphs, Linux only, on = 997 Hz (default off).\n"
+		"  --help                   Print this message.\n";
+}
+
+inline std::vector<std::string> SplitList(const std::string& value)
+{
+	std::vector<std::string> items;
+	std::stringstream ss(value);
+	std::string item;
+	while (std::getline(ss, item, ','))
+	{
+		item.erase(0, item.find_first_not_of(" \t"));
+		item.erase(item.find_last_not_of(" \t") + 1);
+		if (!item.empty()) items.push_back(item);
+	}
+	return items;
+}
+
+// Parses a positive count, accepting scientific notation since iteration counts tend to have a lot of zeroes.
+inline size_t ParseCount(const std::string& name, const std::string& value)
+{
+	size_t consumed = 0;
+	double parsed = 0.0;
+	try
+	{
+		parsed = std::stod(value, &consumed);
+	}
+	catch (const std::exception&)
+	{
+		consumed = 0;
+	}
+	if (consumed != value.size() || parsed < 1.0 || parsed != std::floor(parsed) || parsed > 1e18)
+	{
+		throw std::invalid_argument("--" + name + " expects positive whole numbers, got \"" + value + "\".");
+	}
+	return (size_t)parsed;
+}
+
+inline double ParsePositiveNumber(const std::string& name, const std::string& value)
+{
+	size_t consumed = 0;
+	double parsed = 0.0;
+	try
+	{
+		parsed = std::stod(value, &consumed);
+	}
+	catch (const std::exception&)
+	{
+		consumed = 0;
+	}
+	if (consumed != value.size() || !(parsed > 0.0) || !std::isfinite(parsed)) throw std::invalid_argument("--" + name + " expects a positive number, got \"" + value + "\".");
+	return parsed;
+}
+
+inline PlacementPolicy ParsePlacement(const std::string& value)
+{
+	for (const PlacementPolicy policy : { PlacementPolicy::OsDefault, PlacementPolicy::Compact, PlacementPolicy::Scatter, PlacementPolicy::PhysicalCoresFirst, PlacementPolicy::IsolatedOnly })
+	{
+		if (value == ToString(policy)) return policy;
+	}
+	throw std::invalid_argument("Unknown placement policy \"" + value + "\".");
+}
+
+inline bool ParseSwitch(const std::string& name, const std::string& value)
+{
+	if (value == "on" || value == "true" || value == "1") return true;
+	if (value == "off" || value == "false" || value == "0") return false;
+	throw std::invalid_argument("--" + name + " expects on or off, got \"" + value + "\".");
+}
+
+// Checks every item of a list against the allowed values.
+template <size_t N>
+inline std::vector<std::string> ParseChoices(const std::string& name, const std::string& value, const char* const (&allowed)[N])
+{
+	const std::vector<std::string> items = SplitList(value);
+	if (items.empty()) throw std::invalid_argument("--" + name + " needs at least one value.");
+	for (const std::string& item : items)
+	{
+		if (std::find(std::begin(allowed), std::end(allowed), item) == std::end(allowed))
+		{
+			throw std::invalid_argument("Unknown value \"" + item + "\" for --" + name + ".");
+		}
+	}
+	return items;
+}
+
+// Lets a program built on top of the driver's configuration accept settings of its own. Returns false for names it doesn't know either.
+using ExtraSetting = std::function<bool(const std::string& name, const std::string& value)>;
+
+inline void ApplySetting(BenchmarkConfig& config, const std::string& name, const std::string& value, const ExtraSetting& extra = {})
+{
+	static constexpr const char* IMPLEMENTATIONS[] = { "working", "exercise" };
+	static constexpr const char* STRATEGIES[] = { "SingleThread", "Async", "Threads" };
+
+	if (name == "iterations" || name == "workers")
+	{
+		std::vector<size_t> counts;
+		for (const std::string& item : SplitList(value))
+		{
+			counts.push_back(ParseCount(name, item));
+		}
+		if (counts.empty()) throw std::invalid_argument("--" + name + " needs at least one value.");
+		(name == "iterations" ? config.iterations : config.workers) = counts;
+	}
+	else if (name == "implementations") config.implementations = ParseChoices(name, value, IMPLEMENTATIONS);
+	else if (name == "strategies") config.strategies = ParseChoices(name, value, STRATEGIES);
+	else if (name == "engines") config.engines = ParseChoices(name, value, AVAILABLE_ENGINES);
+	else if (name == "kernels") config.kernels = ParseChoices(name, value, AVAILABLE_KERNELS);
+	else if (name == "warmups") config.warmups = value == "0" ? 0 : ParseCount(name, value);
+	else if (name == "repetitions") config.repetitions = ParseCount(name, value);
+	else if (name == "placement") config.placement = ParsePlacement(value);
+	else if (name == "counters") config.counters = ParseSwitch(name, value);
+	else if (name == "precision") config.precisionDigits = ParseCount(name, value);
+	else if (name == "values") config.valueIntervalMs = value == "0" ? 0 : ParseCount(name, value);
+	else if (name == "monitor") config.monitorIntervalMs = value == "0" ? 0 : ParseCount(name, value);
+	else if (name == "monitor-output") config.monitorOutput = value;
+	else if (name == "capture")
+	{
+		if (value != "end" && value != "stream" && value != "signal") throw std::invalid_argument("--capture expects end, stream or signal, got \"" + value + "\".");
+		config.streamCapture = value == "stream";
+		config.signalCapture = value == "signal";
+	}
+	else if (name == "capture-memory") config.captureMemoryMb = ParseCount(name, value);
+	else if (name == "flush") config.flushIntervalMs = ParseCount(name, value);
+	else if (name == "cswitches") config.contextSwitches = ParseSwitch(name, value);
+	else if (name == "listen")
+	{
+		const size_t colon = value.rfind(':');
+		const std::string port = colon == std::string::npos ? value : value.substr(colon + 1);
+		config.listenAddress = colon == std::string::npos ? "127.0.0.1" : value.substr(0, colon);
+		if (config.listenAddress.empty()) throw std::invalid_argument("--listen expects an address before the ':', got \"" + value + "\".");
+		config.listenPort = port == "off" || port == "0" ? 0 : port == "on" ? 28077 : ParseCount(name, port); // easy_profiler's default port.
+		if (config.listenPort > 65535) throw std::invalid_argument("--listen expects a port, got \"" + value + "\".");
+	}
+	else if (name == "sampling")
+	{
+		config.samplingHz = value == "off" || value == "0" ? 0 : value == "on" ? DEFAULT_SAMPLING_HZ : ParseCount(name, value);
+		if (config.samplingHz > 100000) throw std::invalid_argument("--sampling expects at most 100000 Hz, got \"" + value + "\".");
+	}
+	else if (name == "target") config.targetHalfWidth = value == "0" || value == "off" ? 0.0 : ParsePositiveNumber(name, value);
+	else if (!extra || !extra(name, value)) throw std::invalid_argument("Unknown setting \"" + name + "\".");
+}
+
+inline void LoadConfigFile(BenchmarkConfig& config, const std::string& path, const ExtraSetting& extra = {})
+{
+	std::ifstream file(path);
+	if (!file) throw std::invalid_argument("Can't open config file \"" + path + "\".");
+
+	std::string line;
+	size_t lineNumber = 0;
+	while (std::getline(file, line))
+	{
+		lineNumber++;
+		line = line.substr(0, line.find('#'));
+		if (line.find_first_not_of(" \t\r") == std::string::npos) continue;
+
+		const size_t equal = line.find('=');
+		if (equal == std::string::npos) throw std::invalid_argument(path + ":" + std::to_string(lineNumber) + ": expected \"name = value\".");
+		const std::vector<std::string> name = SplitList(line.substr(0, equal));
+		std::string value = line.substr(equal + 1);
+		value.erase(0, value.find_first_not_of(" \t"));
+		value.erase(value.find_last_not_of(" \t\r") + 1);
+		if (name.size() != 1) throw std::invalid_argument(path + ":" + std::to_string(lineNumber) + ": expected \"name = value\".");
+		ApplySetting(config, name[0], value, extra);
+	}
+}
+
+/*
+	Starts from the given defaults and applies the config file then the command line on top of them.
+	Throws std::invalid_argument on anything it doesn't understand, with a message meant for the user.
+*/
+inline BenchmarkConfig ParseConfig(const int argc, const char* const argv[], BenchmarkConfig config = {}, const ExtraSetting& extra = {})
+{
+	std::vector<std::pair<std::string, std::string>> settings;
+	std::string configFile;
+
+	for (int i = 1; i < argc; i++)
+	{
+		std::string arg = argv[i];
+		if (arg == "--help" || arg == "-h")
+		{
+			config.help = true;
+			continue;
+		}
+		if (arg.rfind("--", 0) != 0) throw std::invalid_argument("Unexpected argument \"" + arg + "\".");
+		arg = arg.substr(2);
+
+		std::string name = arg, value;
+		const size_t equal = arg.find('=');
+		if (equal != std::string::npos)
+		{
+			name = arg.substr(0, equal);
+			value = arg.substr(equal + 1);
+		}
+		else if (i + 1 < argc)
+		{
+			value = argv[++i];
+		}
+		else
+		{
+			throw std::invalid_argument("--" + name + " needs a value.");
+		}
+
+		if (name == "config") configFile = value;
+		else settings.emplace_back(name, value);
+	}
+
+	if (!configFile.empty()) LoadConfigFile(config, configFile, extra);
+	for (const auto& [name, value] : settings)
+	{
+		ApplySetting(config, name, value, extra);
+	}
+	return config;
+}
@@ -1,23 +1,32 @@
+#pragma once
+
 #include <random>
 #include <thread>
 #include <future>
+#include <cmath>
+
+#include "instrumentation.h"
+#include "workers.h"
 
-#include <easy/profiler.h>
+// Your implementation lives in its own namespace so the driver can run it side by side with the working one (see --implementations).
+namespace exercise
+{
 
 inline float Magnitude(const float x, const float y)
 {
-	return std::sqrtf(x * x + y * y);
+	return std::sqrt(x * x + y * y); // std::sqrt has a float overload, std::sqrtf is missing from some standard libraries.
 }
 
 // Approximates PI on a single thread. Baseline case to compare against.
-float SingleThread(const size_t iterations)
+// [[maybe_unused]] keeps the stubs warning-free while they're compiled next to the working implementation, drop them as you use the variables.
+float SingleThread([[maybe_unused]] const size_t iterations)
 {
-	EASY_BLOCK("SingleThread approach.", profiler::colors::Green);
+	PHASE_BLOCK("SingleThread approach.", profiler::colors::Green);
 
 	std::default_random_engine e; // Random engine we'll be using to generate random floats.
 	std::uniform_real_distribution<float> d(-1.0f, 1.0f); // We're going to be generating uniformly distrubuted floats (meaning no particular pattern, not even normally distrubuted).
 
-	size_t insideCircle = 0;
+	[[maybe_unused]] size_t insideCircle = 0;
 
 	/*TODO:
 		Approximate PI using the Monte Carlo approach: https://www.geeksforgeeks.org/estimating-value-pi-using-monte-carlo/
@@ -27,20 +36,22 @@ float SingleThread(const size_t iterations)
 }
 
 // Approximates PI by kicking off smaller pi approximating subroutines but lets them instanciate their own random number generators.
-float Async(const size_t iterations, const size_t nrOfWorkers)
+float Async([[maybe_unused]] const size_t iterations, const size_t nrOfWorkers = DefaultWorkerCount(), [[maybe_unused]] const StrategyOptions& options = {})
 {
-	EASY_BLOCK("Async method.", profiler::colors::Red);
+	PHASE_BLOCK("Async method.", profiler::colors::Red);
 
 	// Implementation of the PI approximating algorithm but this time split into multiple subroutines with their own random number generators.
-	const auto approximatePi = [](const size_t iterations, const size_t nrOfWorkers, const size_t workerId)->size_t
+	[[maybe_unused]] const auto approximatePi = []([[maybe_unused]] const size_t iterations, [[maybe_unused]] const size_t nrOfWorkers, [[maybe_unused]] const size_t workerId)->size_t
 	{
-		EASY_BLOCK("Approximation subroutine.", profiler::colors::Red100);
+		WORKER_BLOCK("Approximation subroutine.", profiler::colors::Red100);
 
 		/*TODO:
 			Generate 2D points within a unit square using e, d, iterationsand nrOfWorkersand count the number of points that lies inside the unit circle.
 			The idea is that each subroutine should only do the iterations / nrOfWorkers amount of iterations and you'll then sum up the results of all the
 			subroutines to obtain the equivalent approximation of the SingleThread approach.
+			Unless the workers divide the iterations evenly, hand the remainder out to the first workers, or the approximation will be divided by samples that were never drawn.
 			Use local random number generators.
+			Once it works, have a look at options.placement and workers.h to pin each subroutine to a cpu of its own.
 		*/
 
 		return 0;
@@ -48,16 +59,16 @@ float Async(const size_t iterations, const size_t nrOfWorkers)
 
 	std::vector<std::future<size_t>> futures(nrOfWorkers);
 	{
-		EASY_BLOCK("Kicking off threads.", profiler::colors::Red100);
+		PHASE_BLOCK("Kicking off threads.", profiler::colors::Red100);
 		
 		/*TODO:
 			Kick off std::async's executing approximatePi.
 		*/
 	}
 
-	size_t insideCircle = 0;
+	[[maybe_unused]] size_t insideCircle = 0;
 	{
-		EASY_BLOCK("Retrieving results.", profiler::colors::Red100);
+		PHASE_BLOCK("Retrieving results.", profiler::colors::Red100);
 		
 		/*TODO:
 			Retrieve the results of the subroutines computed asynchnously.
@@ -68,14 +79,14 @@ float Async(const size_t iterations, const size_t nrOfWorkers)
 }
 
 // Approximates PI by kicking off smaller pi approximating subroutines guaranteed to be on different threads and lets them instanciate their own random number generators.
-float Threads(const size_t iterations, const size_t nrOfWorkers)
+float Threads([[maybe_unused]] const size_t iterations, [[maybe_unused]] const size_t nrOfWorkers = DefaultWorkerCount(), [[maybe_unused]] const StrategyOptions& options = {})
 {
-	EASY_BLOCK("Threads method.", profiler::colors::Blue);
+	PHASE_BLOCK("Threads method.", profiler::colors::Blue);
 
 	// Modified version of approximatePi that uses a std::promise to return the result instead of the return value of the function.
-	const auto approximatePi = [](/* TODO: Modify the signature of this lambda so that it uses a std::promise to return a value instead of the regular return value. */)
+	[[maybe_unused]] const auto approximatePi = [](/* TODO: Modify the signature of this lambda so that it uses a std::promise to return a value instead of the regular return value. */)
 	{
-		EASY_BLOCK("Approximation subroutine.", profiler::colors::Blue100);
+		WORKER_BLOCK("Approximation subroutine.", profiler::colors::Blue100);
 		
 		/*TODO:
 			Implement an approximatePi like the one from AsyncNoRef but this time use a std::promise to return the result.
@@ -85,16 +96,16 @@ float Threads(const size_t iterations, const size_t nrOfWorkers)
 	std::vector<std::thread> threads; // Vector for all the threads we'll be kicking off.
 	std::vector<std::future<size_t>> futures; // And a vector for holding their associated futures to retireve their results.
 	{
-		EASY_BLOCK("Kicking off threads.", profiler::colors::Blue100);
+		PHASE_BLOCK("Kicking off threads.", profiler::colors::Blue100);
 		
 		/*TODO:
 			Kick off std::async's executing approximatePi.
 		*/
 	}
 
-	size_t insideCircle = 0;
+	[[maybe_unused]] size_t insideCircle = 0;
 	{
-		EASY_BLOCK("Retrieving results.", profiler::colors::Blue100);
+		PHASE_BLOCK("Retrieving results.", profiler::colors::Blue100);
 		
 		/*TODO:
 			Retrieve the results of the subroutines computed asynchnously.
@@ -102,4 +113,6 @@ float Threads(const size_t iterations, const size_t nrOfWorkers)
 	}
 
 	return 0.0f;
-}
\ No newline at end of file
+}
+
+} // namespace exercise
\ No newline at end of file
@@ -0,0 +1,270 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <utility>
+#include <fstream>
+#include <sstream>
+#include <chrono>
+#include <ctime>
+
+#if defined(__linux__)
+#include <sys/utsname.h>
+#include <unistd.h>
+#endif
+
+#include "config.h"
+#include "instrumentation.h"
+#include "json.h"
+#include "topology.h"
+#include "workerCount.h"
+
+/*
+	Fingerprint of the environment a benchmark ran in, attached to every result so that numbers from different hosts can be told apart.
+	Anything that can't be found out on this platform is reported as "unknown" rather than left out, so that every result has the same fields.
+*/
+
+#ifndef PI_BUILD_TYPE
+#define PI_BUILD_TYPE "" // CMake defines the configuration the binary was built in.
+#endif // PI_BUILD_TYPE
+#ifndef PI_CXX_FLAGS
+#define PI_CXX_FLAGS "" // And CMAKE_CXX_FLAGS.
+#endif // PI_CXX_FLAGS
+
+constexpr const char* UNKNOWN_VALUE = "unknown";
+
+struct EnvironmentFingerprint
+{
+	std::vector<std::pair<std::string, std::string>> fields; // In the order they get printed.
+	std::vector<std::string> warnings; // Configurations known to make measurements noisy or unrepresentative.
+
+	const std::string& Get(const std::string& name) const
+	{
+		static const std::string unknown = UNKNOWN_VALUE;
+		for (const auto& [key, value] : fields)
+		{
+			if (key == name) return value;
+		}
+		return unknown;
+	}
+};
+
+// Value of the first "key : value" line of /proc/cpuinfo with the given key.
+inline std::string CpuInfoField(const std::string& key)
+{
+	std::ifstream file("/proc/cpuinfo");
+	std::string line;
+	while (std::getline(file, line))
+	{
+		const size_t colon = line.find(':');
+		if (colon == std::string::npos) continue;
+		std::string name = line.substr(0, colon);
+		name.erase(name.find_last_not_of(" \t") + 1);
+		if (name != key) continue;
+		std::string value = line.substr(colon + 1);
+		value.erase(0, value.find_first_not_of(" \t"));
+		return value;
+	}
+	return UNKNOWN_VALUE;
+}
+
+inline std::string OrUnknown(const std::string& value)
+{
+	return value.empty() ? UNKNOWN_VALUE : value;
+}
+
+// Instruction set the compiler was allowed to target. There's no run-time dispatch, the binary runs the same code on every cpu.
+inline std::string CompiledIsaLevel()
+{
+#if defined(__AVX512F__)
+	return "x86-64-v4 (AVX-512)";
+#elif defined(__AVX2__)
+	return "x86-64-v3 (AVX2)";
+#elif defined(__SSE4_2__)
+	return "x86-64-v2 (SSE4.2)";
+#elif defined(__x86_64__) || defined(_M_X64)
+	return "x86-64 (SSE2)";
+#elif defined(__aarch64__) || defined(_M_ARM64)
+	return "aarch64";
+#else
+	return UNKNOWN_VALUE;
+#endif
+}
+
+// Best instruction set level the cpu supports, to see how much the compiled level leaves on the table.
+inline std::string CpuIsaLevel()
+{
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx512f")) return "x86-64-v4 (AVX-512)";
+	if (__builtin_cpu_supports("avx2")) return "x86-64-v3 (AVX2)";
+	if (__builtin_cpu_supports("sse4.2")) return "x86-64-v2 (SSE4.2)";
+	return "x86-64 (SSE2)";
+#else
+	return UNKNOWN_VALUE;
+#endif
+}
+
+inline std::string CompilerDescription()
+{
+#if defined(__clang__)
+	return std::string("clang ") + __clang_version__;
+#elif defined(__GNUC__)
+	return std::string("gcc ") + __VERSION__;
+#elif defined(_MSC_VER)
+	return "msvc " + std::to_string(_MSC_FULL_VER);
+#else
+	return UNKNOWN_VALUE;
+#endif
+}
+
+inline std::string JoinList(const std::vector<std::string>& items)
+{
+	std::string joined;
+	for (const std::string& item : items)
+	{
+		joined += (joined.empty() ? "" : ",") + item;
+	}
+	return joined;
+}
+
+inline EnvironmentFingerprint CaptureFingerprint(const BenchmarkConfig& config)
+{
+	EnvironmentFingerprint fingerprint;
+	const auto add = [&fingerprint](const std::string& name, const std::string& value) { fingerprint.fields.emplace_back(name, OrUnknown(value)); };
+
+	const std::time_t now = std::chrono::system_clock::to_time_t(std::chrono::system_clock::now());
+	char timestamp[32] = {};
+	std::strftime(timestamp, sizeof(timestamp), "%Y-%m-%dT%H:%M:%SZ", std::gmtime(&now));
+	add("timestamp", timestamp);
+
+#if defined(__linux__)
+	char host[256] = {};
+	gethostname(host, sizeof(host) - 1);
+	add("host", host);
+	utsname system = {};
+	uname(&system);
+	add("kernel", std::string(system.sysname) + " " + system.release + " " + system.machine);
+#else
+	add("host", "");
+	add("kernel", "");
+#endif
+
+	add("cpu_model", CpuInfoField("model name"));
+	add("microcode", CpuInfoField("microcode"));
+
+	const std::string governor = ReadSysfsLine("/sys/devices/system/cpu/cpu0/cpufreq/scaling_governor");
+	add("governor", governor);
+	std::string turbo;
+	const std::string noTurbo = ReadSysfsLine("/sys/devices/system/cpu/intel_pstate/no_turbo"); // Intel.
+	const std::string boost = ReadSysfsLine("/sys/devices/system/cpu/cpufreq/boost"); // AMD and acpi-cpufreq.
+	if (!noTurbo.empty()) turbo = noTurbo == "0" ? "enabled" : "disabled";
+	else if (!boost.empty()) turbo = boost == "1" ? "enabled" : "disabled";
+	add("turbo", turbo);
+
+	const std::string smtControl = ReadSysfsLine("/sys/devices/system/cpu/smt/control");
+	const std::string smtActive = ReadSysfsLine("/sys/devices/system/cpu/smt/active");
+	add("smt", smtControl.empty() ? smtActive : smtControl + (smtActive.empty() ? "" : " (active " + smtActive + ")"));
+	const std::string isolated = ReadSysfsLine("/sys/devices/system/cpu/isolated");
+	add("isolated_cpus", isolated.empty() ? "none" : isolated);
+
+	const CpuBudget budget = DetectCpuBudget();
+	add("hardware_threads", std::to_string(budget.hardwareThreads));
+	add("affinity_cpus", std::to_string(budget.affinityCpus));
+	add("cgroup_cpu_quota", budget.cgroupQuota > 0.0 ? std::to_string(budget.cgroupQuota) + " from " + budget.quotaSource : "none");
+
+	add("compiler", CompilerDescription());
+	const std::string buildType = PI_BUILD_TYPE;
+#if defined(__OPTIMIZE__) || (defined(_MSC_VER) && !defined(_DEBUG))
+	const bool optimized = true;
+#else
+	const bool optimized = false;
+#endif
+	add("build_type", buildType.empty() ? "unspecified" : buildType);
+	std::string flags = PI_CXX_FLAGS; // CMAKE_CXX_FLAGS then those of the build type, either may be empty.
+	flags.erase(0, flags.find_first_not_of(' '));
+	add("compiler_flags", (flags.empty() ? "defaults" : flags) + (optimized ? " (optimized)" : " (not optimized)"));
+	add("isa_compiled", CompiledIsaLevel());
+	add("isa_cpu", CpuIsaLevel());
+#if BUILD_WITH_EASY_PROFILER && defined(_WIN32)
+	add("profiler", "easy_profiler");
+#elif BUILD_WITH_EASY_PROFILER
+	add("profiler", "easy_profiler API, in-tree backend");
+#else
+	add("profiler", "none");
+#endif
+	add("instrumentation", InstrumentationLevelName());
+	add("engines", JoinList(config.engines));
+	add("kernels", JoinList(config.kernels));
+	add("placement", ToString(config.placement));
+
+	// Known sources of noise.
+	if (!governor.empty() && governor != "performance") fingerprint.warnings.push_back("cpu frequency governor is \"" + governor + "\", set it to \"performance\" for stable clocks.");
+	if (turbo == "enabled") fingerprint.warnings.push_back("turbo boost is enabled, clocks will depend on temperature and on how many cores are busy.");
+	if (!optimized) fingerprint.warnings.push_back("the benchmark was built without optimizations, build in Release for representative numbers.");
+#if PI_INSTRUMENTATION > PI_INSTRUMENTATION_OFF
+	fingerprint.warnings.push_back(std::string("easy_profiler instrumentation is compiled in at the \"") + InstrumentationLevelName() + "\" level and adds overhead to every block, see InstrumentationOverhead.");
+#endif
+	if (budget.cgroupQuota > 0.0) fingerprint.warnings.push_back("a cgroup cpu quota applies, going over it gets the process throttled.");
+	if (config.placement == PlacementPolicy::IsolatedOnly && SystemTopology().isolated.empty())
+	{
+		fingerprint.warnings.push_back(isolated.empty() ? "placement is \"isolated\" but no cpu is isolated (isolcpus=), the workers are left to the OS." : "placement is \"isolated\" but none of the isolated cpus " + isolated + " can be pinned to, the workers are left to the OS.");
+	}
+	size_t maxWorkers = 1;
+	for (const size_t workers : config.workers)
+	{
+		maxWorkers = std::max(maxWorkers, workers);
+	}
+	if (maxWorkers > budget.effective) fingerprint.warnings.push_back("up to " + std::to_string(maxWorkers) + " workers on a budget of " + std::to_string(budget.effective) + " cpus, workers will time-share.");
+	double load = 0.0;
+	std::ifstream loadavg("/proc/loadavg");
+	if (loadavg >> load && load > 0.5 * (double)budget.effective) fingerprint.warnings.push_back("load average is " + std::to_string(load) + ", other processes are competing for the cpus.");
+	return fingerprint;
+}
+
+inline void PrintFingerprint(std::ostream& out, const EnvironmentFingerprint& fingerprint)
+{
+	out << "Environment:" << std::endl;
+	for (const auto& [name, value] : fingerprint.fields)
+	{
+		out << "\t" << name << ": " << value << std::endl;
+	}
+	for (const std::string& warning : fingerprint.warnings)
+	{
+		out << "Warning: " << warning << std::endl;
+	}
+}
+
+// The fingerprint as a JSON object, warnings included.
+inline std::string FingerprintJson(const EnvironmentFingerprint& fingerprint)
+{
+	std::string json = "{ ";
+	for (const auto& [name, value] : fingerprint.fields)
+	{
+		json += JsonString(name) + ": " + JsonString(value) + ", ";
+	}
+	json += "\"warnings\": [";
+	for (size_t i = 0; i < fingerprint.warnings.size(); i++)
+	{
+		json += (i ? ", " : "") + JsonString(fingerprint.warnings[i]);
+	}
+	return json + "] }";
+}
+
+// Reads back what FingerprintJson() wrote.
+inline EnvironmentFingerprint FingerprintFromJson(const JsonValue& object)
+{
+	EnvironmentFingerprint fingerprint;
+	for (const auto& [name, value] : object.members)
+	{
+		if (value.type == JsonValue::Type::String) fingerprint.fields.emplace_back(name, value.string);
+		else if (name == "warnings")
+		{
+			for (const JsonValue& warning : value.items)
+			{
+				fingerprint.warnings.push_back(warning.string);
+			}
+		}
+	}
+	return fingerprint;
+}
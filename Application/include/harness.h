@@ -0,0 +1,81 @@
+#pragma once
+
+#include <chrono>
+#include <vector>
+#include <functional>
+
+#include "statistics.h"
+
+/*
+	Timing harness: runs a measurement a few times without recording it to warm caches, branch predictors and the cpu's clock up,
+	then records it a number of times with a monotonic clock and summarizes the durations.
+*/
+
+// std::chrono::system_clock follows the wall clock and can jump when it gets adjusted, steady_clock can't.
+using BenchmarkClock = std::chrono::steady_clock;
+static_assert(BenchmarkClock::is_steady, "The benchmark clock must be monotonic.");
+
+// Coefficient of variation above which a measurement is flagged as unstable.
+constexpr const double UNSTABLE_CV = 0.05;
+
+struct Measurement
+{
+	Summary ns; // Duration of a single run in nanoseconds.
+	double samplesPerSecond = 0.0; // Throughput of the median run.
+	size_t warmups = 0;
+	float lastResult = 0.0f; // Approximation returned by the last recorded run.
+	std::vector<double> runs; // Raw durations in nanoseconds, in the order they were recorded.
+	std::vector<size_t> samples; // Samples drawn by every recorded run, when a run can stop early and draws a varying number of them.
+
+	// Too much spread between runs for the median to mean much, usually because something else was competing for the cpu.
+	bool Unstable() const { return ns.Cv() > UNSTABLE_CV; }
+	// With fewer than 3 runs there's no telling whether the measurement is stable or not.
+	bool TooFewRuns() const { return ns.count < 3; }
+};
+
+inline double ElapsedNs(const BenchmarkClock::time_point start, const BenchmarkClock::time_point end)
+{
+	return std::chrono::duration<double, std::nano>(end - start).count();
+}
+
+/*
+	Measures run(), which draws samplesPerRun samples and returns an approximation of PI.
+	runDone is called after every recorded run, ex: to collect per run reports.
+	If the number of samples varies from one run to the next, samplesDrawn tells how many the run that just finished drew, the throughput is then the median of every run's own.
+*/
+inline Measurement Measure(const std::function<float()>& run, const size_t samplesPerRun, const size_t warmups, const size_t repetitions, const std::function<void()>& runDone = {}, const std::function<size_t()>& samplesDrawn = {})
+{
+	Measurement measurement;
+	measurement.warmups = warmups;
+	for (size_t i = 0; i < warmups; i++)
+	{
+		run();
+	}
+
+	measurement.runs.reserve(repetitions);
+	for (size_t i = 0; i < repetitions; i++)
+	{
+		const auto startTime = BenchmarkClock::now();
+		measurement.lastResult = run();
+		const auto endTime = BenchmarkClock::now();
+		measurement.runs.push_back(ElapsedNs(startTime, endTime));
+		if (samplesDrawn) measurement.samples.push_back(samplesDrawn());
+		if (runDone) runDone();
+	}
+
+	measurement.ns = Summarize(measurement.runs);
+	if (samplesDrawn)
+	{
+		std::vector<double> throughputs;
+		for (size_t i = 0; i < measurement.runs.size(); i++)
+		{
+			if (measurement.runs[i] > 0.0) throughputs.push_back((double)measurement.samples[i] / (measurement.runs[i] * 1e-9));
+		}
+		measurement.samplesPerSecond = Summarize(throughputs).median;
+	}
+	else if (measurement.ns.median > 0.0)
+	{
+		measurement.samplesPerSecond = (double)samplesPerRun / (measurement.ns.median * 1e-9);
+	}
+	return measurement;
+}
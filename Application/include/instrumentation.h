@@ -0,0 +1,60 @@
+#pragma once
+
+#include <easy/profiler.h>
+#include <easy/arbitrary_value.h>
+
+/*
+	Compile-time instrumentation levels of the strategies. Every block belongs to a level and only gets compiled in if the build's level is at least that fine.
+	The level is picked with CMake's PI_INSTRUMENTATION_LEVEL, nothing is compiled in at all without USE_EASY_PROFILER.
+	InstrumentationOverhead is built once per level and measures what each of them costs.
+*/
+
+#define PI_INSTRUMENTATION_OFF 0 // No blocks.
+#define PI_INSTRUMENTATION_PHASES 1 // A block per strategy call and per phase of it: kicking off threads, coordinating the early stop, retrieving results.
+#define PI_INSTRUMENTATION_WORKERS 2 // Plus a block per worker and per result retrieved, the workers' thread names and their progress values.
+#define PI_INSTRUMENTATION_CHUNKS 3 // Plus a block per chunk of samples a worker draws.
+
+#ifndef PI_INSTRUMENTATION
+#ifdef PI_INSTRUMENTATION_DEFAULT
+#define PI_INSTRUMENTATION PI_INSTRUMENTATION_DEFAULT // CMake's PI_INSTRUMENTATION_LEVEL, a target can still define its own PI_INSTRUMENTATION.
+#else
+#define PI_INSTRUMENTATION PI_INSTRUMENTATION_WORKERS // What the strategies have always been instrumented with.
+#endif
+#endif // PI_INSTRUMENTATION
+
+#if !BUILD_WITH_EASY_PROFILER
+#undef PI_INSTRUMENTATION
+#define PI_INSTRUMENTATION PI_INSTRUMENTATION_OFF
+#endif
+
+inline const char* InstrumentationLevelName(const int level = PI_INSTRUMENTATION)
+{
+	switch (level)
+	{
+		case PI_INSTRUMENTATION_OFF: return "off";
+		case PI_INSTRUMENTATION_PHASES: return "phases";
+		case PI_INSTRUMENTATION_WORKERS: return "workers";
+		case PI_INSTRUMENTATION_CHUNKS: return "chunks";
+		default: return "unknown";
+	}
+}
+
+#if PI_INSTRUMENTATION >= PI_INSTRUMENTATION_PHASES
+#define PHASE_BLOCK(...) EASY_BLOCK(__VA_ARGS__)
+#else
+#define PHASE_BLOCK(...)
+#endif
+
+#if PI_INSTRUMENTATION >= PI_INSTRUMENTATION_WORKERS
+#define WORKER_BLOCK(...) EASY_BLOCK(__VA_ARGS__)
+#define WORKER_THREAD(name) EASY_THREAD(name)
+#else
+#define WORKER_BLOCK(...)
+#define WORKER_THREAD(name)
+#endif
+
+#if PI_INSTRUMENTATION >= PI_INSTRUMENTATION_CHUNKS
+#define CHUNK_BLOCK(...) EASY_BLOCK(__VA_ARGS__)
+#else
+#define CHUNK_BLOCK(...)
+#endif
@@ -0,0 +1,250 @@
+#pragma once
+
+#include <string>
+#include <sstream>
+#include <iomanip>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cctype>
+#include <vector>
+#include <utility>
+#include <stdexcept>
+
+/*
+	Just enough JSON writing for benchmark results, there's no need for a full blown library.
+*/
+
+inline std::string JsonString(const std::string& text)
+{
+	std::string escaped = "\"";
+	for (const char c : text)
+	{
+		switch (c)
+		{
+			case '"': escaped += "\\\""; break;
+			case '\\': escaped += "\\\\"; break;
+			case '\n': escaped += "\\n"; break;
+			case '\r': escaped += "\\r"; break;
+			case '\t': escaped += "\\t"; break;
+			default:
+				if ((unsigned char)c < 0x20)
+				{
+					char buffer[8];
+					std::snprintf(buffer, sizeof(buffer), "\\u%04x", (unsigned)(unsigned char)c);
+					escaped += buffer;
+				}
+				else
+				{
+					escaped += c;
+				}
+		}
+	}
+	return escaped + "\"";
+}
+
+// JSON has no representation for NaN and infinities, they become null.
+inline std::string JsonNumber(const double value)
+{
+	if (!std::isfinite(value)) return "null";
+	std::ostringstream ss;
+	ss << std::setprecision(10) << value;
+	return ss.str();
+}
+
+/*
+	And just enough JSON reading to load back what we wrote, ex: a stored baseline.
+	Numbers are doubles, objects keep their members in order. Throws std::runtime_error on malformed input.
+*/
+struct JsonValue
+{
+	enum class Type { Null, Bool, Number, String, Array, Object };
+
+	Type type = Type::Null;
+	bool boolean = false;
+	double number = 0.0;
+	std::string string;
+	std::vector<JsonValue> items; // Array elements.
+	std::vector<std::pair<std::string, JsonValue>> members; // Object members.
+
+	// Member of an object, nullptr if there's no such member or this isn't an object.
+	const JsonValue* Find(const std::string& name) const
+	{
+		for (const auto& [key, value] : members)
+		{
+			if (key == name) return &value;
+		}
+		return nullptr;
+	}
+	double NumberOr(const std::string& name, const double fallback) const
+	{
+		const JsonValue* value = Find(name);
+		return value && value->type == Type::Number ? value->number : fallback;
+	}
+	std::string StringOr(const std::string& name, const std::string& fallback) const
+	{
+		const JsonValue* value = Find(name);
+		return value && value->type == Type::String ? value->string : fallback;
+	}
+};
+
+class JsonParser
+{
+public:
+	explicit JsonParser(const std::string& text) : text_(text) {}
+
+	JsonValue Parse()
+	{
+		JsonValue value = ParseValue();
+		SkipSpaces();
+		if (position_ != text_.size()) Fail("trailing characters");
+		return value;
+	}
+
+private:
+	[[noreturn]] void Fail(const std::string& what) const
+	{
+		throw std::runtime_error("Malformed JSON at offset " + std::to_string(position_) + ": " + what + ".");
+	}
+
+	void SkipSpaces()
+	{
+		while (position_ < text_.size() && std::isspace((unsigned char)text_[position_])) position_++;
+	}
+
+	bool Consume(const char c)
+	{
+		SkipSpaces();
+		if (position_ < text_.size() && text_[position_] == c)
+		{
+			position_++;
+			return true;
+		}
+		return false;
+	}
+
+	void Expect(const char c)
+	{
+		if (!Consume(c)) Fail(std::string("expected '") + c + "'");
+	}
+
+	bool ConsumeWord(const char* word)
+	{
+		const size_t length = std::strlen(word);
+		if (text_.compare(position_, length, word) != 0) return false;
+		position_ += length;
+		return true;
+	}
+
+	std::string ParseString()
+	{
+		Expect('"');
+		std::string result;
+		while (position_ < text_.size() && text_[position_] != '"')
+		{
+			char c = text_[position_++];
+			if (c == '\\')
+			{
+				if (position_ >= text_.size()) Fail("unterminated escape");
+				c = text_[position_++];
+				switch (c)
+				{
+					case 'n': result += '\n'; break;
+					case 'r': result += '\r'; break;
+					case 't': result += '\t'; break;
+					case 'b': result += '\b'; break;
+					case 'f': result += '\f'; break;
+					case 'u':
+					{
+						if (position_ + 4 > text_.size()) Fail("truncated \\u escape");
+						const unsigned code = (unsigned)std::stoul(text_.substr(position_, 4), nullptr, 16);
+						position_ += 4;
+						if (code < 0x80) result += (char)code; // We only ever write control characters this way.
+						else if (code < 0x800) { result += (char)(0xC0 | (code >> 6)); result += (char)(0x80 | (code & 0x3F)); }
+						else { result += (char)(0xE0 | (code >> 12)); result += (char)(0x80 | ((code >> 6) & 0x3F)); result += (char)(0x80 | (code & 0x3F)); }
+						break;
+					}
+					default: result += c; // \" \\ \/
+				}
+			}
+			else
+			{
+				result += c;
+			}
+		}
+		if (position_ >= text_.size()) Fail("unterminated string");
+		position_++;
+		return result;
+	}
+
+	JsonValue ParseValue()
+	{
+		SkipSpaces();
+		if (position_ >= text_.size()) Fail("unexpected end");
+
+		JsonValue value;
+		const char c = text_[position_];
+		if (c == '{')
+		{
+			value.type = JsonValue::Type::Object;
+			position_++;
+			if (Consume('}')) return value;
+			do
+			{
+				SkipSpaces();
+				std::string name = ParseString();
+				Expect(':');
+				value.members.emplace_back(std::move(name), ParseValue());
+			} while (Consume(','));
+			Expect('}');
+		}
+		else if (c == '[')
+		{
+			value.type = JsonValue::Type::Array;
+			position_++;
+			if (Consume(']')) return value;
+			do
+			{
+				value.items.push_back(ParseValue());
+			} while (Consume(','));
+			Expect(']');
+		}
+		else if (c == '"')
+		{
+			value.type = JsonValue::Type::String;
+			value.string = ParseString();
+		}
+		else if (ConsumeWord("true"))
+		{
+			value.type = JsonValue::Type::Bool;
+			value.boolean = true;
+		}
+		else if (ConsumeWord("false"))
+		{
+			value.type = JsonValue::Type::Bool;
+		}
+		else if (ConsumeWord("null"))
+		{
+			value.type = JsonValue::Type::Null;
+		}
+		else
+		{
+			const char* begin = text_.c_str() + position_;
+			char* end = nullptr;
+			value.type = JsonValue::Type::Number;
+			value.number = std::strtod(begin, &end);
+			if (end == begin) Fail("unexpected character");
+			position_ += (size_t)(end - begin);
+		}
+		return value;
+	}
+
+	const std::string& text_;
+	size_t position_ = 0;
+};
+
+inline JsonValue ParseJson(const std::string& text)
+{
+	return JsonParser(text).Parse();
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <ostream>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <iomanip>
+#include <sstream>
+
+#include "harness.h"
+#include "precision.h"
+#include "progress.h"
+
+/*
+	Live convergence stream: a thread that reads the workers' progress board at a fixed interval and writes the running estimate as CSV.
+	It only ever reads the board, which the workers publish to once per chunk, so the hot loop doesn't notice it.
+	Columns: wall time since the monitor started, workers, samples, hits, estimate, half-width of its 95% Wilson interval, samples/s since the previous line.
+	Every run of a strategy starts again from 0 samples, the instantaneous throughput restarts with it.
+*/
+class ConvergenceMonitor
+{
+public:
+	ConvergenceMonitor(const ProgressBoard& board, const std::chrono::milliseconds interval, std::ostream& out) :
+		board_(board), interval_(interval), out_(out)
+	{
+		out_ << "wall_s,workers,samples,hits,estimate,ci_half_width,samples_per_second" << std::endl;
+		thread_ = std::thread(&ConvergenceMonitor::Run, this);
+	}
+
+	~ConvergenceMonitor()
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			done_ = true;
+		}
+		wake_.notify_one();
+		thread_.join();
+	}
+
+	ConvergenceMonitor(const ConvergenceMonitor&) = delete;
+	ConvergenceMonitor& operator=(const ConvergenceMonitor&) = delete;
+
+private:
+	void Run()
+	{
+		const auto start = BenchmarkClock::now();
+		auto previousTime = start;
+		size_t previousSamples = 0;
+		std::unique_lock<std::mutex> lock(mutex_);
+		while (!wake_.wait_for(lock, interval_, [this]() { return done_; }))
+		{
+			const ProgressTotals totals = board_.Totals();
+			const auto now = BenchmarkClock::now();
+			const size_t since = totals.samples >= previousSamples ? totals.samples - previousSamples : totals.samples; // The board was reset for a new run.
+			const double seconds = ElapsedNs(previousTime, now) * 1e-9;
+
+			std::ostringstream line; // Formatted on its own, out_ may well be std::cout whose format flags the main thread changes as it prints.
+			line << std::fixed << std::setprecision(3) << ElapsedNs(start, now) * 1e-9 << ',' << board_.Workers() << ',' << totals.samples << ',' << totals.hits << ','
+				<< std::setprecision(7) << (totals.samples ? 4.0 * (double)totals.hits / (double)totals.samples : 0.0) << ','
+				<< std::scientific << std::setprecision(3) << (totals.samples ? PiWilsonHalfWidth(totals.hits, totals.samples) : 0.0) << ','
+				<< std::fixed << std::setprecision(0) << (seconds > 0.0 ? (double)since / seconds : 0.0) << '\n';
+			out_ << line.str() << std::flush; // Meant to be watched while it runs.
+
+			previousTime = now;
+			previousSamples = totals.samples;
+		}
+	}
+
+	const ProgressBoard& board_;
+	const std::chrono::milliseconds interval_;
+	std::ostream& out_;
+	std::mutex mutex_; // Only guards done_, to be woken up right away on destruction instead of at the next interval.
+	std::condition_variable wake_;
+	bool done_ = false;
+	std::thread thread_;
+};
@@ -0,0 +1,233 @@
+#pragma once
+
+#include <array>
+#include <string>
+#include <cstdint>
+#include <cstring>
+#include <cerrno>
+#include <limits>
+#include <initializer_list>
+
+#if defined(__linux__)
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif
+
+/*
+	Hardware performance counters through Linux's perf_event_open.
+	Counters only count user space (exclude_kernel) so that they keep working with the default perf_event_paranoid of 2.
+	Anything the kernel, the hypervisor or the cpu refuses to count is reported as unavailable instead of failing the benchmark, on other platforms everything is.
+*/
+
+enum class PerfEvent
+{
+	TaskClock, // Nanoseconds the thread actually spent on a cpu. Software event, available even when the hardware counters aren't.
+	Cycles,
+	RefCycles, // Cycles at the cpu's nominal frequency, whatever frequency it's actually running at.
+	Instructions,
+	Branches,
+	BranchMisses,
+	L1dMisses, // L1 data cache read misses.
+	LlcMisses, // Last level cache misses.
+	Count
+};
+
+constexpr const size_t PERF_EVENT_COUNT = (size_t)PerfEvent::Count;
+
+inline const char* ToString(const PerfEvent event)
+{
+	switch (event)
+	{
+		case PerfEvent::TaskClock: return "task-clock";
+		case PerfEvent::Cycles: return "cycles";
+		case PerfEvent::RefCycles: return "ref-cycles";
+		case PerfEvent::Instructions: return "instructions";
+		case PerfEvent::Branches: return "branches";
+		case PerfEvent::BranchMisses: return "branch-misses";
+		case PerfEvent::L1dMisses: return "L1D-misses";
+		case PerfEvent::LlcMisses: return "LLC-misses";
+		default: return "unknown";
+	}
+}
+
+// Counter values of one thread, or of several summed together. Derived metrics are NaN when a counter they need is unavailable.
+struct CounterReading
+{
+	std::array<double, PERF_EVENT_COUNT> values{};
+	std::array<bool, PERF_EVENT_COUNT> available{};
+	bool multiplexed = false; // Some counter only ran part of the time and got scaled up, values are estimates.
+
+	bool Has(const PerfEvent event) const { return available[(size_t)event]; }
+	double Get(const PerfEvent event) const { return Has(event) ? values[(size_t)event] : NAN_VALUE; }
+	bool AnyHardware() const
+	{
+		for (size_t i = (size_t)PerfEvent::Cycles; i < PERF_EVENT_COUNT; i++)
+		{
+			if (available[i]) return true;
+		}
+		return false;
+	}
+
+	double Ipc() const { return Ratio(Get(PerfEvent::Instructions), Get(PerfEvent::Cycles)); }
+	double BranchMissRate() const { return Ratio(Get(PerfEvent::BranchMisses), Get(PerfEvent::Branches)); }
+	double EffectiveGhz() const { return Ratio(Get(PerfEvent::Cycles), Get(PerfEvent::TaskClock)); } // Cycles per nanosecond on cpu.
+	double TurboRatio() const { return Ratio(Get(PerfEvent::Cycles), Get(PerfEvent::RefCycles)); } // Below 1 when throttled, above 1 when boosting.
+	double L1dMpki() const { return 1000.0 * Ratio(Get(PerfEvent::L1dMisses), Get(PerfEvent::Instructions)); } // Misses per thousand instructions.
+	double LlcMpki() const { return 1000.0 * Ratio(Get(PerfEvent::LlcMisses), Get(PerfEvent::Instructions)); }
+
+	// Sums the counters of several threads. A counter stays available only if it was available in both.
+	CounterReading& operator+=(const CounterReading& other)
+	{
+		for (size_t i = 0; i < PERF_EVENT_COUNT; i++)
+		{
+			values[i] += other.values[i];
+			available[i] = available[i] && other.available[i];
+		}
+		multiplexed = multiplexed || other.multiplexed;
+		return *this;
+	}
+
+private:
+	static constexpr double NAN_VALUE = std::numeric_limits<double>::quiet_NaN();
+	static double Ratio(const double numerator, const double denominator) { return denominator > 0.0 ? numerator / denominator : NAN_VALUE; }
+};
+
+/*
+	Counts the calling thread between Start() and Stop().
+	With inherit set, threads created by the calling thread after construction are counted too once they've exited, which is how a whole strategy gets counted from the driver.
+	Counters are opened in two groups, the core events and the cache events, so that the events of a group are always scheduled together and their ratios are consistent.
+	An event that can't join its group is opened on its own, an event that can't be opened at all is left unavailable.
+*/
+class PerfCounters
+{
+public:
+	explicit PerfCounters(const bool inherit = false)
+	{
+		fds_.fill(-1);
+#if defined(__linux__)
+		OpenGroup({ PerfEvent::Cycles, PerfEvent::RefCycles, PerfEvent::Instructions, PerfEvent::Branches, PerfEvent::BranchMisses }, inherit);
+		OpenGroup({ PerfEvent::L1dMisses, PerfEvent::LlcMisses }, inherit);
+		OpenGroup({ PerfEvent::TaskClock }, inherit);
+#else
+		(void)inherit;
+		error_ = "perf_event_open is Linux only";
+#endif
+	}
+
+	~PerfCounters()
+	{
+#if defined(__linux__)
+		for (const int fd : fds_)
+		{
+			if (fd >= 0) close(fd);
+		}
+#endif
+	}
+
+	PerfCounters(const PerfCounters&) = delete;
+	PerfCounters& operator=(const PerfCounters&) = delete;
+
+	// Why some event couldn't be opened, empty if all of them could.
+	const std::string& Error() const { return error_; }
+
+	void Start()
+	{
+#if defined(__linux__)
+		for (size_t i = 0; i < PERF_EVENT_COUNT; i++)
+		{
+			if (fds_[i] < 0) continue;
+			ReadRaw(fds_[i], baselines_[i]); // Not reset, a reset doesn't clear what exited inherited threads added to the counter.
+			ioctl(fds_[i], PERF_EVENT_IOC_ENABLE, 0);
+		}
+#endif
+	}
+
+	CounterReading Stop()
+	{
+		CounterReading reading;
+#if defined(__linux__)
+		for (const int fd : fds_)
+		{
+			if (fd >= 0) ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+		}
+		for (size_t i = 0; i < PERF_EVENT_COUNT; i++)
+		{
+			if (fds_[i] < 0) continue;
+			uint64_t data[3] = {};
+			if (!ReadRaw(fds_[i], data)) continue;
+			for (size_t field = 0; field < 3; field++)
+			{
+				data[field] -= baselines_[i][field];
+			}
+			if (data[2] == 0) continue; // Never got scheduled on the PMU.
+			reading.values[i] = (double)data[0];
+			if (data[2] < data[1])
+			{
+				reading.values[i] *= (double)data[1] / (double)data[2]; // More events than hardware counters, the kernel time-sliced them.
+				reading.multiplexed = true;
+			}
+			reading.available[i] = true;
+		}
+#endif
+		return reading;
+	}
+
+private:
+#if defined(__linux__)
+	// Reads the value, time enabled and time running of a counter.
+	static bool ReadRaw(const int fd, uint64_t (&data)[3])
+	{
+		return read(fd, data, sizeof(data)) == (ssize_t)sizeof(data);
+	}
+
+	static bool Describe(const PerfEvent event, perf_event_attr& attr)
+	{
+		std::memset(&attr, 0, sizeof(attr));
+		attr.size = sizeof(attr);
+		const auto cache = [](const uint64_t cache, const uint64_t op, const uint64_t result) { return cache | (op << 8) | (result << 16); };
+		switch (event)
+		{
+			case PerfEvent::TaskClock: attr.type = PERF_TYPE_SOFTWARE; attr.config = PERF_COUNT_SW_TASK_CLOCK; break;
+			case PerfEvent::Cycles: attr.type = PERF_TYPE_HARDWARE; attr.config = PERF_COUNT_HW_CPU_CYCLES; break;
+			case PerfEvent::RefCycles: attr.type = PERF_TYPE_HARDWARE; attr.config = PERF_COUNT_HW_REF_CPU_CYCLES; break;
+			case PerfEvent::Instructions: attr.type = PERF_TYPE_HARDWARE; attr.config = PERF_COUNT_HW_INSTRUCTIONS; break;
+			case PerfEvent::Branches: attr.type = PERF_TYPE_HARDWARE; attr.config = PERF_COUNT_HW_BRANCH_INSTRUCTIONS; break;
+			case PerfEvent::BranchMisses: attr.type = PERF_TYPE_HARDWARE; attr.config = PERF_COUNT_HW_BRANCH_MISSES; break;
+			case PerfEvent::L1dMisses: attr.type = PERF_TYPE_HW_CACHE; attr.config = cache(PERF_COUNT_HW_CACHE_L1D, PERF_COUNT_HW_CACHE_OP_READ, PERF_COUNT_HW_CACHE_RESULT_MISS); break;
+			case PerfEvent::LlcMisses: attr.type = PERF_TYPE_HARDWARE; attr.config = PERF_COUNT_HW_CACHE_MISSES; break;
+			default: return false;
+		}
+		attr.disabled = 1; // Every event gets enabled explicitly by Start(), whether it made it into its group or not.
+		attr.exclude_kernel = 1;
+		attr.exclude_hv = 1;
+		attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+		return true;
+	}
+
+	void OpenGroup(const std::initializer_list<PerfEvent> events, const bool inherit)
+	{
+		int leader = -1;
+		for (const PerfEvent event : events)
+		{
+			perf_event_attr attr;
+			if (!Describe(event, attr)) continue;
+			attr.inherit = inherit ? 1 : 0;
+			int fd = (int)syscall(SYS_perf_event_open, &attr, 0, -1, leader, 0); // This thread, any cpu.
+			if (fd < 0 && leader >= 0) fd = (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0); // Couldn't join the group, count it on its own.
+			if (fd < 0)
+			{
+				if (error_.empty()) error_ = std::string(ToString(event)) + ": " + std::strerror(errno);
+				continue;
+			}
+			if (leader < 0) leader = fd;
+			fds_[(size_t)event] = fd;
+		}
+	}
+#endif
+
+	std::array<int, PERF_EVENT_COUNT> fds_;
+	uint64_t baselines_[PERF_EVENT_COUNT][3] = {}; // Raw values at Start(), Stop() reports the difference.
+	std::string error_;
+};
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cmath>
+#include <limits>
+
+/*
+	Time-to-precision: how long a configuration needs to pin PI down to a given number of decimals.
+	Throughput alone hides half of the trade-off, an estimator drawing half as many samples per second but with a quarter of the variance per sample gets there first.
+*/
+
+constexpr const double PI = 3.14159265358979323846;
+constexpr const double Z_95 = 1.959963984540054; // Two-sided 95% quantile of the standard normal distribution.
+
+// Variance of a single hit-or-miss sample 4 * [x^2 + y^2 <= 1]: a Bernoulli of p = PI / 4 scaled by 4, so 16 p (1 - p) = PI (4 - PI).
+constexpr const double HIT_OR_MISS_VARIANCE = PI * (4.0 - PI);
+
+struct Precision
+{
+	double standardError = 0.0; // Analytical standard error of the estimate at the measured number of samples.
+	double observedError = 0.0; // |estimate - PI| of the last measured run, from the hits and samples it drew when they're known.
+	double target = 0.0; // Half-width of the 95% confidence interval asked for, ex: 1e-4.
+	double samplesNeeded = 0.0; // Samples needed for the 95% confidence interval to shrink to +-target.
+	double secondsToTarget = std::numeric_limits<double>::quiet_NaN(); // At the measured throughput, NaN if it's unknown.
+};
+
+// Half-width of the 95% confidence interval for 10^-digits.
+inline double PrecisionTarget(const size_t digits)
+{
+	return std::pow(10.0, -(double)digits);
+}
+
+// PI from hits out of samples, in double precision rather than the float the strategies return.
+inline double PiEstimate(const size_t hits, const size_t samples)
+{
+	return samples ? 4.0 * (double)hits / (double)samples : std::numeric_limits<double>::quiet_NaN();
+}
+
+inline Precision ComputePrecision(const double variancePerSample, const size_t samples, const double estimate, const double samplesPerSecond, const double target)
+{
+	Precision precision;
+	precision.target = target;
+	precision.standardError = samples > 0 ? std::sqrt(variancePerSample / (double)samples) : std::numeric_limits<double>::infinity();
+	precision.observedError = std::fabs(estimate - PI);
+	const double standardErrorNeeded = target / Z_95;
+	precision.samplesNeeded = std::ceil(variancePerSample / (standardErrorNeeded * standardErrorNeeded));
+	if (samplesPerSecond > 0.0) precision.secondsToTarget = precision.samplesNeeded / samplesPerSecond;
+	return precision;
+}
+
+/*
+	Half-width of the 95% Wilson score interval of PI after hits out of samples.
+	Unlike the normal approximation it stays sensible for few samples and for proportions close to 0 or 1, so it can be trusted from the very first chunks.
+*/
+inline double PiWilsonHalfWidth(const size_t hits, const size_t samples)
+{
+	if (samples == 0) return std::numeric_limits<double>::infinity();
+	const double n = (double)samples;
+	const double p = (double)hits / n;
+	const double z2 = Z_95 * Z_95;
+	const double halfWidth = Z_95 / (1.0 + z2 / n) * std::sqrt(p * (1.0 - p) / n + z2 / (4.0 * n * n)); // Of the hit ratio, PI is 4 times it.
+	return 4.0 * halfWidth;
+}
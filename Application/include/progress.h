@@ -0,0 +1,133 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <vector>
+#include <future>
+#include <chrono>
+#include <thread>
+
+#include "precision.h"
+
+/*
+	Progress of the workers of a running strategy, published without contention:
+	every worker only ever writes to its own cache line, readers (the stopping coordinator, a live monitor, ...) only read.
+*/
+
+// How often the coordinator looks at the workers' progress. A chunk of samples takes a few milliseconds.
+constexpr const std::chrono::milliseconds COORDINATOR_POLL_INTERVAL{ 1 };
+
+// Hits and samples of one worker, alone on its cache line so that workers publishing at the same time don't invalidate each other's.
+struct alignas(64) WorkerProgress
+{
+	std::atomic<size_t> sequence{ 0 }; // Odd while the worker is in the middle of publishing, so that readers never see hits and samples of different chunks.
+	std::atomic<size_t> hits{ 0 };
+	std::atomic<size_t> samples{ 0 };
+};
+
+struct ProgressTotals
+{
+	size_t hits = 0;
+	size_t samples = 0;
+};
+
+class ProgressBoard
+{
+public:
+	explicit ProgressBoard(const size_t capacity = 0) { Reset(capacity); }
+
+	/*
+		Zeroes the board for a run of nrOfWorkers and clears the stop flag. Called by the strategy before kicking off its workers.
+		Only grows the board if it's too small, create it with enough capacity up front if something else reads it concurrently.
+	*/
+	void Reset(const size_t nrOfWorkers)
+	{
+		if (nrOfWorkers > capacity_)
+		{
+			slots_.reset(new WorkerProgress[nrOfWorkers]);
+			capacity_ = nrOfWorkers;
+		}
+		for (size_t i = 0; i < capacity_; i++)
+		{
+			Publish(i, 0, 0);
+		}
+		workers_.store(nrOfWorkers, std::memory_order_release);
+		stop_.store(false, std::memory_order_release);
+	}
+
+	size_t Workers() const { return workers_.load(std::memory_order_acquire); }
+
+	// Called by a worker after every chunk with its running totals.
+	void Publish(const size_t worker, const size_t hits, const size_t samples)
+	{
+		WorkerProgress& slot = slots_[worker];
+		const size_t sequence = slot.sequence.load(std::memory_order_relaxed);
+		slot.sequence.store(sequence + 1, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_release);
+		slot.hits.store(hits, std::memory_order_relaxed);
+		slot.samples.store(samples, std::memory_order_relaxed);
+		slot.sequence.store(sequence + 2, std::memory_order_release);
+	}
+
+	// Consistent snapshot of one worker's progress, retries while the worker is publishing.
+	ProgressTotals Read(const size_t worker) const
+	{
+		const WorkerProgress& slot = slots_[worker];
+		ProgressTotals totals;
+		size_t before = 0, after = 0;
+		do
+		{
+			before = slot.sequence.load(std::memory_order_acquire);
+			totals.hits = slot.hits.load(std::memory_order_relaxed);
+			totals.samples = slot.samples.load(std::memory_order_relaxed);
+			std::atomic_thread_fence(std::memory_order_acquire);
+			after = slot.sequence.load(std::memory_order_relaxed);
+		} while (before != after || (before & 1) != 0);
+		return totals;
+	}
+
+	ProgressTotals Totals() const
+	{
+		ProgressTotals totals;
+		const size_t workers = Workers();
+		for (size_t worker = 0; worker < workers; worker++)
+		{
+			const ProgressTotals progress = Read(worker);
+			totals.hits += progress.hits;
+			totals.samples += progress.samples;
+		}
+		return totals;
+	}
+
+	void Stop() { stop_.store(true, std::memory_order_relaxed); }
+	bool Stopped() const { return stop_.load(std::memory_order_relaxed); }
+
+private:
+	std::unique_ptr<WorkerProgress[]> slots_;
+	size_t capacity_ = 0;
+	std::atomic<size_t> workers_{ 0 };
+	std::atomic<bool> stop_{ false };
+};
+
+/*
+	Watches the board until every worker is done, stopping them all as soon as the 95% Wilson interval of PI is narrower than +-targetHalfWidth.
+	Each worker still stops by itself once it has drawn its share of the sample cap.
+*/
+template <typename Result>
+inline void CoordinateStopping(ProgressBoard& board, const double targetHalfWidth, std::vector<std::future<Result>>& futures)
+{
+	for (size_t worker = 0; worker < futures.size();)
+	{
+		if (futures[worker].wait_for(COORDINATOR_POLL_INTERVAL) == std::future_status::ready)
+		{
+			worker++; // Next one, the ones before are done.
+			continue;
+		}
+		const ProgressTotals totals = board.Totals();
+		if (totals.samples > 0 && PiWilsonHalfWidth(totals.hits, totals.samples) <= targetHalfWidth)
+		{
+			board.Stop();
+			return;
+		}
+	}
+}
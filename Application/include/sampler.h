@@ -0,0 +1,302 @@
+#pragma once
+
+#include <atomic>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <cstdint>
+#include <cstdlib>
+#include <cstdio>
+
+#if defined(__linux__)
+#include <csignal>
+#include <ctime>
+#include <cxxabi.h>
+#include <dlfcn.h>
+#include <pthread.h>
+#include <ucontext.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+
+#ifndef sigev_notify_thread_id
+#define sigev_notify_thread_id _sigev_un._tid // Missing from glibc before 2.35.
+#endif
+#endif
+
+/*
+	Statistical profiler, what the EASY_BLOCKs can't show: where the time goes inside a block, in code nobody annotated.
+	Every registered thread gets a timer of its own (timer_create on its cpu-time clock) that sends it SIGPROF every period of cpu time it burns.
+	The handler walks the frame pointers of the interrupted code and appends the return addresses to a buffer of the thread's, without allocating nor locking;
+	the stacks get counted when the thread unregisters and symbolized (dladdr, so the program is linked with -rdynamic) only when they're written.
+	The output is folded stacks, "Worker 0;caller;callee <weight>" per line, what flamegraph.pl, speedscope and inferno read. Weights are microseconds of cpu time, samples times the period,
+	so that they compare with "TraceExport --format=folded" of a capture of the same run, whose weights are microseconds of the blocks' self time.
+	Linux on x86-64 or AArch64 only, elsewhere Installed() is false. A single instance at a time, it owns SIGPROF.
+*/
+
+constexpr const unsigned DEFAULT_SAMPLING_HZ = 997; // Prime, so that sampling doesn't beat with anything periodic.
+
+class SamplingProfiler
+{
+private:
+	static constexpr size_t BUFFER_WORDS = 1 << 17; // 1 MiB per thread: a few thousand samples of a few dozen frames.
+	static constexpr size_t MAX_DEPTH = 64;
+
+	// Written by the handler only, read once the thread's timer is gone.
+	struct Buffer
+	{
+		std::unique_ptr<uintptr_t[]> frames; // Per sample: its depth, its weight in periods, then its return addresses, innermost first.
+		size_t used = 0;
+		size_t dropped = 0;
+		uintptr_t stackLow = 0;
+		uintptr_t stackHigh = 0;
+	};
+
+	static Buffer*& Current()
+	{
+		static thread_local Buffer* buffer = nullptr; // The executable's own TLS, safe to touch from a signal handler.
+		return buffer;
+	}
+
+public:
+	explicit SamplingProfiler(const unsigned hz) : periodNs_(1000000000ull / (hz ? hz : DEFAULT_SAMPLING_HZ))
+	{
+#if defined(__linux__) && (defined(__x86_64__) || defined(__aarch64__))
+		struct sigaction action = {};
+		action.sa_sigaction = &SamplingProfiler::Handler;
+		sigemptyset(&action.sa_mask);
+		action.sa_flags = SA_SIGINFO | SA_RESTART; // The workers' blocking calls don't fail with EINTR because of a sample.
+		installed_ = sigaction(SIGPROF, &action, &previous_) == 0;
+#endif
+	}
+
+	~SamplingProfiler()
+	{
+#if defined(__linux__)
+		if (installed_) sigaction(SIGPROF, &previous_, nullptr); // Registered threads are gone by now, their timers with them.
+#endif
+	}
+
+	SamplingProfiler(const SamplingProfiler&) = delete;
+	SamplingProfiler& operator=(const SamplingProfiler&) = delete;
+
+	bool Installed() const { return installed_; }
+	uint64_t PeriodNs() const { return periodNs_; }
+
+	size_t Samples() const
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		return samples_;
+	}
+
+	size_t Dropped() const // Samples that didn't fit in their thread's buffer.
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		return dropped_;
+	}
+
+	/*
+		Samples the calling thread from construction to destruction under the given name, the root frame of its stacks.
+		Threads of the same name are folded together, as the captures' threads are by the tools. A null or uninstalled profiler samples nothing.
+	*/
+	class Thread
+	{
+	public:
+		Thread(SamplingProfiler* profiler, std::string name)
+		{
+#if defined(__linux__)
+			if (!profiler || !profiler->installed_) return;
+			buffer_ = std::make_unique<Buffer>();
+			buffer_->frames.reset(new uintptr_t[BUFFER_WORDS]);
+			if (!StackBounds(buffer_->stackLow, buffer_->stackHigh)) return;
+			sigevent event = {};
+			event.sigev_notify = SIGEV_THREAD_ID;
+			event.sigev_signo = SIGPROF;
+			event.sigev_notify_thread_id = (pid_t)syscall(SYS_gettid);
+			if (timer_create(CLOCK_THREAD_CPUTIME_ID, &event, &timer_) != 0) return;
+			profiler_ = profiler;
+			name_ = std::move(name);
+			Current() = buffer_.get();
+			std::atomic_signal_fence(std::memory_order_seq_cst); // The buffer is there before the first signal.
+			itimerspec period = {};
+			period.it_interval.tv_sec = (time_t)(profiler->periodNs_ / 1000000000ull);
+			period.it_interval.tv_nsec = (long)(profiler->periodNs_ % 1000000000ull);
+			period.it_value = period.it_interval;
+			timer_settime(timer_, 0, &period, nullptr);
+#endif
+		}
+
+		~Thread()
+		{
+#if defined(__linux__)
+			if (!profiler_) return;
+			timer_delete(timer_);
+			Current() = nullptr; // A signal still pending stores nothing.
+			std::atomic_signal_fence(std::memory_order_seq_cst);
+			profiler_->Count(name_, *buffer_);
+#endif
+		}
+
+		Thread(const Thread&) = delete;
+		Thread& operator=(const Thread&) = delete;
+
+	private:
+#if defined(__linux__)
+		static bool StackBounds(uintptr_t& low, uintptr_t& high)
+		{
+			pthread_attr_t attributes;
+			if (pthread_getattr_np(pthread_self(), &attributes) != 0) return false;
+			void* address = nullptr;
+			size_t size = 0;
+			const bool found = pthread_attr_getstack(&attributes, &address, &size) == 0;
+			pthread_attr_destroy(&attributes);
+			low = (uintptr_t)address;
+			high = low + size;
+			return found;
+		}
+
+		timer_t timer_ = {};
+#endif
+		SamplingProfiler* profiler_ = nullptr;
+		std::unique_ptr<Buffer> buffer_;
+		std::string name_;
+	};
+
+	// Writes what the threads sampled so far as folded stacks, one line per distinct stack. Call once the sampled threads are done.
+	bool WriteFolded(std::ostream& out) const
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		std::unordered_map<uintptr_t, std::string> symbols; // Every address gets looked up once.
+		std::map<std::string, uint64_t> folded; // Stacks whose addresses differ but whose functions don't fold together.
+		for (const auto& [stack, count] : stacks_)
+		{
+			std::string line = stack.first;
+			for (auto frame = stack.second.rbegin(); frame != stack.second.rend(); ++frame) // Stored innermost first.
+			{
+				auto symbol = symbols.find(*frame);
+				if (symbol == symbols.end()) symbol = symbols.emplace(*frame, Symbolize(*frame)).first;
+				line += ";" + symbol->second;
+			}
+			folded[line] += count * periodNs_ / 1000;
+		}
+		for (const auto& [line, weight] : folded)
+		{
+			if (weight) out << line << " " << weight << "\n";
+		}
+		return (bool)out.flush();
+	}
+
+private:
+#if defined(__linux__) && (defined(__x86_64__) || defined(__aarch64__))
+	static void Handler(int, siginfo_t* info, void* context)
+	{
+		Buffer* buffer = Current();
+		if (!buffer) return;
+		const mcontext_t& registers = static_cast<ucontext_t*>(context)->uc_mcontext;
+#if defined(__x86_64__)
+		const uintptr_t pc = (uintptr_t)registers.gregs[REG_RIP];
+		uintptr_t fp = (uintptr_t)registers.gregs[REG_RBP];
+		const uintptr_t sp = (uintptr_t)registers.gregs[REG_RSP];
+#else
+		const uintptr_t pc = (uintptr_t)registers.pc;
+		uintptr_t fp = (uintptr_t)registers.regs[29];
+		const uintptr_t sp = (uintptr_t)registers.sp;
+#endif
+		if (buffer->used + 2 + MAX_DEPTH > BUFFER_WORDS)
+		{
+			buffer->dropped++;
+			return;
+		}
+		uintptr_t* sample = buffer->frames.get() + buffer->used;
+		size_t depth = 0;
+		sample[2 + depth++] = pc + 1; // Symbolized at address - 1 like the return addresses.
+		// Every frame starts with the caller's frame pointer and the return address. Only follow pointers going up the thread's own stack, code built without frame pointers leaves garbage in there.
+		const uintptr_t low = sp > buffer->stackLow ? sp : buffer->stackLow;
+		while (depth < MAX_DEPTH && fp >= low && fp + 2 * sizeof(uintptr_t) <= buffer->stackHigh && fp % sizeof(uintptr_t) == 0)
+		{
+			const uintptr_t* frame = reinterpret_cast<const uintptr_t*>(fp);
+			if (!frame[1]) break;
+			sample[2 + depth++] = frame[1];
+			if (frame[0] <= fp) break;
+			fp = frame[0];
+		}
+		sample[0] = depth;
+		sample[1] = 1 + (uintptr_t)(info->si_overrun > 0 ? info->si_overrun : 0); // Cpu-time timers only get checked on scheduler ticks, a coarser tick than the period fires once for several periods.
+		buffer->used += 2 + depth;
+	}
+#endif
+
+	void Count(const std::string& name, const Buffer& buffer)
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		for (size_t at = 0; at < buffer.used;)
+		{
+			const size_t depth = buffer.frames[at];
+			stacks_[{ name, std::vector<uintptr_t>(&buffer.frames[at + 2], &buffer.frames[at + 2 + depth]) }] += buffer.frames[at + 1];
+			samples_++;
+			at += 2 + depth;
+		}
+		dropped_ += buffer.dropped;
+	}
+
+	// "ns::f<T>" of "ns::f<T>(int, char) const", as stackcollapse-perf.pl tidies them: parameter lists make flame graphs unreadable and hardly tell functions apart.
+	static std::string WithoutParameters(const std::string& name)
+	{
+		const size_t close = name.find_last_of(')');
+		if (close == std::string::npos) return name;
+		int depth = 0;
+		for (size_t i = close + 1; i-- > 0;)
+		{
+			if (name[i] == ')') depth++;
+			else if (name[i] == '(' && --depth == 0) return i ? name.substr(0, i) : name;
+		}
+		return name;
+	}
+
+	// "function" of an address, "module+0xoffset" if it's not exported, without the ';' that separate frames.
+	static std::string Symbolize(const uintptr_t address)
+	{
+		std::string name;
+#if defined(__linux__)
+		Dl_info info = {};
+		if (dladdr(reinterpret_cast<void*>(address - 1), &info) && info.dli_sname)
+		{
+			int status = 0;
+			char* demangled = abi::__cxa_demangle(info.dli_sname, nullptr, nullptr, &status);
+			name = status == 0 && demangled ? WithoutParameters(demangled) : info.dli_sname;
+			std::free(demangled);
+		}
+		else if (info.dli_fname)
+		{
+			const std::string module = info.dli_fname;
+			char offset[32];
+			std::snprintf(offset, sizeof(offset), "+0x%llx", (unsigned long long)(address - 1 - (uintptr_t)info.dli_fbase));
+			name = module.substr(module.find_last_of('/') + 1) + offset;
+		}
+#endif
+		if (name.empty())
+		{
+			char hex[32];
+			std::snprintf(hex, sizeof(hex), "0x%llx", (unsigned long long)address);
+			name = hex;
+		}
+		for (char& c : name)
+		{
+			if (c == ';') c = ':';
+		}
+		return name;
+	}
+
+	const uint64_t periodNs_;
+	bool installed_ = false;
+#if defined(__linux__)
+	struct sigaction previous_ = {};
+#endif
+	mutable std::mutex mutex_;
+	std::map<std::pair<std::string, std::vector<uintptr_t>>, size_t> stacks_; // Thread name and return addresses, innermost first, to the periods they were sampled for.
+	size_t samples_ = 0;
+	size_t dropped_ = 0;
+};
@@ -0,0 +1,175 @@
+#pragma once
+
+#include <vector>
+#include <algorithm>
+#include <numeric>
+#include <cmath>
+
+/*
+	Descriptive statistics over a set of measurements.
+*/
+
+struct Summary
+{
+	size_t count = 0;
+	double min = 0.0;
+	double max = 0.0;
+	double median = 0.0;
+	double mean = 0.0;
+	double stddev = 0.0; // Sample standard deviation (n - 1 in the denominator).
+	double p99 = 0.0;
+
+	// Coefficient of variation, the spread relative to the mean. 0 when there's nothing to compare.
+	double Cv() const { return mean > 0.0 ? stddev / mean : 0.0; }
+};
+
+// Percentile with linear interpolation between the closest ranks. Expects sorted values.
+inline double Percentile(const std::vector<double>& sorted, const double percentile)
+{
+	if (sorted.empty()) return 0.0;
+	const double rank = percentile / 100.0 * (double)(sorted.size() - 1);
+	const size_t below = (size_t)std::floor(rank);
+	const size_t above = std::min(below + 1, sorted.size() - 1);
+	return sorted[below] + (sorted[above] - sorted[below]) * (rank - (double)below);
+}
+
+inline Summary Summarize(std::vector<double> values)
+{
+	Summary summary;
+	summary.count = values.size();
+	if (values.empty()) return summary;
+
+	std::sort(values.begin(), values.end());
+	summary.min = values.front();
+	summary.max = values.back();
+	summary.median = Percentile(values, 50.0);
+	summary.p99 = Percentile(values, 99.0);
+	summary.mean = std::accumulate(values.begin(), values.end(), 0.0) / (double)values.size();
+	if (values.size() > 1)
+	{
+		double squares = 0.0;
+		for (const double value : values)
+		{
+			squares += (value - summary.mean) * (value - summary.mean);
+		}
+		summary.stddev = std::sqrt(squares / (double)(values.size() - 1));
+	}
+	return summary;
+}
+
+// Outcome of a one-sided Mann-Whitney U test.
+struct RankTest
+{
+	double u = 0.0; // Number of (a, b) pairs where a is the larger one, ties counting for half.
+	double pValue = 1.0; // Probability of a U this small or smaller if both sets came from the same distribution.
+	bool exact = false; // Exact distribution rather than the normal approximation.
+};
+
+// Number of ways to arrange n1 + n2 untied values so that U equals each possible value. Exact U distribution up to a factor.
+inline std::vector<double> MannWhitneyCounts(const size_t n1, const size_t n2)
+{
+	// counts[i][j][u] for i values of the first set and j of the second, built up one value at a time.
+	std::vector<std::vector<std::vector<double>>> counts(n1 + 1, std::vector<std::vector<double>>(n2 + 1));
+	for (size_t i = 0; i <= n1; i++)
+	{
+		for (size_t j = 0; j <= n2; j++)
+		{
+			std::vector<double>& current = counts[i][j];
+			current.assign(i * j + 1, 0.0);
+			if (i == 0 || j == 0)
+			{
+				current[0] = 1.0;
+				continue;
+			}
+			for (size_t u = 0; u <= i * j; u++)
+			{
+				// Either the largest value belongs to the first set and beats all j values of the second, or it belongs to the second set.
+				if (u >= j && u - j < counts[i - 1][j].size()) current[u] += counts[i - 1][j][u - j];
+				if (u < counts[i][j - 1].size()) current[u] += counts[i][j - 1][u];
+			}
+		}
+	}
+	return counts[n1][n2];
+}
+
+// U of a against b from the ranks of the pooled values, n log n rather than comparing every pair so that thousands of block durations stay cheap.
+inline double MannWhitneyU(const std::vector<double>& a, const std::vector<double>& b, bool& ties)
+{
+	std::vector<std::pair<double, bool>> all; // Value, whether it comes from a.
+	all.reserve(a.size() + b.size());
+	for (const double x : a) all.emplace_back(x, true);
+	for (const double y : b) all.emplace_back(y, false);
+	std::sort(all.begin(), all.end(), [](const auto& x, const auto& y) { return x.first < y.first; });
+
+	double rankSum = 0.0; // Of a's values, tied values sharing the mean of their ranks.
+	ties = false;
+	for (size_t i = 0; i < all.size();)
+	{
+		size_t j = i;
+		size_t fromA = 0;
+		while (j < all.size() && all[j].first == all[i].first) fromA += all[j++].second ? 1 : 0;
+		if (j - i > 1) ties = true;
+		rankSum += (double)fromA * ((double)(i + 1) + (double)j) / 2.0;
+		i = j;
+	}
+	const double n1 = (double)a.size();
+	return rankSum - n1 * (n1 + 1.0) / 2.0;
+}
+
+/*
+	One-sided Mann-Whitney U test of whether the values of a tend to be smaller than those of b.
+	Makes no assumption about the shape of the distributions, which suits benchmark timings and their long tails.
+	Exact for small untied sets, normal approximation with tie and continuity corrections otherwise.
+*/
+inline RankTest MannWhitneyLess(const std::vector<double>& a, const std::vector<double>& b)
+{
+	RankTest test;
+	if (a.empty() || b.empty()) return test;
+
+	bool ties = false;
+	test.u = MannWhitneyU(a, b, ties);
+
+	const double n1 = (double)a.size(), n2 = (double)b.size();
+	if (!ties && a.size() <= 20 && b.size() <= 20)
+	{
+		const std::vector<double> counts = MannWhitneyCounts(a.size(), b.size());
+		const double total = std::accumulate(counts.begin(), counts.end(), 0.0);
+		double below = 0.0;
+		for (size_t u = 0; u <= (size_t)test.u; u++)
+		{
+			below += counts[u];
+		}
+		test.pValue = below / total;
+		test.exact = true;
+		return test;
+	}
+
+	// Variance of U shrinks with every group of tied values.
+	std::vector<double> all(a);
+	all.insert(all.end(), b.begin(), b.end());
+	std::sort(all.begin(), all.end());
+	double tieTerm = 0.0;
+	for (size_t i = 0; i < all.size();)
+	{
+		size_t j = i;
+		while (j < all.size() && all[j] == all[i]) j++;
+		const double tied = (double)(j - i);
+		tieTerm += tied * tied * tied - tied;
+		i = j;
+	}
+	const double n = n1 + n2;
+	const double variance = n1 * n2 / 12.0 * ((n + 1.0) - tieTerm / (n * (n - 1.0)));
+	if (variance <= 0.0) return test; // Every value is the same, nothing to tell apart.
+	const double z = (test.u + 0.5 - n1 * n2 / 2.0) / std::sqrt(variance);
+	test.pValue = 0.5 * std::erfc(-z / std::sqrt(2.0));
+	return test;
+}
+
+// Two-sided version: whether the values of a and b tend to differ in either direction.
+inline RankTest MannWhitneyTwoSided(const std::vector<double>& a, const std::vector<double>& b)
+{
+	RankTest less = MannWhitneyLess(a, b);
+	const RankTest greater = MannWhitneyLess(b, a);
+	less.pValue = std::min(1.0, 2.0 * std::min(less.pValue, greater.pValue));
+	return less;
+}
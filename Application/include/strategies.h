@@ -0,0 +1,58 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <functional>
+#include <algorithm>
+
+#include "config.h"
+#include "precision.h"
+#include "workingImplementation.h"
+#include "exercise.h"
+
+/*
+	Registry of every PI approximating strategy of both implementations, so the driver can pick them by name at run-time.
+*/
+
+struct Strategy
+{
+	std::string implementation; // "working" or "exercise".
+	std::string name; // "SingleThread", "Async" or "Threads".
+	bool multithreaded = false; // Whether the number of workers and the StrategyOptions mean anything to it.
+	bool publishesProgress = false; // Whether it publishes the hits and samples it drew on StrategyOptions::progress. The multithreaded ones also honour StrategyOptions::targetHalfWidth.
+	std::function<float(size_t iterations, size_t nrOfWorkers, const StrategyOptions& options)> run;
+	double variancePerSample = HIT_OR_MISS_VARIANCE; // Of a single sample's contribution to the estimate, what a variance reduction method would lower.
+
+	std::string FullName() const { return implementation + "::" + name; }
+};
+
+inline const std::vector<Strategy>& AllStrategies()
+{
+	static const std::vector<Strategy> strategies =
+	{
+		{ "working", "SingleThread", false, true, [](size_t iterations, size_t, const StrategyOptions& options) { return working::SingleThread(iterations, options); } },
+		{ "working", "Async", true, true, [](size_t iterations, size_t nrOfWorkers, const StrategyOptions& options) { return working::Async(iterations, nrOfWorkers, options); } },
+		{ "working", "Threads", true, true, [](size_t iterations, size_t nrOfWorkers, const StrategyOptions& options) { return working::Threads(iterations, nrOfWorkers, options); } },
+		{ "exercise", "SingleThread", false, false, [](size_t iterations, size_t, const StrategyOptions&) { return exercise::SingleThread(iterations); } },
+		{ "exercise", "Async", true, false, [](size_t iterations, size_t nrOfWorkers, const StrategyOptions& options) { return exercise::Async(iterations, nrOfWorkers, options); } },
+		{ "exercise", "Threads", true, false, [](size_t iterations, size_t nrOfWorkers, const StrategyOptions& options) { return exercise::Threads(iterations, nrOfWorkers, options); } },
+	};
+	return strategies;
+}
+
+// Strategies picked by the configuration, ordered by implementation first then in the order they were asked for.
+inline std::vector<const Strategy*> SelectStrategies(const BenchmarkConfig& config)
+{
+	std::vector<const Strategy*> selected;
+	for (const std::string& implementation : config.implementations)
+	{
+		for (const std::string& name : config.strategies)
+		{
+			for (const Strategy& strategy : AllStrategies())
+			{
+				if (strategy.implementation == implementation && strategy.name == name) selected.push_back(&strategy);
+			}
+		}
+	}
+	return selected;
+}
@@ -0,0 +1,361 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <map>
+#include <tuple>
+#include <utility>
+#include <cctype>
+#include <filesystem>
+#include <thread>
+#include <new>
+
+#if defined(__linux__)
+#include <sched.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#endif
+
+/*
+	CPU topology discovery and thread placement.
+	On Linux the topology is read from /sys/devices/system/cpu, on other platforms every logical CPU is treated as its own core on a single socket and pinning is a no-op.
+*/
+
+// Where the worker threads of a strategy are allowed to run.
+enum class PlacementPolicy
+{
+	OsDefault, // Don't pin anything, let the scheduler place and migrate workers as it sees fit. This is how the strategies behaved originally.
+	Compact, // Fill a core's SMT siblings first, then the next core, then the next socket. Workers share as much cache as possible.
+	Scatter, // Spread workers round-robin over sockets, then over cores. Workers get as much cache and memory bandwidth each as possible.
+	PhysicalCoresFirst, // One worker per physical core before any SMT sibling gets used.
+	IsolatedOnly // Only use the CPUs listed in /sys/devices/system/cpu/isolated (isolcpus= kernel parameter).
+};
+
+inline const char* ToString(const PlacementPolicy policy)
+{
+	switch (policy)
+	{
+		case PlacementPolicy::Compact: return "compact";
+		case PlacementPolicy::Scatter: return "scatter";
+		case PlacementPolicy::PhysicalCoresFirst: return "physical";
+		case PlacementPolicy::IsolatedOnly: return "isolated";
+		default: return "os";
+	}
+}
+
+struct LogicalCpu
+{
+	int id = 0; // Number the kernel uses for this CPU, as in /sys/devices/system/cpu/cpu<id>.
+	int core = 0; // core_id, only unique within a package.
+	int package = 0; // physical_package_id, in other words the socket.
+	int node = 0; // NUMA node the CPU belongs to.
+	int smtIndex = 0; // 0 for the first hardware thread of a core, 1 for its SMT sibling and so on.
+	bool isolated = false; // Whether the CPU is excluded from general scheduling by isolcpus=.
+};
+
+struct CpuTopology
+{
+	std::vector<LogicalCpu> cpus; // Only the CPUs this process is allowed to run on.
+	std::vector<LogicalCpu> isolated; // The CPUs of isolcpus= a thread can be pinned to, in the affinity mask or not: the kernel leaves them out of the default one.
+	size_t nrOfNodes = 1;
+};
+
+// Parses the kernel's cpu list format, ex: "0-3,8,10-11".
+inline std::vector<int> ParseCpuList(const std::string& list)
+{
+	std::vector<int> cpus;
+	std::stringstream ss(list);
+	std::string range;
+	while (std::getline(ss, range, ','))
+	{
+		range.erase(std::remove_if(range.begin(), range.end(), [](const char c) { return c == ' ' || c == '\n'; }), range.end());
+		if (range.empty()) continue;
+
+		const size_t dash = range.find('-');
+		try
+		{
+			const int first = std::stoi(range.substr(0, dash));
+			const int last = dash == std::string::npos ? first : std::stoi(range.substr(dash + 1));
+			for (int cpu = first; cpu <= last; cpu++)
+			{
+				cpus.push_back(cpu);
+			}
+		}
+		catch (const std::exception&) {} // Malformed entry, ignore it rather than failing the whole discovery.
+	}
+	return cpus;
+}
+
+// Reads the first line of a sysfs file, returns an empty string if the file doesn't exist.
+inline std::string ReadSysfsLine(const std::string& path)
+{
+	std::ifstream file(path);
+	std::string line;
+	std::getline(file, line);
+	return line;
+}
+
+inline int ReadSysfsInt(const std::string& path, const int fallback)
+{
+	try
+	{
+		return std::stoi(ReadSysfsLine(path));
+	}
+	catch (const std::exception&)
+	{
+		return fallback;
+	}
+}
+
+// CPUs the calling thread is allowed to run on, in ascending order.
+inline std::vector<int> AllowedCpus()
+{
+	std::vector<int> cpus;
+#if defined(__linux__)
+	cpu_set_t set;
+	CPU_ZERO(&set);
+	if (sched_getaffinity(0, sizeof(set), &set) == 0)
+	{
+		for (int cpu = 0; cpu < CPU_SETSIZE; cpu++)
+		{
+			if (CPU_ISSET(cpu, &set)) cpus.push_back(cpu);
+		}
+	}
+#endif
+	if (cpus.empty())
+	{
+		const int count = std::max(1, (int)std::thread::hardware_concurrency());
+		for (int cpu = 0; cpu < count; cpu++)
+		{
+			cpus.push_back(cpu);
+		}
+	}
+	return cpus;
+}
+
+inline LogicalCpu ReadLogicalCpu(const std::string& root, const int id, const std::vector<int>& isolated, CpuTopology& topology)
+{
+	const std::string dir = root + "cpu" + std::to_string(id) + "/";
+	LogicalCpu cpu;
+	cpu.id = id;
+	cpu.core = ReadSysfsInt(dir + "topology/core_id", id);
+	cpu.package = std::max(0, ReadSysfsInt(dir + "topology/physical_package_id", 0)); // Some virtual machines report -1.
+	cpu.isolated = std::find(isolated.begin(), isolated.end(), id) != isolated.end();
+
+	const std::vector<int> siblings = ParseCpuList(ReadSysfsLine(dir + "topology/thread_siblings_list"));
+	const auto self = std::find(siblings.begin(), siblings.end(), id);
+	cpu.smtIndex = self == siblings.end() ? 0 : (int)(self - siblings.begin());
+
+	// The NUMA node shows up as a "node<N>" entry in the cpu's directory.
+	std::error_code error;
+	for (const auto& entry : std::filesystem::directory_iterator(dir, error))
+	{
+		const std::string name = entry.path().filename().string();
+		if (name.rfind("node", 0) == 0 && name.size() > 4 && std::isdigit((unsigned char)name[4]))
+		{
+			cpu.node = std::stoi(name.substr(4));
+			topology.nrOfNodes = std::max(topology.nrOfNodes, (size_t)cpu.node + 1);
+			break;
+		}
+	}
+	return cpu;
+}
+
+// Which of the cpus a thread can be pinned to, tried from a thread of its own so that the caller's affinity stays as it is. A cpuset cgroup can forbid cpus outside of the affinity mask.
+inline std::vector<int> PinnableCpus(const std::vector<int>& cpus)
+{
+	std::vector<int> pinnable;
+#if defined(__linux__)
+	std::thread([&cpus, &pinnable]()
+	{
+		for (const int id : cpus)
+		{
+			if (id < 0 || id >= CPU_SETSIZE) continue;
+			cpu_set_t set;
+			CPU_ZERO(&set);
+			CPU_SET(id, &set);
+			if (sched_setaffinity(0, sizeof(set), &set) == 0) pinnable.push_back(id);
+		}
+	}).join();
+#else
+	(void)cpus;
+#endif
+	return pinnable;
+}
+
+inline CpuTopology DiscoverTopology()
+{
+	CpuTopology topology;
+	const std::string root = "/sys/devices/system/cpu/";
+	const std::vector<int> isolated = ParseCpuList(ReadSysfsLine(root + "isolated"));
+
+	for (const int id : AllowedCpus())
+	{
+		topology.cpus.push_back(ReadLogicalCpu(root, id, isolated, topology));
+	}
+	for (const int id : PinnableCpus(isolated))
+	{
+		topology.isolated.push_back(ReadLogicalCpu(root, id, isolated, topology));
+	}
+	return topology;
+}
+
+// Topology of the machine as seen at the first call. Reading sysfs isn't free so strategies use this cached copy.
+inline const CpuTopology& SystemTopology()
+{
+	static const CpuTopology topology = DiscoverTopology();
+	return topology;
+}
+
+/*
+	Returns the cpu each worker should be pinned to according to the policy, -1 meaning "don't pin".
+	When there are more workers than eligible CPUs, the order wraps around.
+*/
+inline std::vector<int> PlanPlacement(const CpuTopology& topology, const PlacementPolicy policy, const size_t nrOfWorkers)
+{
+	std::vector<int> plan(nrOfWorkers, -1);
+	if (policy == PlacementPolicy::OsDefault) return plan;
+
+	std::vector<LogicalCpu> order = policy == PlacementPolicy::IsolatedOnly ? topology.isolated : topology.cpus;
+
+	// Rank of each cpu's core within its package, so that scatter can interleave sockets with a different number of cores. Computed once, the comparator runs O(n log n) times.
+	std::map<int, std::vector<int>> packageCores; // Sorted, distinct core ids of every package.
+	for (const LogicalCpu& cpu : topology.cpus) packageCores[cpu.package].push_back(cpu.core);
+	for (auto& [package, cores] : packageCores)
+	{
+		std::sort(cores.begin(), cores.end());
+		cores.erase(std::unique(cores.begin(), cores.end()), cores.end());
+	}
+	std::vector<std::pair<int, LogicalCpu>> ranked; // Core rank and cpu.
+	ranked.reserve(order.size());
+	for (const LogicalCpu& cpu : order)
+	{
+		const std::vector<int>& cores = packageCores[cpu.package]; // Isolated cpus outside of the affinity mask may have a package of their own.
+		ranked.emplace_back((int)(std::lower_bound(cores.begin(), cores.end(), cpu.core) - cores.begin()), cpu);
+	}
+
+	std::stable_sort(ranked.begin(), ranked.end(), [policy](const std::pair<int, LogicalCpu>& x, const std::pair<int, LogicalCpu>& y)
+	{
+		const LogicalCpu& a = x.second;
+		const LogicalCpu& b = y.second;
+		switch (policy)
+		{
+			case PlacementPolicy::Scatter: return std::make_tuple(a.smtIndex, x.first, a.package) < std::make_tuple(b.smtIndex, y.first, b.package);
+			case PlacementPolicy::PhysicalCoresFirst: return std::make_tuple(a.smtIndex, a.package, a.core) < std::make_tuple(b.smtIndex, b.package, b.core);
+			default: return std::make_tuple(a.package, a.core, a.smtIndex) < std::make_tuple(b.package, b.core, b.smtIndex); // Compact and IsolatedOnly.
+		}
+	});
+	for (size_t i = 0; i < ranked.size(); i++) order[i] = ranked[i].second;
+
+	if (order.empty()) return plan; // Ex: IsolatedOnly on a machine without isolated CPUs, leave it to the OS. The fingerprint warns about it.
+
+	for (size_t worker = 0; worker < nrOfWorkers; worker++)
+	{
+		plan[worker] = order[worker % order.size()].id;
+	}
+	return plan;
+}
+
+inline int NodeOfCpu(const CpuTopology& topology, const int cpu)
+{
+	for (const std::vector<LogicalCpu>* cpus : { &topology.cpus, &topology.isolated })
+	{
+		for (const LogicalCpu& logical : *cpus)
+		{
+			if (logical.id == cpu) return logical.node;
+		}
+	}
+	return 0;
+}
+
+// Pins the calling thread to a single cpu. Returns false if pinning isn't supported or was refused.
+inline bool PinCurrentThread(const int cpu)
+{
+#if defined(__linux__)
+	if (cpu < 0 || cpu >= CPU_SETSIZE) return false;
+	cpu_set_t set;
+	CPU_ZERO(&set);
+	CPU_SET(cpu, &set);
+	return sched_setaffinity(0, sizeof(set), &set) == 0;
+#else
+	(void)cpu;
+	return false;
+#endif
+}
+
+// CPU the calling thread is running on right now, -1 if unknown.
+inline int CurrentCpu()
+{
+#if defined(__linux__)
+	return sched_getcpu();
+#else
+	return -1;
+#endif
+}
+
+/*
+	Allocates memory whose pages are bound to a NUMA node.
+	The memory policy is set through the raw mbind syscall so there's no dependency on libnuma. If that fails the pages are simply first-touched by the calling thread,
+	which is the kernel's default policy and lands on the local node as long as the caller is pinned.
+*/
+inline void* AllocateOnNode(const size_t bytes, const int node)
+{
+#if defined(__linux__)
+	void* memory = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (memory == MAP_FAILED) throw std::bad_alloc();
+#if defined(SYS_mbind)
+	if (node >= 0 && node < 64)
+	{
+		constexpr int MPOL_PREFERRED_MODE = 1; // Same value as MPOL_PREFERRED in <numaif.h>. Preferred rather than bound so we never OOM on a full node.
+		const unsigned long mask = 1ul << node;
+		syscall(SYS_mbind, memory, bytes, MPOL_PREFERRED_MODE, &mask, sizeof(mask) * 8 + 1, 0); // The kernel reads maxnode - 1 bits, node 63 included only with the + 1.
+	}
+#endif
+	std::fill_n((char*)memory, bytes, 0); // Touch every page now so they get placed before the hot loop starts.
+	return memory;
+#else
+	(void)node;
+	return ::operator new(bytes);
+#endif
+}
+
+inline void FreeOnNode(void* memory, const size_t bytes)
+{
+#if defined(__linux__)
+	munmap(memory, bytes);
+#else
+	(void)bytes;
+	::operator delete(memory);
+#endif
+}
+
+// Owns a single T living in memory allocated on a given NUMA node.
+template <typename T>
+class NodeLocal
+{
+public:
+	template <typename... Args>
+	explicit NodeLocal(const int node, Args&&... args)
+		: memory_(AllocateOnNode(sizeof(T), node))
+	{
+		value_ = new (memory_) T(std::forward<Args>(args)...);
+	}
+	~NodeLocal()
+	{
+		value_->~T();
+		FreeOnNode(memory_, sizeof(T));
+	}
+	NodeLocal(const NodeLocal&) = delete;
+	NodeLocal& operator=(const NodeLocal&) = delete;
+
+	T& operator*() { return *value_; }
+	T* operator->() { return value_; }
+
+private:
+	void* memory_;
+	T* value_;
+};
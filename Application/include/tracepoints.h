@@ -0,0 +1,34 @@
+#pragma once
+
+/*
+	USDT static tracepoints of the strategies, for bpftrace, perf or SystemTap to attach to a running program without rebuilding it, unlike the EASY_BLOCKs and their instrumentation level.
+	A probe that nothing is attached to is a single nop in the code and a note in the binary's .note.stapsdt section, cheap enough for every build.
+	They come from systemtap's <sys/sdt.h> (package systemtap-sdt-dev or systemtap-sdt-devel), without it they compile to nothing.
+	Every probe belongs to the "pi" provider and carries a worker, a number of samples and a number of hits:
+		strategy_start(workers, iterations, 0, strategy name)    strategy_end(workers, samples drawn, hits, strategy name)
+		worker_start(worker id, samples to draw, 0)             worker_end(worker id, samples drawn, hits)
+		chunk_done(worker id, samples so far, hits so far)       result_retrieved(worker id, samples drawn, hits)
+	SingleThread's loop isn't chunked and runs on the calling thread: it only fires the strategy probes and worker_start and worker_end of worker 0.
+	Arguments are evaluated even when nothing is attached, so they're locals the strategies already have rather than reads of shared state.
+	ex: bpftrace -e 'usdt:./Application/bin/Application:pi:worker_end { printf("worker %d drew %d samples\n", arg0, arg1); }'
+	"readelf -n Application" lists the probes a binary was built with.
+*/
+
+#if defined(__has_include)
+#if __has_include(<sys/sdt.h>) && !defined(PI_NO_TRACEPOINTS)
+#include <sys/sdt.h>
+#define PI_TRACEPOINTS 1
+#endif
+#endif
+
+#ifndef PI_TRACEPOINTS
+#define PI_TRACEPOINTS 0
+#endif
+
+#if PI_TRACEPOINTS
+#define PI_PROBE(name, worker, samples, hits) STAP_PROBE3(pi, name, (unsigned long long)(worker), (unsigned long long)(samples), (unsigned long long)(hits))
+#define PI_STRATEGY_PROBE(name, workers, samples, hits, strategy) STAP_PROBE4(pi, name, (unsigned long long)(workers), (unsigned long long)(samples), (unsigned long long)(hits), (const char*)(strategy))
+#else
+#define PI_PROBE(name, worker, samples, hits)
+#define PI_STRATEGY_PROBE(name, workers, samples, hits, strategy)
+#endif
@@ -0,0 +1,153 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <cstdlib>
+#include <cmath>
+#include <thread>
+
+#include "topology.h"
+
+/*
+	Figures out how many workers the process can actually keep busy.
+	hardware_concurrency() alone overestimates it: the affinity mask (taskset, cpusets) and the cgroup CPU quota of a container both cap it further,
+	and running more workers than the quota allows gets the whole process throttled for the rest of each scheduling period.
+*/
+
+struct CpuBudget
+{
+	size_t hardwareThreads = 1; // std::thread::hardware_concurrency().
+	size_t affinityCpus = 1; // CPUs in the process' affinity mask.
+	double cgroupQuota = 0.0; // CPUs worth of time the cgroup quota allows per period, 0 when unlimited.
+	std::string quotaSource; // File the quota was read from, empty when unlimited.
+	size_t effective = 1; // What all of the above leave us with, never less than 1.
+};
+
+// Reads a cgroup v2 "cpu.max" file ("<quota> <period>" or "max <period>"). Returns 0 if unlimited or unreadable.
+inline double ReadCgroupV2Quota(const std::string& path)
+{
+	std::ifstream file(path);
+	std::string quota;
+	double period = 0.0;
+	if (!(file >> quota >> period) || quota == "max" || period <= 0.0) return 0.0;
+	try
+	{
+		return std::stod(quota) / period;
+	}
+	catch (const std::exception&)
+	{
+		return 0.0;
+	}
+}
+
+// Reads cgroup v1 "cpu.cfs_quota_us" and "cpu.cfs_period_us" in a directory. Returns 0 if unlimited or unreadable.
+inline double ReadCgroupV1Quota(const std::string& dir)
+{
+	std::ifstream quotaFile(dir + "/cpu.cfs_quota_us");
+	std::ifstream periodFile(dir + "/cpu.cfs_period_us");
+	double quota = -1.0, period = 0.0;
+	if (!(quotaFile >> quota) || !(periodFile >> period) || quota <= 0.0 || period <= 0.0) return 0.0;
+	return quota / period;
+}
+
+/*
+	Smallest quota found on the way from the process' cgroup up to the hierarchy's root, since a parent's limit applies to all its children.
+	Inside a container the cgroup path of /proc/self/cgroup may not exist under the mount point (cgroup namespaces), in which case only the mount point itself is checked.
+*/
+inline double FindCgroupQuota(std::string& source)
+{
+	std::ifstream cgroups("/proc/self/cgroup");
+	std::string line;
+	double best = 0.0;
+	const auto consider = [&best, &source](const double quota, const std::string& from)
+	{
+		if (quota > 0.0 && (best == 0.0 || quota < best))
+		{
+			best = quota;
+			source = from;
+		}
+	};
+
+	while (std::getline(cgroups, line))
+	{
+		// Lines look like "<id>:<controllers>:<path>". cgroup v2 has an empty controller list.
+		const size_t first = line.find(':');
+		const size_t second = line.find(':', first + 1);
+		if (first == std::string::npos || second == std::string::npos) continue;
+		const std::string controllers = line.substr(first + 1, second - first - 1);
+		std::string path = line.substr(second + 1);
+
+		std::vector<std::string> mounts;
+		bool isV2 = false;
+		if (controllers.empty())
+		{
+			isV2 = true;
+			mounts = { "/sys/fs/cgroup", "/sys/fs/cgroup/unified" };
+		}
+		else
+		{
+			std::stringstream ss(controllers);
+			std::string controller;
+			bool hasCpu = false;
+			while (std::getline(ss, controller, ','))
+			{
+				hasCpu |= controller == "cpu";
+			}
+			if (!hasCpu) continue;
+			mounts = { "/sys/fs/cgroup/" + controllers, "/sys/fs/cgroup/cpu,cpuacct", "/sys/fs/cgroup/cpu" };
+		}
+
+		for (const std::string& mount : mounts)
+		{
+			std::string dir = path;
+			while (true)
+			{
+				const std::string full = mount + (dir == "/" ? "" : dir);
+				if (isV2) consider(ReadCgroupV2Quota(full + "/cpu.max"), full + "/cpu.max");
+				else consider(ReadCgroupV1Quota(full), full + "/cpu.cfs_quota_us");
+				if (dir.empty() || dir == "/") break;
+				dir = dir.substr(0, dir.find_last_of('/'));
+				if (dir.empty()) dir = "/";
+			}
+		}
+	}
+	return best;
+}
+
+inline CpuBudget DetectCpuBudget()
+{
+	CpuBudget budget;
+	budget.hardwareThreads = std::max(1u, std::thread::hardware_concurrency());
+	budget.affinityCpus = std::max((size_t)1, AllowedCpus().size());
+	budget.cgroupQuota = FindCgroupQuota(budget.quotaSource);
+
+	budget.effective = std::min(budget.hardwareThreads, budget.affinityCpus);
+	if (budget.cgroupQuota > 0.0)
+	{
+		// Rounded down: with a quota of 2.5 CPUs, a third worker would only ever get half a CPU and make the whole run wait for it.
+		budget.effective = std::min(budget.effective, (size_t)std::floor(budget.cgroupQuota));
+	}
+	budget.effective = std::max((size_t)1, budget.effective);
+	return budget;
+}
+
+/*
+	Number of workers the strategies use when they aren't told otherwise.
+	The PI_NR_OF_WORKERS environment variable overrides the detected budget, ex: PI_NR_OF_WORKERS=8 ./Application
+*/
+inline size_t DefaultWorkerCount()
+{
+	static const size_t count = []()
+	{
+		if (const char* overridden = std::getenv("PI_NR_OF_WORKERS"))
+		{
+			const long long value = std::atoll(overridden);
+			if (value > 0) return (size_t)value;
+		}
+		return DetectCpuBudget().effective;
+	}();
+	return count;
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <vector>
+#include <chrono>
+
+#include "perfCounters.h"
+#include "progress.h"
+#include "sampler.h"
+#include "topology.h"
+#include "workerCount.h"
+
+/*
+	Bookkeeping shared by the strategies that kick off worker threads.
+*/
+
+// What a single worker observed about where it ran.
+struct WorkerReport
+{
+	size_t workerId = 0;
+	int requestedCpu = -1; // Cpu the placement policy pinned the worker to, -1 if the OS was left in charge.
+	int firstCpu = -1; // Cpu the worker started computing on.
+	int lastCpu = -1; // Cpu the worker finished computing on.
+	int node = 0; // NUMA node the worker's state was allocated on.
+	size_t migrations = 0; // Number of times the worker was found on another cpu than at the previous check.
+	size_t samples = 0; // Samples the worker drew, fewer than its share if it was stopped early.
+	CounterReading counters; // Hardware counters of the worker's sampling loop, left unavailable unless StrategyOptions::countEvents is set.
+};
+
+// Optional knobs of the multithreaded strategies. Default constructed options reproduce the original behaviour.
+struct StrategyOptions
+{
+	PlacementPolicy placement = PlacementPolicy::OsDefault;
+	std::vector<WorkerReport>* reports = nullptr; // If set, receives one report per worker once the strategy returns.
+	bool countEvents = false; // Whether workers wrap their sampling loop in perf counters.
+	double targetHalfWidth = 0.0; // If set, stop as soon as the 95% confidence interval of PI is this narrow. The iterations become a cap.
+	std::chrono::milliseconds valueInterval{ 0 }; // If set and instrumented at the workers level or finer, workers record their hits, samples and chunk throughput as easy_profiler values at most this often.
+	ProgressBoard* progress = nullptr; // If set, workers publish their progress there, ex: to know how many samples were actually drawn. A board of the strategy's own is used otherwise.
+	SamplingProfiler* sampler = nullptr; // If set, workers get their stacks sampled for as long as they run.
+};
+
+/*
+	Pins the calling worker thread according to the plan and keeps track of the cpus it runs on afterwards.
+	Construct it first thing in a worker so that anything allocated afterwards gets first-touched on the right node.
+*/
+class WorkerPlacement
+{
+public:
+	WorkerPlacement(const size_t workerId, const int cpu)
+	{
+		report_.workerId = workerId;
+		report_.requestedCpu = cpu;
+		if (cpu >= 0 && PinCurrentThread(cpu))
+		{
+			report_.node = NodeOfCpu(SystemTopology(), cpu);
+		}
+		else
+		{
+			report_.requestedCpu = -1; // Pinning failed or wasn't asked for, report it as OS placement.
+			const int current = CurrentCpu();
+			report_.node = current < 0 ? 0 : NodeOfCpu(SystemTopology(), current);
+		}
+		report_.firstCpu = report_.lastCpu = CurrentCpu();
+	}
+
+	int Node() const { return report_.node; }
+
+	// Call between chunks of work, sched_getcpu is cheap but not free enough for every sample.
+	void Check()
+	{
+		const int cpu = CurrentCpu();
+		if (cpu != report_.lastCpu)
+		{
+			report_.migrations++;
+			report_.lastCpu = cpu;
+		}
+	}
+
+	const WorkerReport& Report() const { return report_; }
+
+private:
+	WorkerReport report_;
+};
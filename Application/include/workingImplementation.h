@@ -1,8 +1,22 @@
+#pragma once
+
 #include <random>
 #include <thread>
 #include <future>
+#include <cmath>
+#include <algorithm>
+#include <optional>
+#include <chrono>
+#include <string>
+#include <stdexcept>
+
+#include "instrumentation.h"
+#include "tracepoints.h"
+#include "workers.h"
 
-#include <easy/profiler.h>
+// The working implementation lives in its own namespace so the driver can run it side by side with the exercise.
+namespace working
+{
 
 /*
 	Disclaimer: this implementation does not ensure that the approximations generated are identical!
@@ -12,13 +26,106 @@
 
 inline float Magnitude(const float x, const float y)
 {
-	return std::sqrtf(x * x + y * y);
+	return std::sqrt(x * x + y * y); // std::sqrt has a float overload, std::sqrtf is missing from some standard libraries.
+}
+
+// Samples the given worker draws: an even share of the iterations, the first iterations % nrOfWorkers workers drawing one more so that none of them get dropped.
+inline size_t WorkerShare(const size_t iterations, const size_t nrOfWorkers, const size_t workerId)
+{
+	return iterations / nrOfWorkers + (workerId < iterations % nrOfWorkers ? 1 : 0);
+}
+
+// More workers than samples would leave some with nothing to draw.
+inline void CheckWorkerCount(const size_t iterations, const size_t nrOfWorkers)
+{
+	if (nrOfWorkers == 0 || nrOfWorkers > iterations) throw std::invalid_argument(std::to_string(nrOfWorkers) + " workers can't share " + std::to_string(iterations) + " iterations.");
+}
+
+// Number of samples a worker draws between two bookkeeping points (checking which cpu it's running on, ...). Big enough for the bookkeeping to vanish in the noise.
+constexpr const size_t CHUNK_SIZE = 65536;
+
+// Everything a worker touches in its hot loop. Allocated on the worker's NUMA node once it has been pinned.
+struct WorkerState
+{
+	explicit WorkerState(const size_t seed) : e((std::default_random_engine::result_type)seed) {}
+
+	std::default_random_engine e;
+	std::uniform_real_distribution<float> d{ -1.0f, 1.0f };
+	size_t insideCircle = 0;
+};
+
+// Draws samples in chunks on a pinned worker's local state, publishing its progress after every chunk and stopping early if asked to. Shared by the approximatePi subroutines of Async and Threads.
+inline size_t ApproximatePiChunked(const size_t samples, const size_t workerId, const int cpu, const StrategyOptions& options, ProgressBoard& board, WorkerReport& report)
+{
+	WORKER_THREAD(("Worker " + std::to_string(workerId)).c_str()); // Names the thread in captures, once per thread.
+	const SamplingProfiler::Thread sampled(options.sampler, "Worker " + std::to_string(workerId)); // Named like in captures, so that both fold the same way.
+	WorkerPlacement placement(workerId, cpu); // Pin first so that the state below gets allocated on the right NUMA node.
+	NodeLocal<WorkerState> state(placement.Node(), workerId);
+	std::optional<PerfCounters> counters; // Opened before the loop so that opening them isn't counted.
+	if (options.countEvents) counters.emplace();
+	std::default_random_engine& e = state->e;
+	std::uniform_real_distribution<float>& d = state->d;
+	float x = 0.0f, y = 0.0f;
+	size_t insideCircle = 0; // Counted in a local so the compiler can keep it in a register, written back to the state after every chunk.
+	size_t drawn = 0;
+#if PI_INSTRUMENTATION >= PI_INSTRUMENTATION_WORKERS
+	auto lastValueTime = std::chrono::steady_clock::now(); // Values get recorded at the configured cadence, not every chunk, to keep them cheap.
+	size_t lastValueSamples = 0;
+#endif
+	PI_PROBE(worker_start, workerId, samples, 0);
+	if (counters) counters->Start();
+	for (size_t done = 0; done < samples; done += CHUNK_SIZE)
+	{
+		const size_t chunk = std::min(CHUNK_SIZE, samples - done);
+		{
+			CHUNK_BLOCK("Sampling chunk.", profiler::colors::Amber100);
+			for (size_t i = 0; i < chunk; i++)
+			{
+				x = d(e);
+				y = d(e);
+				if (Magnitude(x, y) <= 1.0f)
+				{
+					insideCircle++;
+				}
+			}
+		}
+		state->insideCircle = insideCircle;
+		drawn = done + chunk;
+		board.Publish(workerId, insideCircle, drawn);
+		PI_PROBE(chunk_done, workerId, drawn, insideCircle);
+#if PI_INSTRUMENTATION >= PI_INSTRUMENTATION_WORKERS
+		if (options.valueInterval.count() > 0)
+		{
+			const auto now = std::chrono::steady_clock::now();
+			if (now - lastValueTime >= options.valueInterval)
+			{
+				const double seconds = std::chrono::duration<double>(now - lastValueTime).count();
+				EASY_VALUE("Worker hits", (uint64_t)insideCircle, EASY_GLOBAL_VIN, profiler::colors::Green);
+				EASY_VALUE("Worker samples", (uint64_t)(done + chunk), EASY_GLOBAL_VIN, profiler::colors::Blue);
+				EASY_VALUE("Worker samples/s", (double)(done + chunk - lastValueSamples) / seconds, EASY_GLOBAL_VIN, profiler::colors::Orange);
+				lastValueTime = now;
+				lastValueSamples = done + chunk;
+			}
+		}
+#endif
+		placement.Check();
+		if (board.Stopped()) break; // The coordinator has enough samples for the precision asked for.
+	}
+	const CounterReading reading = counters ? counters->Stop() : CounterReading{};
+	PI_PROBE(worker_end, workerId, drawn, insideCircle); // Probe arguments get evaluated whether or not anything is attached, locals only.
+	report = placement.Report();
+	report.counters = reading;
+	report.samples = drawn;
+	return state->insideCircle;
 }
 
 // Approximates PI on a single thread. Baseline case to compare against.
-float SingleThread(const size_t iterations)
+float SingleThread(const size_t iterations, const StrategyOptions& options = {})
 {
-	EASY_BLOCK("SingleThread approach.", profiler::colors::Green);
+	PHASE_BLOCK("SingleThread approach.", profiler::colors::Green);
+	PI_STRATEGY_PROBE(strategy_start, 1, iterations, 0, "SingleThread");
+	if (options.progress) options.progress->Reset(1); // Published once at the end, the loop isn't chunked.
+	PI_PROBE(worker_start, 0, iterations, 0); // The calling thread is the only worker, no chunk_done nor result_retrieved.
 
 	// Default seed is: 5489 (unsigned).
 	std::default_random_engine e; // Random engine we'll be using to generate random floats.
@@ -36,104 +143,132 @@ float SingleThread(const size_t iterations)
 		}
 	}
 
+	if (options.progress) options.progress->Publish(0, insideCircleCount, iterations);
+	PI_PROBE(worker_end, 0, iterations, insideCircleCount);
+	PI_STRATEGY_PROBE(strategy_end, 1, iterations, insideCircleCount, "SingleThread");
 	return 4.0f * (float)insideCircleCount / (float)iterations; // Compute approximation of PI using the ratio of points inside the unit circle vs. points inside the unit square.
 }
 
+// The estimate from the samples the workers actually drew, which is fewer than asked for if they were stopped early.
+inline float EstimateFromBoard(const ProgressBoard& board)
+{
+	const ProgressTotals totals = board.Totals();
+	return totals.samples ? 4.0f * (float)totals.hits / (float)totals.samples : 0.0f;
+}
+
 // Approximates PI by kicking off smaller pi approximating subroutines but lets them instanciate their own random number generators.
-float Async(const size_t iterations, const size_t nrOfWorkers)
+float Async(const size_t iterations, const size_t nrOfWorkers = DefaultWorkerCount(), const StrategyOptions& options = {})
 {
-	EASY_BLOCK("Async method.", profiler::colors::Red);
+	PHASE_BLOCK("Async method.", profiler::colors::Red);
+	CheckWorkerCount(iterations, nrOfWorkers);
+	PI_STRATEGY_PROBE(strategy_start, nrOfWorkers, iterations, 0, "Async");
 
-	// Implementation of the PI approximating function, but this time with a local random engine.
-	const auto approximatePi = [](const size_t iterations, const size_t nrOfWorkers, const size_t workerId)->size_t
+	// Implementation of the PI approximating function, but this time with a local random engine living on the worker's NUMA node.
+	const auto approximatePi = [](const size_t iterations, const size_t nrOfWorkers, const size_t workerId, const int cpu, const StrategyOptions& options, ProgressBoard& board, WorkerReport& report)->size_t
 	{
-		EASY_BLOCK("Approximation subroutine.", profiler::colors::Red100);
-		std::default_random_engine e(workerId);
-		std::uniform_real_distribution<float> d(-1.0f, 1.0f);
-		float x = 0.0f, y = 0.0f;
-		size_t insideCircle = 0;
-		for (size_t i = 0; i < iterations / nrOfWorkers; i++)
-		{
-			x = d(e);
-			y = d(e);
-			if (Magnitude(x, y) <= 1.0f)
-			{
-				insideCircle++;
-			}
-		}
-		return insideCircle;
+		WORKER_BLOCK("Approximation subroutine.", profiler::colors::Red100);
+		return ApproximatePiChunked(WorkerShare(iterations, nrOfWorkers, workerId), workerId, cpu, options, board, report);
 	};
 
+	ProgressBoard ownBoard;
+	ProgressBoard& board = options.progress ? *options.progress : ownBoard;
+	board.Reset(nrOfWorkers);
+
+	const std::vector<int> cpus = PlanPlacement(SystemTopology(), options.placement, nrOfWorkers); // Which cpu each worker gets pinned to, if any.
+	std::vector<WorkerReport> reports(nrOfWorkers);
 	std::vector<std::future<size_t>> futures(nrOfWorkers);
 	{
-		EASY_BLOCK("Kicking off threads.", profiler::colors::Red100);
+		PHASE_BLOCK("Kicking off threads.", profiler::colors::Red100);
 		for (size_t worker = 0; worker < nrOfWorkers; worker++)
 		{
-			futures[worker] = std::async(std::launch::async, approximatePi, iterations, nrOfWorkers, worker); // Note that we're passing seed + worker to ensure that all the random engines generate different numbers.
+			futures[worker] = std::async(std::launch::async, approximatePi, iterations, nrOfWorkers, worker, cpus[worker], std::cref(options), std::ref(board), std::ref(reports[worker])); // Note that we're passing seed + worker to ensure that all the random engines generate different numbers.
 		}
 	}
 
+	if (options.targetHalfWidth > 0.0)
+	{
+		PHASE_BLOCK("Coordinating early stop.", profiler::colors::Red100);
+		CoordinateStopping(board, options.targetHalfWidth, futures);
+	}
+
 	size_t insideCircle = 0;
+	size_t samplesDrawn = 0; // For the strategy_end probe, the reports are moved out below.
 	{
-		EASY_BLOCK("Retrieving results.", profiler::colors::Red100);
+		PHASE_BLOCK("Retrieving results.", profiler::colors::Red100);
 		for (size_t worker = 0; worker < nrOfWorkers; worker++)
 		{
-			EASY_BLOCK("Getting result of a single thread.", profiler::colors::Red100);
-			insideCircle += futures[worker].get(); // Blocks the main thread until a valid result is retrieved.
+			WORKER_BLOCK("Getting result of a single thread.", profiler::colors::Red100);
+			const size_t hits = futures[worker].get(); // Blocks the main thread until a valid result is retrieved.
+			insideCircle += hits;
+			samplesDrawn += reports[worker].samples;
+			PI_PROBE(result_retrieved, worker, reports[worker].samples, hits);
 		}
 	}
 
+	if (options.reports) *options.reports = std::move(reports);
+	PI_STRATEGY_PROBE(strategy_end, nrOfWorkers, samplesDrawn, insideCircle, "Async");
+	if (options.targetHalfWidth > 0.0) return EstimateFromBoard(board); // Stopped workers drew fewer samples than their share.
 	return 4.0f * (float)insideCircle / (float)iterations;
 }
 
 // Approximates PI by kicking off smaller pi approximating subroutines guaranteed to be on different threads and lets them instanciate their own random number generators.
-float Threads(const size_t iterations, const size_t nrOfWorkers)
+float Threads(const size_t iterations, const size_t nrOfWorkers = DefaultWorkerCount(), const StrategyOptions& options = {})
 {
-	EASY_BLOCK("Threads method.", profiler::colors::Blue);
+	PHASE_BLOCK("Threads method.", profiler::colors::Blue);
+	CheckWorkerCount(iterations, nrOfWorkers);
+	PI_STRATEGY_PROBE(strategy_start, nrOfWorkers, iterations, 0, "Threads");
 
 	// Modified version of approximatePi that uses a std::promise to return the result instead of the return value of the function.
-	const auto approximatePi = [](std::promise<size_t>&& returnVal, const size_t iterations, const size_t nrOfWorkers, const size_t workerId)
+	const auto approximatePi = [](std::promise<size_t>&& returnVal, const size_t iterations, const size_t nrOfWorkers, const size_t workerId, const int cpu, const StrategyOptions& options, ProgressBoard& board, WorkerReport& report)
 	{
-		EASY_BLOCK("Approximation subroutine.", profiler::colors::Blue100);
-		std::default_random_engine e(workerId);
-		std::uniform_real_distribution<float> d(-1.0f, 1.0f);
-		float x = 0.0f, y = 0.0f;
-		size_t insideCircle = 0;
-		for (size_t i = 0; i < iterations / nrOfWorkers; i++)
-		{
-			x = d(e);
-			y = d(e);
-			if (Magnitude(x, y) <= 1.0f)
-			{
-				insideCircle++;
-			}
-		}
-		returnVal.set_value(insideCircle);
+		WORKER_BLOCK("Approximation subroutine.", profiler::colors::Blue100);
+		returnVal.set_value(ApproximatePiChunked(WorkerShare(iterations, nrOfWorkers, workerId), workerId, cpu, options, board, report));
 	};
 
+	ProgressBoard ownBoard;
+	ProgressBoard& board = options.progress ? *options.progress : ownBoard;
+	board.Reset(nrOfWorkers);
+
+	const std::vector<int> cpus = PlanPlacement(SystemTopology(), options.placement, nrOfWorkers); // Which cpu each worker gets pinned to, if any.
+	std::vector<WorkerReport> reports(nrOfWorkers);
 	std::vector<std::thread> threads; // Vector for all the threads we'll be kicking off.
 	std::vector<std::future<size_t>> futures; // And a vector for holding their associated futures to retireve their results.
 	{
-		EASY_BLOCK("Kicking off threads.", profiler::colors::Blue100);
+		PHASE_BLOCK("Kicking off threads.", profiler::colors::Blue100);
 		for (size_t worker = 0; worker < nrOfWorkers; worker++)
 		{
 			std::promise<size_t> p; // Construct a promise to pass to the subroutine it'll use to return the result.
 			futures.push_back(p.get_future());
-			threads.push_back(std::thread(approximatePi, std::move(p), iterations, nrOfWorkers, worker)); // Note that we're std::move'ing the std::promise.
+			threads.push_back(std::thread(approximatePi, std::move(p), iterations, nrOfWorkers, worker, cpus[worker], std::cref(options), std::ref(board), std::ref(reports[worker]))); // Note that we're std::move'ing the std::promise.
 		}
 	}
 
+	if (options.targetHalfWidth > 0.0)
+	{
+		PHASE_BLOCK("Coordinating early stop.", profiler::colors::Blue100);
+		CoordinateStopping(board, options.targetHalfWidth, futures);
+	}
+
 	size_t insideCircle = 0;
+	size_t samplesDrawn = 0; // For the strategy_end probe, the reports are moved out below.
 	{
-		EASY_BLOCK("Retrieving results.", profiler::colors::Blue100);
+		PHASE_BLOCK("Retrieving results.", profiler::colors::Blue100);
 		for (size_t worker = 0; worker < nrOfWorkers; worker++)
 		{
-			EASY_BLOCK("Getting result of a single thread.", profiler::colors::Blue100);
+			WORKER_BLOCK("Getting result of a single thread.", profiler::colors::Blue100);
 			threads[worker].join(); // Blocks the main thread until a valid result is retrieved. Failing to do this results in an exception.
 			// threads[worker].detach(); // Alternatively, we could just detach the thread and let it run. The std::future.get() won't let us continue unless the future is valid anyways, meaning the thread is done.
-			insideCircle += futures[worker].get();
+			const size_t hits = futures[worker].get();
+			insideCircle += hits;
+			samplesDrawn += reports[worker].samples;
+			PI_PROBE(result_retrieved, worker, reports[worker].samples, hits);
 		}
 	}
 
+	if (options.reports) *options.reports = std::move(reports);
+	PI_STRATEGY_PROBE(strategy_end, nrOfWorkers, samplesDrawn, insideCircle, "Threads");
+	if (options.targetHalfWidth > 0.0) return EstimateFromBoard(board); // Stopped workers drew fewer samples than their share.
 	return 4.0f * (float)insideCircle / (float)iterations;
-}
\ No newline at end of file
+}
+
+} // namespace working
\ No newline at end of file
@@ -1,58 +1,351 @@
 #include <iostream>
-#include <cassert>
 #include <chrono>
-#include <cassert>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <thread>
+#include <stdexcept>
+#include <sstream>
+#include <fstream>
+#include <optional>
+#include <ctime>
+#include <filesystem>
 
 #include <easy/profiler.h>
+#if PI_STREAMING_CAPTURE
+#include <profileStreaming.h>
+#endif
+#if PI_LISTEN_ADDRESS
+#include <profileListen.h>
+#endif
 
-#if USE_WORKING_IMPLEMENTATION
-#include "workingImplementation.h"
-#else
-#include "exercise.h"
-#endif // USE_WORKING_IMPLEMENTATION
+#include "captureSignals.h"
+#include "config.h"
+#include "fingerprint.h"
+#include "harness.h"
+#include "monitor.h"
+#include "strategies.h"
+
+// Captures of successive runs don't overwrite each other: "profilerOutputs/session_<date>-<time>-<ms>.prof", see ProfileMerge.
+std::string UniqueCaptureName(const std::string& extension = ".prof")
+{
+	const auto now = std::chrono::system_clock::now();
+	const std::time_t seconds = std::chrono::system_clock::to_time_t(now);
+	char stamp[32] = {};
+	std::strftime(stamp, sizeof(stamp), "%Y%m%d-%H%M%S", std::localtime(&seconds));
+	std::ostringstream name;
+	name << "profilerOutputs/session_" << stamp << "-" << std::setw(3) << std::setfill('0') << std::chrono::duration_cast<std::chrono::milliseconds>(now.time_since_epoch()).count() % 1000;
+	std::string path = name.str() + extension;
+	for (int i = 2; std::filesystem::exists(path); i++) path = name.str() + "_" + std::to_string(i) + extension; // Runs started within the same millisecond.
+	return path;
+}
+
+// Prints the metrics derived from a counter reading on a single line, or nothing if no counter at all was available.
+void PrintCounters(const std::string& label, const CounterReading& counters)
+{
+	if (!counters.Has(PerfEvent::TaskClock) && !counters.AnyHardware()) return;
+	const auto metric = [](const char* name, const double value, const int precision, const char* unit = "")
+	{
+		std::ostringstream ss;
+		ss << ", " << name << " ";
+		if (value == value) ss << std::fixed << std::setprecision(precision) << value << unit;
+		else ss << "n/a"; // NaN, some counter it needs is unavailable.
+		return ss.str();
+	};
+	std::cout << "\t" << label << ":" << metric("on-cpu", counters.Get(PerfEvent::TaskClock) * 1e-6, 2, " ms").substr(1)
+		<< metric("instructions", counters.Get(PerfEvent::Instructions), 0) << metric("IPC", counters.Ipc(), 2) << metric("branch-miss rate", counters.BranchMissRate() * 100.0, 2, "%")
+		<< metric("effective frequency", counters.EffectiveGhz(), 2, " GHz") << metric("cycles/ref-cycles", counters.TurboRatio(), 2)
+		<< metric("L1D MPKI", counters.L1dMpki(), 2) << metric("LLC MPKI", counters.LlcMpki(), 3)
+		<< (counters.multiplexed ? " [multiplexed, scaled estimates]" : "") << std::endl;
+	std::cout.unsetf(std::ios::floatfield);
+	std::cout << std::setprecision(6);
+}
+
+// Prints how precise the approximation is and how long it would take to reach the configured precision.
+void PrintPrecision(const Precision& precision)
+{
+	std::cout << std::setprecision(3) << "\tStandard error " << precision.standardError << ", observed error " << precision.observedError
+		<< ", " << precision.samplesNeeded << " samples needed for +-" << precision.target << " at 95% confidence: ";
+	if (precision.secondsToTarget == precision.secondsToTarget) std::cout << precision.secondsToTarget << " s at this throughput." << std::endl;
+	else std::cout << "unknown time." << std::endl;
+	std::cout << std::setprecision(6);
+}
 
-int main()
+// Prints where each worker of a strategy ran and how often it got migrated.
+void PrintWorkerReports(const std::vector<WorkerReport>& reports)
 {
+	for (const WorkerReport& report : reports)
+	{
+		std::cout << "\tWorker " << report.workerId << ": "
+			<< (report.requestedCpu < 0 ? std::string("unpinned") : "pinned to cpu " + std::to_string(report.requestedCpu))
+			<< ", ran on cpu " << report.firstCpu << " -> " << report.lastCpu
+			<< ", NUMA node " << report.node
+			<< ", " << report.migrations << " migrations." << std::endl;
+		PrintCounters("Worker " + std::to_string(report.workerId) + " counters", report.counters);
+	}
+}
+
+// Prints the statistics of a measurement, durations in nanoseconds.
+void PrintMeasurement(const Measurement& measurement)
+{
+	const Summary& ns = measurement.ns;
+	std::cout << std::fixed << std::setprecision(0)
+		<< "\t" << ns.count << " runs after " << measurement.warmups << " warmups: min " << ns.min << " ns, median " << ns.median << " ns, mean " << ns.mean
+		<< " ns, stddev " << ns.stddev << " ns, p99 " << ns.p99 << " ns, " << measurement.samplesPerSecond << " samples/s";
+	std::cout.unsetf(std::ios::floatfield);
+	if (measurement.TooFewRuns()) std::cout << " [too few runs to judge stability]";
+	else if (measurement.Unstable()) std::cout << " [UNSTABLE: stddev is " << std::setprecision(3) << ns.Cv() * 100.0 << "% of the mean]";
+	std::cout << std::setprecision(6) << std::endl;
+}
+
+int main(int argc, char* argv[])
+{
+	BenchmarkConfig config;
+	try
+	{
+		config = ParseConfig(argc, argv);
+	}
+	catch (const std::invalid_argument& e)
+	{
+		std::cerr << e.what() << std::endl << ConfigUsage();
+		return 1;
+	}
+	if (config.help)
+	{
+		std::cout << ConfigUsage();
+		return 0;
+	}
+	const std::vector<const Strategy*> strategies = SelectStrategies(config);
+	const bool multithreaded = std::any_of(strategies.begin(), strategies.end(), [](const Strategy* strategy) { return strategy->multithreaded; });
+	const size_t fewestIterations = *std::min_element(config.iterations.begin(), config.iterations.end());
+	const size_t mostWorkers = *std::max_element(config.workers.begin(), config.workers.end());
+	if (multithreaded && mostWorkers > fewestIterations)
+	{
+		std::cerr << mostWorkers << " workers can't share " << fewestIterations << " iterations, every worker needs at least one sample." << std::endl;
+		return 1;
+	}
+
 	EASY_PROFILER_ENABLE;
-	
-	/*
-	How many iterations we'll go through before returning an approximation of PI.
-	Adjust this to suit your PC's performance, there's no need for it to take 5 hours to approximate PI.
-	*/
-	constexpr const size_t ITERATIONS = 1000000;
-	
-	/*
-	Number of worker threads that can run an approximation subroutine at the same time.
-	Set it to the number of logical cores of your CPU - 2 for consistent results:
-	-1 core for the main thread and one more -1 to make it an even number for even divisions in subroutines' for loops (the ITERATIONS / NR_OF_WORKERS parts).
-	*/
-	constexpr const size_t NR_OF_WORKERS = 4;
-
-	// Measure baseline algorithm.
-	auto startTime = std::chrono::system_clock::now(); // Store time before running algorithm.
-	const float piApprox = SingleThread(ITERATIONS);
-	auto endTime = std::chrono::system_clock::now(); // Measure time having ran the algorithm.
-	std::this_thread::sleep_for(std::chrono::milliseconds(100)); // Wait for 100ms for ease of profiler graph reading.
-	std::cout << "SingleThread has computed PI as " << std::to_string(piApprox) << " in " << std::to_string((endTime - startTime).count()) << " ticks." << std::endl;
-
-	// Measure Async.
-	startTime = std::chrono::system_clock::now();
-	float pi = Async(ITERATIONS, NR_OF_WORKERS);
-	endTime = std::chrono::system_clock::now();
-	std::this_thread::sleep_for(std::chrono::milliseconds(100));
-	std::cout << "Async has computed PI as " << std::to_string(pi) << " in " << std::to_string((endTime - startTime).count()) << " ticks." << std::endl;
-
-	// Measure Threads.
-	startTime = std::chrono::system_clock::now();
-	pi = Threads(ITERATIONS, NR_OF_WORKERS);
-	endTime = std::chrono::system_clock::now();
-	std::this_thread::sleep_for(std::chrono::milliseconds(100));
-	std::cout << "Threads has computed PI as " << std::to_string(pi) << " in " << std::to_string((endTime - startTime).count()) << " ticks." << std::endl;
+	EASY_SET_EVENT_TRACING_ENABLED(config.contextSwitches);
+	EASY_MAIN_THREAD;
+#if BUILD_WITH_EASY_PROFILER
+	const std::string capturePath = UniqueCaptureName();
+	if (config.streamCapture)
+	{
+#if PI_STREAMING_CAPTURE
+		if (!StartStreamingCapture(capturePath.c_str(), config.captureMemoryMb << 20, (uint32_t)config.flushIntervalMs))
+		{
+			std::cerr << "Can't stream the capture to " << capturePath << ".part." << std::endl;
+			return 1;
+		}
+#else
+		std::cerr << "--capture=stream needs the in-tree ProfilerBackend, easy_profiler's own library can't stream captures." << std::endl;
+		return 1;
+#endif
+	}
+	if (config.listenPort)
+	{
+		if (config.streamCapture || config.signalCapture)
+		{
+			std::cerr << "--listen only mixes with --capture=end, captures taken over the network are sent to the client." << std::endl;
+			return 1;
+		}
+		EASY_PROFILER_DISABLE; // Until a client starts a capture.
+#if PI_LISTEN_ADDRESS
+		const bool listening = StartListening(config.listenAddress.c_str(), (uint16_t)config.listenPort);
+#else
+		if (config.listenAddress != "0.0.0.0")
+		{
+			std::cerr << "easy_profiler's own library listens on every interface, ask for it with --listen=0.0.0.0:" << config.listenPort << "." << std::endl;
+			return 1;
+		}
+		profiler::startListen((uint16_t)config.listenPort);
+		const bool listening = profiler::isListening();
+#endif
+		if (!listening)
+		{
+			std::cerr << "Can't listen for capture clients on " << config.listenAddress << ":" << config.listenPort << "." << std::endl;
+			return 1;
+		}
+		std::cout << "Listening for capture clients on " << config.listenAddress << ":" << config.listenPort << "." << std::endl;
+	}
+	const auto dumpWindow = []() // Writes the capture windows of --capture=signal.
+	{
+		const std::string path = UniqueCaptureName();
+		if (!profiler::dumpBlocksToFile(path.c_str()))
+		{
+			std::cout << "Nothing was captured since the last capture was written." << std::endl;
+			return;
+		}
+		std::error_code copyError;
+		std::filesystem::copy_file(path, "profilerOutputs/session.prof", std::filesystem::copy_options::overwrite_existing, copyError);
+		std::cout << "Capture written to " << path << "." << std::endl;
+	};
+	std::optional<CaptureSignals> signals; // Helper thread of the capture windows, until the end of main.
+	if (config.signalCapture)
+	{
+		EASY_PROFILER_DISABLE; // Until the first SIGUSR1.
+		signals.emplace([]()
+		{
+			profiler::setEnabled(!profiler::isEnabled());
+			std::cout << (profiler::isEnabled() ? "Capture started." : "Capture stopped.") << std::endl;
+		}, dumpWindow);
+		if (!signals->Installed())
+		{
+			std::cerr << "--capture=signal needs Linux signals." << std::endl;
+			return 1;
+		}
+		std::cout << "Capturing on demand: \"kill -USR1 " << CaptureSignals::ProcessId() << "\" starts or stops capturing, \"kill -USR2 " << CaptureSignals::ProcessId() << "\" writes the capture." << std::endl;
+	}
+#endif
+
+	const CpuBudget budget = DetectCpuBudget();
+	std::cout << "Detected a budget of " << budget.effective << " workers (" << budget.hardwareThreads << " hardware threads, " << budget.affinityCpus << " in affinity mask, "
+		<< (budget.cgroupQuota > 0.0 ? std::to_string(budget.cgroupQuota) + " CPUs of cgroup quota from " + budget.quotaSource : std::string("no cgroup quota")) << ")." << std::endl;
+	PrintFingerprint(std::cout, CaptureFingerprint(config)); // Results mean little without knowing what they were measured on.
+
+	std::vector<WorkerReport> reports;
+	StrategyOptions options;
+	options.placement = config.placement;
+	options.reports = &reports;
+	options.countEvents = config.counters;
+	options.targetHalfWidth = config.targetHalfWidth;
+	options.valueInterval = std::chrono::milliseconds(config.valueIntervalMs);
+	std::optional<SamplingProfiler> sampler; // Owns SIGPROF until the end of main.
+	if (config.samplingHz)
+	{
+		sampler.emplace((unsigned)config.samplingHz);
+		if (!sampler->Installed())
+		{
+			std::cerr << "--sampling needs Linux on x86-64 or AArch64." << std::endl;
+			return 1;
+		}
+		options.sampler = &*sampler;
+	}
+	ProgressBoard progress(*std::max_element(config.workers.begin(), config.workers.end())); // Tells how many samples the workers actually drew when they can stop early.
+	options.progress = &progress;
+
+	std::ofstream monitorFile;
+	std::optional<ConvergenceMonitor> monitor; // Reads the board from its own thread until the end of main.
+	if (config.monitorIntervalMs > 0)
+	{
+		if (config.monitorOutput != "-")
+		{
+			monitorFile.open(config.monitorOutput);
+			if (!monitorFile)
+			{
+				std::cerr << "Can't open \"" << config.monitorOutput << "\" for the convergence stream." << std::endl;
+				return 1;
+			}
+		}
+		monitor.emplace(progress, std::chrono::milliseconds(config.monitorIntervalMs), monitorFile.is_open() ? (std::ostream&)monitorFile : std::cout);
+	}
+
+	if (config.counters)
+	{
+		const PerfCounters probe;
+		if (!probe.Error().empty()) std::cout << "Some hardware counters are unavailable (" << probe.Error() << "), their metrics will be reported as n/a." << std::endl;
+	}
+
+	// Every combination of the configuration runs in this one process. Engines and kernels only have one possible value for now, they're listed for the record.
+	for (const Strategy* strategy : strategies)
+	{
+		for (const size_t iterations : config.iterations)
+		{
+			// The number of workers means nothing to SingleThread, no need to run it once per value.
+			const std::vector<size_t> workerCounts = strategy->multithreaded ? config.workers : std::vector<size_t>{ 1 };
+			for (const size_t nrOfWorkers : workerCounts)
+			{
+				const bool adaptive = strategy->multithreaded && strategy->publishesProgress && config.targetHalfWidth > 0.0; // SingleThread has no workers to stop, the exercise's don't publish on the board.
+				std::optional<PerfCounters> strategyCounters; // Counts the calling thread and, by inheritance, every worker it kicks off.
+				if (config.counters) strategyCounters.emplace(true);
+				CounterReading strategyReading;
+				const Measurement measurement = Measure([&]()
+				{
+					reports.clear();
+					const SamplingProfiler::Thread sampled(options.sampler, "Main"); // SingleThread and the coordination of the others, named like easy_profiler's main thread.
+					if (strategyCounters) strategyCounters->Start();
+					const float pi = strategy->run(iterations, nrOfWorkers, options);
+					if (strategyCounters) strategyReading = strategyCounters->Stop();
+					return pi;
+				}, iterations, config.warmups, config.repetitions, {}, adaptive ? std::function<size_t()>([&progress]() { return progress.Totals().samples; }) : std::function<size_t()>());
+				const size_t samples = adaptive ? measurement.samples.back() : iterations; // Of the last run.
+#if BUILD_WITH_EASY_PROFILER
+				std::this_thread::sleep_for(std::chrono::milliseconds(100)); // Leave a gap between combinations for ease of profiler graph reading.
+#endif
+
+				std::cout << strategy->FullName() << " (" << iterations << " iterations" << (strategy->multithreaded ? ", " + std::to_string(nrOfWorkers) + " workers" : std::string())
+					<< ") has computed PI as " << std::to_string(measurement.lastResult) << std::endl;
+				PrintMeasurement(measurement);
+				if (adaptive)
+				{
+					const ProgressTotals totals = progress.Totals();
+					std::cout << "\tStopped after " << totals.samples << " of at most " << iterations << " samples, PI is within +-" << std::setprecision(3) << PiWilsonHalfWidth(totals.hits, totals.samples)
+						<< " at 95% confidence (Wilson interval, target +-" << config.targetHalfWidth << ")." << std::setprecision(6) << std::endl;
+				}
+				const ProgressTotals drawn = progress.Totals(); // Of the last run, when the strategy publishes them.
+				const double estimate = strategy->publishesProgress ? PiEstimate(drawn.hits, drawn.samples) : (double)measurement.lastResult;
+				PrintPrecision(ComputePrecision(strategy->variancePerSample, strategy->publishesProgress ? drawn.samples : samples, estimate, measurement.samplesPerSecond, PrecisionTarget(config.precisionDigits)));
+				PrintCounters("Counters of the last run", strategyReading);
+				PrintWorkerReports(reports); // Reports of the last run.
+			}
+		}
+	}
+
+	if (sampler)
+	{
+#if BUILD_WITH_EASY_PROFILER
+		const std::string samplesPath = capturePath.substr(0, capturePath.size() - 5) + ".folded"; // Next to the capture of the same run.
+#else
+		const std::string samplesPath = UniqueCaptureName(".folded");
+#endif
+		std::ofstream samplesFile(samplesPath, std::ios::trunc);
+		if (!sampler->WriteFolded(samplesFile))
+		{
+			std::cerr << "Can't write the sampled stacks to " << samplesPath << "." << std::endl;
+			return 1;
+		}
+		samplesFile.close();
+		std::error_code copyError;
+		std::filesystem::copy_file(samplesPath, "profilerOutputs/session.folded", std::filesystem::copy_options::overwrite_existing, copyError);
+		std::cout << "Sampled " << sampler->Samples() << " stacks every " << sampler->PeriodNs() / 1000 << " us of cpu time (" << sampler->Dropped() << " dropped), folded stacks written to " << samplesPath << "." << std::endl;
+	}
 
 	// Output easy_profiler's data.
 #if BUILD_WITH_EASY_PROFILER
-	const auto success = profiler::dumpBlocksToFile("profilerOutputs/session.prof");
-	assert(success && "Failed to write profiling data to file.");
+	if (config.listenPort)
+	{
+		profiler::stopListen(); // Captures went to the clients.
+		return 0;
+	}
+	if (signals)
+	{
+		signals.reset(); // No SIGUSR2 racing the last capture.
+		if (!profiler::isEnabled()) return 0;
+		EASY_PROFILER_DISABLE;
+		std::cout << "The run ended while capturing." << std::endl;
+		dumpWindow(); // What the window caught so far isn't lost.
+		return 0;
+	}
+#if PI_STREAMING_CAPTURE
+	StreamingCaptureStats streamed;
+	const auto success = config.streamCapture ? StopStreamingCapture(&streamed) : profiler::dumpBlocksToFile(capturePath.c_str());
+	if (config.streamCapture)
+	{
+		std::cout << "Streamed " << streamed.records << " records (" << streamed.bytes / 1024 << " KiB) in " << streamed.flushes << " flushes, at most " << streamed.peakMemory / 1024 << " KiB buffered, "
+			<< streamed.dropped << " dropped over the " << config.captureMemoryMb << " MB cap." << std::endl;
+	}
+#else
+	const auto success = profiler::dumpBlocksToFile(capturePath.c_str());
+#endif
+	if (!success) // Also what an empty capture returns, neither leaves a file worth pointing the tools to.
+	{
+		std::cerr << "Failed to write the capture to " << capturePath << ", or nothing was recorded." << std::endl;
+		return 1;
+	}
+	std::error_code copyError;
+	std::filesystem::copy_file(capturePath, "profilerOutputs/session.prof", std::filesystem::copy_options::overwrite_existing, copyError); // The latest capture, where the tools look by default.
+	std::cout << "Capture written to " << capturePath << "." << std::endl;
 #endif
 
 	return 0;
@@ -0,0 +1,257 @@
+#include <iostream>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <string>
+#include <chrono>
+#include <thread>
+#include <ctime>
+#include <climits>
+#include <cstdlib>
+#include <filesystem>
+
+#include <easy/easy_net.h>
+#include <easy/easy_socket.h>
+
+/*
+	Headless client of easy_profiler's network protocol: connects to a program listening for captures ("Application --listen", or any program calling profiler::startListen()),
+	starts and stops captures on command or on a timer and writes what it receives to disk, the captures the easy_profiler GUI would otherwise take.
+	Every capture arrives as the bytes of a .prof file and is saved as is.
+*/
+
+using profiler::net::MessageType;
+
+const char* ClientUsage()
+{
+	return
+		"Usage: CaptureClient [settings]\n"
+		"  --host=<address>         Machine the program listens on (default 127.0.0.1).\n"
+		"  --port=<n>               Port it listens on (default 28077, easy_profiler's).\n"
+		"  --duration=<ms>          Capture for that long, save and quit. Without it, commands are read from the standard input: start, stop and quit.\n"
+		"  --output=<file>          Capture file, numbered from the second capture on (default profilerOutputs/remote_<date>-<time>.prof).\n"
+		"  --help                   Print this message.\n";
+}
+
+class CaptureConnection
+{
+public:
+	// Connects and reads the listener's greeting.
+	bool Connect(const std::string& host, const uint16_t port)
+	{
+		if (!socket_.setAddress(host.c_str(), port) || socket_.connect() != 0) return false;
+		profiler::net::Message message;
+		std::string ignored;
+		return Next(message, ignored) && message.type == MessageType::Connection_Accepted;
+	}
+
+	bool StartCapture()
+	{
+		if (!Send(MessageType::Request_Start_Capture)) return false;
+		return Await(MessageType::Reply_Capturing_Started, nullptr);
+	}
+
+	// The capture the program recorded since StartCapture(), empty if it recorded nothing.
+	bool StopCapture(std::string& capture)
+	{
+		capture.clear();
+		if (!Send(MessageType::Request_Stop_Capture)) return false;
+		return Await(MessageType::Reply_Blocks_End, &capture);
+	}
+
+private:
+	bool Send(const MessageType type)
+	{
+		const profiler::net::Message message(type);
+		return socket_.send(&message, sizeof(message)) == (int)sizeof(message);
+	}
+
+	bool Receive(void* data, size_t size)
+	{
+		char* at = static_cast<char*>(data);
+		while (size > 0)
+		{
+			const int received = socket_.receive(at, std::min<size_t>(size, INT_MAX));
+			if (received <= 0) return false; // Disconnected.
+			at += received;
+			size -= (size_t)received;
+		}
+		return true;
+	}
+
+	// Reads one message, the data of Reply_Blocks and Reply_Blocks_Description is appended to data.
+	bool Next(profiler::net::Message& message, std::string& data)
+	{
+		if (!Receive(&message, sizeof(message)) || !message.isEasyNetMessage()) return false;
+		switch (message.type)
+		{
+		case MessageType::Connection_Accepted:
+		{
+			char status[sizeof(profiler::net::EasyProfilerStatus) - sizeof(profiler::net::Message)];
+			return Receive(status, sizeof(status));
+		}
+		case MessageType::Reply_Blocks:
+		case MessageType::Reply_Blocks_Description:
+		{
+			uint32_t size = 0;
+			if (!Receive(&size, sizeof(size))) return false;
+			const size_t offset = data.size();
+			data.resize(offset + size);
+			return Receive(data.data() + offset, size);
+		}
+		case MessageType::Reply_MainThread_FPS:
+		{
+			char times[sizeof(profiler::net::TimestampMessage) - sizeof(profiler::net::Message)];
+			return Receive(times, sizeof(times));
+		}
+		default: return true;
+		}
+	}
+
+	bool Await(const MessageType type, std::string* data)
+	{
+		std::string ignored;
+		profiler::net::Message message;
+		do
+		{
+			if (!Next(message, data ? *data : ignored)) return false;
+		} while (message.type != type);
+		return true;
+	}
+
+	EasySocket socket_;
+};
+
+std::string CaptureName(const std::string& output, const size_t index)
+{
+	if (!output.empty())
+	{
+		if (index == 1) return output;
+		const std::filesystem::path path(output);
+		return (path.parent_path() / (path.stem().string() + "_" + std::to_string(index) + path.extension().string())).string();
+	}
+	const std::time_t now = std::time(nullptr);
+	char stamp[32] = {};
+	std::strftime(stamp, sizeof(stamp), "%Y%m%d-%H%M%S", std::localtime(&now));
+	const std::string name = std::string("profilerOutputs/remote_") + stamp;
+	std::string path = name + ".prof";
+	for (int i = 2; std::filesystem::exists(path); i++) path = name + "_" + std::to_string(i) + ".prof"; // Captures stopped within the same second.
+	return path;
+}
+
+// Stops the running capture and writes it, false if the connection is lost.
+bool StopAndSave(CaptureConnection& connection, const std::string& output, size_t& captures)
+{
+	std::string capture;
+	if (!connection.StopCapture(capture)) return false;
+	if (capture.empty())
+	{
+		std::cout << "Nothing was recorded during the capture." << std::endl;
+		return true;
+	}
+	const std::string path = CaptureName(output, ++captures);
+	const std::filesystem::path parent = std::filesystem::path(path).parent_path();
+	std::error_code ignored;
+	if (!parent.empty()) std::filesystem::create_directories(parent, ignored);
+	std::ofstream file(path, std::ios::binary | std::ios::trunc);
+	file.write(capture.data(), (std::streamsize)capture.size());
+	if (!file) std::cerr << "Can't write the capture to " << path << "." << std::endl;
+	else std::cout << "Capture of " << std::fixed << std::setprecision(1) << capture.size() / 1024.0 << " KiB written to " << path << "." << std::endl;
+	return true;
+}
+
+int main(int argc, char* argv[])
+{
+	std::string host = "127.0.0.1";
+	std::string output;
+	unsigned long port = 28077;
+	unsigned long durationMs = 0;
+	for (int i = 1; i < argc; i++)
+	{
+		const std::string arg = argv[i];
+		char* end = nullptr;
+		if (arg == "--help" || arg == "-h")
+		{
+			std::cout << ClientUsage();
+			return 0;
+		}
+		else if (arg.rfind("--host=", 0) == 0) host = arg.substr(7);
+		else if (arg.rfind("--output=", 0) == 0) output = arg.substr(9);
+		else if (arg.rfind("--port=", 0) == 0)
+		{
+			port = std::strtoul(arg.c_str() + 7, &end, 10);
+			if (*end != '\0' || port == 0 || port > 65535)
+			{
+				std::cerr << "Unknown setting \"" << arg << "\"." << std::endl << ClientUsage();
+				return 1;
+			}
+		}
+		else if (arg.rfind("--duration=", 0) == 0)
+		{
+			durationMs = std::strtoul(arg.c_str() + 11, &end, 10);
+			if (*end != '\0' || durationMs == 0)
+			{
+				std::cerr << "Unknown setting \"" << arg << "\"." << std::endl << ClientUsage();
+				return 1;
+			}
+		}
+		else
+		{
+			std::cerr << "Unknown setting \"" << arg << "\"." << std::endl << ClientUsage();
+			return 1;
+		}
+	}
+
+	CaptureConnection connection;
+	if (!connection.Connect(host, (uint16_t)port))
+	{
+		std::cerr << "Can't connect to " << host << ":" << port << ", is the program listening (\"Application --listen\")?" << std::endl;
+		return 1;
+	}
+	std::cout << "Connected to " << host << ":" << port << "." << std::endl;
+
+	size_t captures = 0;
+	if (durationMs > 0)
+	{
+		if (!connection.StartCapture())
+		{
+			std::cerr << "Lost the connection." << std::endl;
+			return 1;
+		}
+		std::cout << "Capturing for " << durationMs << " ms." << std::endl;
+		std::this_thread::sleep_for(std::chrono::milliseconds(durationMs));
+		if (!StopAndSave(connection, output, captures))
+		{
+			std::cerr << "Lost the connection." << std::endl;
+			return 1;
+		}
+		return 0;
+	}
+
+	std::cout << "Commands: start, stop, quit." << std::endl;
+	bool capturing = false;
+	bool connected = true;
+	for (std::string line; connected && std::getline(std::cin, line);)
+	{
+		if (line == "start")
+		{
+			if (capturing) std::cout << "Already capturing." << std::endl;
+			else if ((connected = connection.StartCapture())) std::cout << "Capturing." << std::endl;
+			capturing = connected;
+		}
+		else if (line == "stop")
+		{
+			if (!capturing) std::cout << "Not capturing." << std::endl;
+			else connected = StopAndSave(connection, output, captures);
+			capturing = false;
+		}
+		else if (line == "quit") break;
+		else if (!line.empty()) std::cerr << "Unknown command \"" << line << "\", expected start, stop or quit." << std::endl;
+	}
+	if (connected && capturing) connected = StopAndSave(connection, output, captures); // Quitting doesn't lose a running capture.
+	if (!connected)
+	{
+		std::cerr << "Lost the connection." << std::endl;
+		return 1;
+	}
+	return 0;
+}
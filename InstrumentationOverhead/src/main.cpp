@@ -0,0 +1,186 @@
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <stdexcept>
+
+#include "config.h"
+#include "harness.h"
+#include "instrumentation.h"
+#include "statistics.h"
+#include "strategies.h"
+
+/*
+	Overhead of the instrumentation level this binary was built with. CMake builds it once per level: InstrumentationOverhead_off, _phases, _workers and _chunks.
+	Reports what a single block costs, how many blocks a run of each strategy records at this level, and how much the samples/s drop while they're being recorded.
+	Runs with the capture on and off alternate, which one goes first swapping every repetition, so that neither gets the warmer caches or the faster clock consistently,
+	and a two-sided Mann-Whitney U test tells whether their throughputs differ at all.
+	Blocks compiled in still cost a little while the capture is off, the samples/s of InstrumentationOverhead_off are the uninstrumented reference.
+*/
+
+constexpr const size_t PROBE_BLOCKS = 100000; // Blocks per timing of what a single one costs.
+constexpr const size_t PROBE_REPETITIONS = 5;
+constexpr const double IMPACT_ALPHA = 0.01; // Significance level below which capturing is deemed to change the throughput.
+
+// Where the blocks of every run get drained to, so that the capture doesn't grow from one run to the next. The last run's blocks stay there for inspection.
+inline std::string CapturePath()
+{
+	return std::string("profilerOutputs/overhead_") + InstrumentationLevelName() + ".prof";
+}
+
+// Median nanoseconds an EASY_BLOCK begin and end cost, with the capture on or off.
+double NsPerBlock(const bool capture)
+{
+#if BUILD_WITH_EASY_PROFILER
+	profiler::setEnabled(capture);
+	std::vector<double> timings;
+	for (size_t repetition = 0; repetition < PROBE_REPETITIONS; repetition++)
+	{
+		const auto start = BenchmarkClock::now();
+		for (size_t i = 0; i < PROBE_BLOCKS; i++)
+		{
+			EASY_BLOCK("Overhead probe.", profiler::colors::Grey);
+		}
+		timings.push_back(ElapsedNs(start, BenchmarkClock::now()) / (double)PROBE_BLOCKS);
+		profiler::dumpBlocksToFile(CapturePath().c_str());
+	}
+	profiler::setEnabled(false);
+	return Summarize(timings).median;
+#else
+	(void)capture;
+	return 0.0;
+#endif
+}
+
+// Number of blocks, events and values a single run records.
+size_t BlocksPerRun(const Strategy& strategy, const size_t iterations, const size_t nrOfWorkers, const StrategyOptions& options)
+{
+#if BUILD_WITH_EASY_PROFILER
+	profiler::dumpBlocksToFile(CapturePath().c_str()); // Start from empty rings.
+	profiler::setEnabled(true);
+	strategy.run(iterations, nrOfWorkers, options);
+	profiler::setEnabled(false);
+	return profiler::dumpBlocksToFile(CapturePath().c_str());
+#else
+	(void)strategy, (void)iterations, (void)nrOfWorkers, (void)options;
+	return 0;
+#endif
+}
+
+Measurement MeasureThroughput(const Strategy& strategy, const size_t iterations, const size_t nrOfWorkers, const StrategyOptions& options, const size_t warmups, const size_t repetitions, const bool capture)
+{
+#if BUILD_WITH_EASY_PROFILER
+	profiler::setEnabled(capture);
+	const Measurement measurement = Measure([&]() { return strategy.run(iterations, nrOfWorkers, options); }, iterations, warmups, repetitions,
+		[]() { profiler::dumpBlocksToFile(CapturePath().c_str()); }); // Drained outside of the timed runs.
+	profiler::setEnabled(false);
+	return measurement;
+#else
+	(void)capture;
+	return Measure([&]() { return strategy.run(iterations, nrOfWorkers, options); }, iterations, warmups, repetitions);
+#endif
+}
+
+// The durations of the runs, with the capture on and off, recorded one after the other in alternating order.
+struct PairedMeasurement
+{
+	Measurement capturing;
+	Measurement idle;
+};
+
+PairedMeasurement MeasureInterleaved(const Strategy& strategy, const size_t iterations, const size_t nrOfWorkers, const StrategyOptions& options, const BenchmarkConfig& config)
+{
+	PairedMeasurement paired;
+	for (size_t repetition = 0; repetition < config.repetitions; repetition++)
+	{
+		const size_t warmups = repetition == 0 ? config.warmups : 0;
+		for (const bool capture : { repetition % 2 == 0, repetition % 2 != 0 })
+		{
+			Measurement& side = capture ? paired.capturing : paired.idle;
+			const Measurement run = MeasureThroughput(strategy, iterations, nrOfWorkers, options, warmups, 1, capture);
+			side.warmups += run.warmups;
+			side.lastResult = run.lastResult;
+			side.runs.insert(side.runs.end(), run.runs.begin(), run.runs.end());
+		}
+	}
+	for (Measurement* side : { &paired.capturing, &paired.idle })
+	{
+		side->ns = Summarize(side->runs);
+		if (side->ns.median > 0.0) side->samplesPerSecond = (double)iterations / (side->ns.median * 1e-9);
+	}
+	return paired;
+}
+
+int main(int argc, char* argv[])
+{
+	BenchmarkConfig defaults;
+	defaults.iterations = { 100000000 };
+	defaults.strategies = { "Async", "Threads" };
+	defaults.counters = false;
+
+	BenchmarkConfig config;
+	try
+	{
+		config = ParseConfig(argc, argv, defaults);
+	}
+	catch (const std::invalid_argument& e)
+	{
+		std::cerr << e.what() << std::endl << ConfigUsage();
+		return 1;
+	}
+	if (config.help)
+	{
+		std::cout << ConfigUsage() << "Defaults differ from the Application's: 1e8 iterations, Async and Threads only, counters off.\n";
+		return 0;
+	}
+
+	StrategyOptions options;
+	options.placement = config.placement;
+	options.valueInterval = std::chrono::milliseconds(config.valueIntervalMs);
+
+	std::cout << "Instrumentation level \"" << InstrumentationLevelName() << "\"";
+#if BUILD_WITH_EASY_PROFILER
+	const double nsCapturing = NsPerBlock(true);
+	const double nsIdle = NsPerBlock(false);
+	std::cout << std::fixed << std::setprecision(1);
+#if PI_INSTRUMENTATION == PI_INSTRUMENTATION_OFF
+	std::cout << ": the strategies record no blocks, a raw EASY_BLOCK costs " << nsCapturing << " ns while capturing, " << nsIdle << " ns with the capture off." << std::endl; // The probe's are the only ones in the binary.
+#else
+	std::cout << ": a block costs " << nsCapturing << " ns while capturing, " << nsIdle << " ns with the capture off." << std::endl;
+#endif
+	std::cout.unsetf(std::ios::floatfield);
+#else
+	const double nsCapturing = 0.0;
+	std::cout << ", built without USE_EASY_PROFILER: nothing is instrumented." << std::endl;
+#endif
+
+	for (const Strategy* strategy : SelectStrategies(config))
+	{
+		for (const size_t iterations : config.iterations)
+		{
+			const std::vector<size_t> workerCounts = strategy->multithreaded ? config.workers : std::vector<size_t>{ 1 };
+			for (const size_t nrOfWorkers : workerCounts)
+			{
+				const size_t blocks = BlocksPerRun(*strategy, iterations, nrOfWorkers, options);
+				const PairedMeasurement paired = MeasureInterleaved(*strategy, iterations, nrOfWorkers, options, config);
+				const Measurement& capturing = paired.capturing;
+				const Measurement& idle = paired.idle;
+				const RankTest difference = MannWhitneyTwoSided(capturing.runs, idle.runs);
+				const double measuredImpact = idle.samplesPerSecond > 0.0 ? (idle.samplesPerSecond - capturing.samplesPerSecond) / idle.samplesPerSecond * 100.0 : 0.0;
+				// Blocks are recorded on every worker at once, their cost adds up over cpu time rather than wall time. Only an upper bound with more than one worker.
+				const double estimatedImpact = capturing.ns.median > 0.0 ? (double)blocks * nsCapturing / capturing.ns.median * 100.0 : 0.0;
+
+				std::cout << strategy->FullName() << " (" << iterations << " iterations" << (strategy->multithreaded ? ", " + std::to_string(nrOfWorkers) + " workers" : std::string()) << "): "
+					<< blocks << " blocks per run." << std::endl;
+				std::cout << std::fixed << std::setprecision(0)
+					<< "\tCapturing " << capturing.samplesPerSecond << " samples/s, capture off " << idle.samplesPerSecond << " samples/s: "
+					<< std::setprecision(3) << measuredImpact << "% measured impact, " << estimatedImpact << "% estimated from the cost of a block, "
+					<< std::setprecision(4) << "p = " << difference.pValue << (difference.exact ? " (exact)" : " (normal approximation)")
+					<< (difference.pValue >= IMPACT_ALPHA ? " [NOT SIGNIFICANT, the impact is within the noise]" : "") << std::endl;
+				std::cout.unsetf(std::ios::floatfield);
+			}
+		}
+	}
+	std::cout << "Compare the samples/s against InstrumentationOverhead_off's for the impact of the blocks compiled in but not captured." << std::endl;
+	return 0;
+}
@@ -0,0 +1,151 @@
+#include <random>
+#include <vector>
+#include <numeric>
+#include <cstdint>
+
+#include <benchmark/benchmark.h>
+
+#include "workingImplementation.h"
+
+/*
+	Microbenchmarks of the building blocks of the strategies, so that when a whole strategy gets slower in the Application we can tell which part did.
+	Every benchmark reports items_per_second and the cost of a single item as "per_item" (seconds, inverted rate).
+	Inputs are generated up front, outside of the timed loops, and results go through benchmark::DoNotOptimize so that the compiler can't drop the work.
+*/
+
+constexpr const size_t INPUT_SIZE = 4096; // Power of two, small enough to stay in L1 so that we time the computation and not the memory.
+
+// Items processed and the cost of a single one.
+static void ReportPerItem(benchmark::State& state, const int64_t itemsPerIteration = 1)
+{
+	state.SetItemsProcessed(state.iterations() * itemsPerIteration);
+	state.counters["per_item"] = benchmark::Counter((double)(state.iterations() * itemsPerIteration), benchmark::Counter::kIsRate | benchmark::Counter::kInvert);
+}
+
+static std::vector<float> RandomFloats(const size_t count, const unsigned seed)
+{
+	std::default_random_engine e(seed);
+	std::uniform_real_distribution<float> d(-1.0f, 1.0f);
+	std::vector<float> values(count);
+	for (float& value : values)
+	{
+		value = d(e);
+	}
+	return values;
+}
+
+// Plays back pre-generated raw engine outputs, so that the distribution can be timed without the engine.
+template <typename Engine>
+class Replay
+{
+public:
+	using result_type = typename Engine::result_type;
+	static constexpr result_type min() { return Engine::min(); }
+	static constexpr result_type max() { return Engine::max(); }
+
+	Replay()
+	{
+		Engine e;
+		for (result_type& value : values_)
+		{
+			value = e();
+		}
+	}
+
+	result_type operator()() { return values_[next_++ & (INPUT_SIZE - 1)]; }
+
+private:
+	result_type values_[INPUT_SIZE];
+	size_t next_ = 0;
+};
+
+static void BM_Magnitude(benchmark::State& state)
+{
+	const std::vector<float> xs = RandomFloats(INPUT_SIZE, 1), ys = RandomFloats(INPUT_SIZE, 2);
+	size_t i = 0;
+	for (auto _ : state)
+	{
+		benchmark::DoNotOptimize(working::Magnitude(xs[i], ys[i]));
+		i = (i + 1) & (INPUT_SIZE - 1);
+	}
+	ReportPerItem(state);
+}
+BENCHMARK(BM_Magnitude);
+
+// One raw draw of an engine, the dependency chain every sample goes through twice.
+template <typename Engine>
+static void BM_EngineDraw(benchmark::State& state)
+{
+	Engine e;
+	for (auto _ : state)
+	{
+		benchmark::DoNotOptimize(e());
+	}
+	ReportPerItem(state);
+}
+BENCHMARK_TEMPLATE(BM_EngineDraw, std::default_random_engine)->Name("BM_EngineDraw/default_random_engine"); // One line per engine of AVAILABLE_ENGINES.
+
+// Turning raw engine output into a float of [-1, 1), without the cost of the engine itself.
+static void BM_UniformConversion(benchmark::State& state)
+{
+	Replay<std::default_random_engine> raw;
+	std::uniform_real_distribution<float> d(-1.0f, 1.0f);
+	for (auto _ : state)
+	{
+		benchmark::DoNotOptimize(d(raw));
+	}
+	ReportPerItem(state);
+}
+BENCHMARK(BM_UniformConversion);
+
+// Deciding whether a point lies inside the circle and counting it, once per kernel of AVAILABLE_KERNELS.
+static void BM_HitTest_Magnitude(benchmark::State& state)
+{
+	const std::vector<float> xs = RandomFloats(INPUT_SIZE, 1), ys = RandomFloats(INPUT_SIZE, 2);
+	for (auto _ : state)
+	{
+		size_t insideCircle = 0;
+		for (size_t i = 0; i < INPUT_SIZE; i++)
+		{
+			if (working::Magnitude(xs[i], ys[i]) <= 1.0f) insideCircle++;
+		}
+		benchmark::DoNotOptimize(insideCircle);
+	}
+	ReportPerItem(state, INPUT_SIZE);
+}
+BENCHMARK(BM_HitTest_Magnitude)->Name("BM_HitTest/magnitude");
+
+// A whole sample as the strategies draw it: two draws, two conversions and the hit test.
+static void BM_Sample(benchmark::State& state)
+{
+	std::default_random_engine e;
+	std::uniform_real_distribution<float> d(-1.0f, 1.0f);
+	size_t insideCircle = 0;
+	for (auto _ : state)
+	{
+		const float x = d(e);
+		const float y = d(e);
+		if (working::Magnitude(x, y) <= 1.0f) insideCircle++;
+		benchmark::DoNotOptimize(insideCircle);
+	}
+	ReportPerItem(state);
+}
+BENCHMARK(BM_Sample);
+
+// Summing the workers' counts once they're done and turning them into an approximation, per number of workers.
+static void BM_Reduction(benchmark::State& state)
+{
+	const size_t nrOfWorkers = (size_t)state.range(0);
+	std::vector<size_t> counts(nrOfWorkers, 785398);
+	for (auto _ : state)
+	{
+		benchmark::DoNotOptimize(counts.data());
+		benchmark::ClobberMemory(); // The counts are written by other threads in the strategies, force them to be read from memory every time.
+		const size_t insideCircle = std::accumulate(counts.begin(), counts.end(), (size_t)0);
+		benchmark::DoNotOptimize(4.0f * (float)insideCircle / (float)(nrOfWorkers * 1000000));
+	}
+	ReportPerItem(state, (int64_t)nrOfWorkers);
+}
+BENCHMARK(BM_Reduction)->RangeMultiplier(4)->Range(1, 256);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,440 @@
+#include <iostream>
+#include <fstream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <map>
+#include <set>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+
+#include "capture.h"
+#include "json.h"
+#include "statistics.h"
+
+/*
+	Headless analysis of an easy_profiler capture, the numbers the GUI shows turned into text and JSON that can be trended.
+	Per block name over every thread and per thread: count, total, min, max, average and median duration, the latter from easy_profiler's per thread BlockStatistics.
+	Per strategy call, where its time goes: kicking off the workers, the workers' approximation, coordinating the early stop and retrieving the results.
+	And how evenly the work was spread over the workers of every call: the load imbalance max/mean - 1 of their approximation times,
+	and the straggler gap between the last worker to finish and the median one.
+	When the capture holds context switches, also how much of their approximation the workers spent switched out: slow computing and not running at all look alike otherwise.
+*/
+
+constexpr const char* WORKER_BLOCK_NAME = "Approximation subroutine."; // Top-level block of every worker, see Application/include/workingImplementation.h .
+constexpr const char* KICK_OFF_BLOCK_NAME = "Kicking off threads."; // Only the multithreaded strategies have it, which is how their calls are told apart.
+constexpr const char* PREEMPTED_NAME = "Preempted"; // Context switches the scheduler forced, see ProfilerBackend/include/profileSwitches.h .
+
+const char* AnalyzerUsage()
+{
+	return
+		"Usage: ProfileAnalyzer [settings] [<capture.prof>]\n"
+		"  <capture.prof>           Capture to analyze (default profilerOutputs/session.prof).\n"
+		"  --json=<file>            Also write the results as JSON.\n"
+		"  --threads=<on|off>       Print the statistics of every thread, not only those over every thread (default on).\n"
+		"  --help                   Print this message.\n";
+}
+
+struct BlockRow
+{
+	std::string name;
+	size_t count = 0;
+	double total = 0.0; // Nanoseconds, like every duration below.
+	double min = 0.0;
+	double max = 0.0;
+	double mean = 0.0;
+	double median = 0.0;
+};
+
+struct ThreadRows
+{
+	profiler::thread_id_t id = 0;
+	std::string name;
+	std::vector<BlockRow> blocks;
+};
+
+// Where the calls of a strategy spent their time, averaged over its calls.
+struct PhaseRow
+{
+	std::string name;
+	double mean = 0.0; // Per call. For the workers' approximation, per worker.
+	double share = 0.0; // Of the call's duration.
+};
+
+struct StrategyRow
+{
+	std::string name;
+	size_t calls = 0;
+	double callMedian = 0.0;
+	std::vector<PhaseRow> phases;
+	size_t workers = 0; // Per call, the most seen.
+	double kickOffLatency = 0.0; // Mean delay between a call starting and its last worker starting.
+	double imbalance = 0.0; // Mean over the calls of max/mean - 1 of the workers' approximation times.
+	double worstImbalance = 0.0;
+	double stragglerGap = 0.0; // Mean over the calls of last worker end - median worker end.
+	std::string straggler; // Thread that was the last to finish most often.
+	double offCpuShare = NAN; // Mean over the workers of the share of their approximation spent switched out, NaN without context switches in the capture.
+	double stragglerOffCpuShare = NAN; // The same for the last worker to finish of every call.
+	double preemptedShare = NAN; // Of the time switched out, how much was preempted rather than waiting.
+};
+
+// Time a thread spent switched out during a block, and how much of it preempted.
+struct OffCpu
+{
+	double total = 0.0;
+	double preempted = 0.0;
+};
+
+OffCpu OffCpuDuring(const Capture& capture, const profiler::BlocksTreeRoot& root, const profiler::BlocksTree& tree)
+{
+	OffCpu off;
+	const profiler::timestamp_t begin = tree.node->begin();
+	const profiler::timestamp_t end = tree.node->end();
+	// The switches of a thread are in time order and don't overlap, skip those that ended before the block.
+	auto first = std::partition_point(root.sync.begin(), root.sync.end(), [&](const profiler::block_index_t index) { return capture.blocks[index].cs->end() <= begin; });
+	for (auto it = first; it != root.sync.end() && capture.blocks[*it].cs->begin() < end; ++it)
+	{
+		const profiler::SerializedCSwitch& cswitch = *capture.blocks[*it].cs;
+		const double overlap = (double)(std::min(end, cswitch.end()) - std::max(begin, cswitch.begin()));
+		off.total += overlap;
+		if (std::strcmp(cswitch.name(), PREEMPTED_NAME) == 0) off.preempted += overlap;
+	}
+	return off;
+}
+
+BlockRow RowOf(const std::string& name, const std::vector<double>& durations)
+{
+	const Summary summary = Summarize(durations);
+	BlockRow row;
+	row.name = name;
+	row.count = summary.count;
+	row.total = summary.mean * (double)summary.count;
+	row.min = summary.min;
+	row.max = summary.max;
+	row.mean = summary.mean;
+	row.median = summary.median;
+	return row;
+}
+
+// Statistics of every block of a thread, read from the BlockStatistics the reader gathered. They're per call site, sites that share a name get told apart by their location.
+ThreadRows ThreadStatistics(const Capture& capture, const profiler::BlocksTreeRoot& root)
+{
+	ThreadRows rows;
+	rows.id = root.thread_id;
+	rows.name = capture.ThreadName(root);
+	std::set<const profiler::BlockStatistics*> seen;
+	std::vector<const profiler::SerializedBlockDescriptor*> sites;
+	capture.Walk(root, [&](const profiler::block_index_t index, size_t)
+	{
+		const profiler::BlocksTree& tree = capture.blocks[index];
+		const profiler::BlockStatistics* stats = tree.per_thread_stats;
+		if (!stats || capture.Type(tree) != profiler::BlockType::Block || !seen.insert(stats).second) return;
+		BlockRow row;
+		row.name = capture.Name(tree);
+		row.count = stats->calls_number;
+		row.total = (double)stats->total_duration;
+		row.min = (double)capture.blocks[stats->min_duration_block].node->duration();
+		row.max = (double)capture.blocks[stats->max_duration_block].node->duration();
+		row.mean = (double)stats->average_duration();
+		row.median = (double)stats->median_duration;
+		rows.blocks.push_back(row);
+		sites.push_back(capture.Descriptor(tree));
+	});
+	std::map<std::string, size_t> sitesPerName;
+	for (const BlockRow& row : rows.blocks) sitesPerName[row.name]++;
+	for (size_t i = 0; i < rows.blocks.size(); i++)
+	{
+		if (sitesPerName[rows.blocks[i].name] < 2 || !sites[i]) continue;
+		const std::string file = sites[i]->file();
+		rows.blocks[i].name += " @" + file.substr(file.find_last_of("/\\") + 1) + ":" + std::to_string(sites[i]->line());
+	}
+	std::sort(rows.blocks.begin(), rows.blocks.end(), [](const BlockRow& a, const BlockRow& b) { return a.total > b.total; });
+	return rows;
+}
+
+std::vector<StrategyRow> StrategyStatistics(const Capture& capture)
+{
+	struct Worker
+	{
+		const profiler::BlocksTree* tree;
+		std::string thread;
+		const profiler::BlocksTreeRoot* root;
+	};
+	struct Accumulated
+	{
+		std::vector<double> calls;
+		std::map<std::string, double> phaseTotals; // Summed over the calls.
+		std::vector<std::string> phaseOrder;
+		double workerTotal = 0.0; // Approximation time summed over every worker of every call.
+		size_t workerCount = 0;
+		size_t mostWorkers = 0;
+		std::vector<double> kickOffLatencies;
+		std::vector<double> imbalances;
+		std::vector<double> stragglerGaps;
+		std::map<std::string, size_t> stragglers;
+		std::vector<double> offCpuShares; // Per worker.
+		std::vector<double> stragglerOffCpuShares; // Per call.
+		double offCpuTotal = 0.0;
+		double preemptedTotal = 0.0;
+	};
+
+	std::vector<Worker> workers;
+	bool traced = false; // Whether the capture holds context switches.
+	for (const auto& [id, root] : capture.threads)
+	{
+		traced |= !root.sync.empty();
+		for (const profiler::block_index_t index : root.children)
+		{
+			const profiler::BlocksTree& tree = capture.blocks[index];
+			if (capture.Name(tree) == WORKER_BLOCK_NAME) workers.push_back({ &tree, capture.ThreadName(root), &root });
+		}
+	}
+
+	std::map<std::string, Accumulated> strategies;
+	std::vector<std::string> order;
+	for (const profiler::BlocksTreeRoot* root : capture.SortedThreads())
+	{
+		for (const profiler::block_index_t index : root->children)
+		{
+			const profiler::BlocksTree& call = capture.blocks[index];
+			if (capture.Type(call) != profiler::BlockType::Block) continue;
+			bool multithreaded = false;
+			for (const profiler::block_index_t child : call.children) multithreaded |= capture.Name(capture.blocks[child]) == KICK_OFF_BLOCK_NAME;
+			if (!multithreaded) continue; // SingleThread has no phases, anything else isn't a strategy.
+
+			const std::string name = capture.Name(call);
+			if (!strategies.count(name)) order.push_back(name);
+			Accumulated& accumulated = strategies[name];
+			accumulated.calls.push_back((double)call.node->duration());
+			for (const profiler::block_index_t child : call.children)
+			{
+				const profiler::BlocksTree& phase = capture.blocks[child];
+				if (capture.Type(phase) != profiler::BlockType::Block) continue;
+				const std::string phaseName = capture.Name(phase);
+				if (!accumulated.phaseTotals.count(phaseName)) accumulated.phaseOrder.push_back(phaseName);
+				accumulated.phaseTotals[phaseName] += (double)phase.node->duration();
+			}
+
+			// Workers of this call are the ones that started while it was running.
+			std::vector<const Worker*> own;
+			for (const Worker& worker : workers)
+			{
+				if (worker.tree->node->begin() >= call.node->begin() && worker.tree->node->begin() <= call.node->end()) own.push_back(&worker);
+			}
+			if (own.empty()) continue;
+			std::vector<double> durations;
+			std::vector<double> ends;
+			profiler::timestamp_t lastBegin = 0;
+			const Worker* last = own.front();
+			for (const Worker* worker : own)
+			{
+				durations.push_back((double)worker->tree->node->duration());
+				ends.push_back((double)worker->tree->node->end());
+				lastBegin = std::max(lastBegin, worker->tree->node->begin());
+				if (worker->tree->node->end() > last->tree->node->end()) last = worker;
+			}
+			const Summary spread = Summarize(durations);
+			const double imbalance = spread.mean > 0.0 ? spread.max / spread.mean - 1.0 : 0.0;
+			accumulated.workerTotal += spread.mean * (double)spread.count;
+			accumulated.workerCount += own.size();
+			accumulated.mostWorkers = std::max(accumulated.mostWorkers, own.size());
+			accumulated.kickOffLatencies.push_back((double)(lastBegin - call.node->begin()));
+			accumulated.imbalances.push_back(imbalance);
+			accumulated.stragglerGaps.push_back((double)last->tree->node->end() - Summarize(ends).median);
+			accumulated.stragglers[last->thread]++;
+			if (!traced) continue;
+			for (const Worker* worker : own)
+			{
+				const OffCpu off = OffCpuDuring(capture, *worker->root, *worker->tree);
+				const double share = worker->tree->node->duration() ? off.total / (double)worker->tree->node->duration() : 0.0;
+				accumulated.offCpuShares.push_back(share);
+				if (worker == last) accumulated.stragglerOffCpuShares.push_back(share);
+				accumulated.offCpuTotal += off.total;
+				accumulated.preemptedTotal += off.preempted;
+			}
+		}
+	}
+
+	std::vector<StrategyRow> rows;
+	for (const std::string& name : order)
+	{
+		const Accumulated& accumulated = strategies[name];
+		StrategyRow row;
+		row.name = name;
+		row.calls = accumulated.calls.size();
+		const Summary calls = Summarize(accumulated.calls);
+		row.callMedian = calls.median;
+		const auto phase = [&](const std::string& phaseName, const double mean)
+		{
+			row.phases.push_back({ phaseName, mean, calls.mean > 0.0 ? mean / calls.mean : 0.0 });
+		};
+		for (const std::string& phaseName : accumulated.phaseOrder)
+		{
+			phase(phaseName, accumulated.phaseTotals.at(phaseName) / (double)row.calls);
+			if (phaseName == KICK_OFF_BLOCK_NAME && accumulated.workerCount) phase(WORKER_BLOCK_NAME, accumulated.workerTotal / (double)accumulated.workerCount); // Between kicking off and retrieving, where it happens.
+		}
+		if (accumulated.workerCount)
+		{
+			row.workers = accumulated.mostWorkers;
+			row.kickOffLatency = Summarize(accumulated.kickOffLatencies).mean;
+			const Summary imbalances = Summarize(accumulated.imbalances);
+			row.imbalance = imbalances.mean;
+			row.worstImbalance = imbalances.max;
+			row.stragglerGap = Summarize(accumulated.stragglerGaps).mean;
+			row.straggler = std::max_element(accumulated.stragglers.begin(), accumulated.stragglers.end(), [](const auto& a, const auto& b) { return a.second < b.second; })->first;
+		}
+		if (!accumulated.offCpuShares.empty())
+		{
+			row.offCpuShare = Summarize(accumulated.offCpuShares).mean;
+			row.stragglerOffCpuShare = Summarize(accumulated.stragglerOffCpuShares).mean;
+			row.preemptedShare = accumulated.offCpuTotal > 0.0 ? accumulated.preemptedTotal / accumulated.offCpuTotal : 0.0;
+		}
+		rows.push_back(row);
+	}
+	return rows;
+}
+
+std::string Ms(const double ns)
+{
+	std::ostringstream ss;
+	ss << std::fixed << std::setprecision(3) << ns * 1e-6;
+	return ss.str();
+}
+
+void PrintBlocks(const std::vector<BlockRow>& rows, const std::string& indent)
+{
+	int width = 40;
+	for (const BlockRow& row : rows) width = std::max(width, (int)row.name.size() + 2);
+	std::cout << indent << std::left << std::setw(width) << "Block" << std::right << std::setw(8) << "Count" << std::setw(13) << "Total ms" << std::setw(12) << "Min ms"
+		<< std::setw(12) << "Max ms" << std::setw(12) << "Avg ms" << std::setw(12) << "Median ms" << std::endl;
+	for (const BlockRow& row : rows)
+	{
+		std::cout << indent << std::left << std::setw(width) << row.name << std::right << std::setw(8) << row.count << std::setw(13) << Ms(row.total) << std::setw(12) << Ms(row.min)
+			<< std::setw(12) << Ms(row.max) << std::setw(12) << Ms(row.mean) << std::setw(12) << Ms(row.median) << std::endl;
+	}
+}
+
+void PrintStrategies(const std::vector<StrategyRow>& rows)
+{
+	for (const StrategyRow& row : rows)
+	{
+		std::cout << row.name << " " << row.calls << " calls, median " << Ms(row.callMedian) << " ms per call." << std::endl;
+		for (const PhaseRow& phase : row.phases)
+		{
+			std::cout << "  " << std::left << std::setw(38) << phase.name << std::right << std::setw(12) << Ms(phase.mean) << " ms" << std::setw(8) << std::fixed << std::setprecision(1) << phase.share * 100.0 << "%"
+				<< (phase.name == WORKER_BLOCK_NAME ? " (per worker, in parallel with the other phases)" : "") << std::endl;
+			std::cout.unsetf(std::ios::floatfield);
+		}
+		if (row.workers == 0) continue;
+		std::cout << std::fixed << std::setprecision(1)
+			<< "  Workers: " << row.workers << ", last one started " << Ms(row.kickOffLatency) << " ms into the call." << std::endl
+			<< "  Imbalance (slowest / mean - 1): " << row.imbalance * 100.0 << "% mean, " << row.worstImbalance * 100.0 << "% worst call." << std::endl
+			<< "  Straggler gap (last end - median end): " << Ms(row.stragglerGap) << " ms, most often " << row.straggler << "." << std::endl;
+		if (!std::isnan(row.offCpuShare))
+		{
+			std::cout << "  Switched out: " << row.offCpuShare * 100.0 << "% of a worker's approximation, " << row.stragglerOffCpuShare * 100.0 << "% for the last to finish, "
+				<< row.preemptedShare * 100.0 << "% of it preempted." << std::endl;
+		}
+		std::cout.unsetf(std::ios::floatfield);
+	}
+}
+
+std::string BlocksJson(const std::vector<BlockRow>& rows, const std::string& indent)
+{
+	std::string json = "[";
+	for (size_t i = 0; i < rows.size(); i++)
+	{
+		const BlockRow& row = rows[i];
+		json += (i ? ",\n" : "\n") + indent + "  { \"name\": " + JsonString(row.name) + ", \"count\": " + std::to_string(row.count) + ", \"totalNs\": " + JsonNumber(row.total)
+			+ ", \"minNs\": " + JsonNumber(row.min) + ", \"maxNs\": " + JsonNumber(row.max) + ", \"meanNs\": " + JsonNumber(row.mean) + ", \"medianNs\": " + JsonNumber(row.median) + " }";
+	}
+	return json + "\n" + indent + "]";
+}
+
+void WriteJson(const Capture& capture, const std::vector<BlockRow>& blocks, const std::vector<ThreadRows>& threads, const std::vector<StrategyRow>& strategies, const std::string& path)
+{
+	std::ofstream file(path);
+	if (!file) throw std::runtime_error("Can't write \"" + path + "\".");
+	file << "{\n  \"capture\": " << JsonString(capture.path) << ",\n  \"durationNs\": " << JsonNumber((double)(capture.range.endTime - capture.range.beginTime)) << ",\n";
+	file << "  \"blocks\": " << BlocksJson(blocks, "  ") << ",\n  \"threads\": [";
+	for (size_t i = 0; i < threads.size(); i++)
+	{
+		file << (i ? ",\n" : "\n") << "    { \"id\": " << threads[i].id << ", \"name\": " << JsonString(threads[i].name) << ", \"blocks\": " << BlocksJson(threads[i].blocks, "    ") << " }";
+	}
+	file << "\n  ],\n  \"strategies\": [";
+	for (size_t i = 0; i < strategies.size(); i++)
+	{
+		const StrategyRow& row = strategies[i];
+		file << (i ? ",\n" : "\n") << "    { \"name\": " << JsonString(row.name) << ", \"calls\": " << row.calls << ", \"callMedianNs\": " << JsonNumber(row.callMedian) << ", \"phases\": [";
+		for (size_t j = 0; j < row.phases.size(); j++)
+		{
+			file << (j ? ", " : "") << "{ \"name\": " << JsonString(row.phases[j].name) << ", \"meanNs\": " << JsonNumber(row.phases[j].mean) << ", \"share\": " << JsonNumber(row.phases[j].share) << " }";
+		}
+		file << "], \"workers\": " << row.workers << ", \"kickOffLatencyNs\": " << JsonNumber(row.kickOffLatency) << ", \"imbalance\": " << JsonNumber(row.imbalance)
+			<< ", \"worstImbalance\": " << JsonNumber(row.worstImbalance) << ", \"stragglerGapNs\": " << JsonNumber(row.stragglerGap) << ", \"straggler\": " << JsonString(row.straggler)
+			<< ", \"offCpuShare\": " << JsonNumber(row.offCpuShare) << ", \"stragglerOffCpuShare\": " << JsonNumber(row.stragglerOffCpuShare) << ", \"preemptedShare\": " << JsonNumber(row.preemptedShare) << " }";
+	}
+	file << "\n  ]\n}\n";
+}
+
+int main(int argc, char* argv[])
+{
+	std::string path = "profilerOutputs/session.prof";
+	std::string jsonPath;
+	bool perThread = true;
+	for (int i = 1; i < argc; i++)
+	{
+		const std::string arg = argv[i];
+		if (arg == "--help" || arg == "-h")
+		{
+			std::cout << AnalyzerUsage();
+			return 0;
+		}
+		else if (arg.rfind("--json=", 0) == 0) jsonPath = arg.substr(7);
+		else if (arg == "--threads=on" || arg == "--threads=off") perThread = arg == "--threads=on";
+		else if (arg.rfind("--", 0) == 0 || arg.empty())
+		{
+			std::cerr << "Unknown setting \"" << arg << "\"." << std::endl << AnalyzerUsage();
+			return 1;
+		}
+		else path = arg;
+	}
+
+	try
+	{
+		const std::unique_ptr<Capture> capture = LoadCapture(path);
+
+		std::vector<BlockRow> blocks;
+		for (const auto& [name, durations] : capture->DurationsByName()) blocks.push_back(RowOf(name, durations));
+		std::sort(blocks.begin(), blocks.end(), [](const BlockRow& a, const BlockRow& b) { return a.total > b.total; });
+		std::vector<ThreadRows> threads;
+		for (const profiler::BlocksTreeRoot* root : capture->SortedThreads()) threads.push_back(ThreadStatistics(*capture, *root));
+		const std::vector<StrategyRow> strategies = StrategyStatistics(*capture);
+
+		std::cout << path << ": " << capture->threads.size() << " threads, " << capture->blocks.size() << " records over " << Ms((double)(capture->range.endTime - capture->range.beginTime)) << " ms." << std::endl;
+		std::cout << std::endl << "Every thread:" << std::endl;
+		PrintBlocks(blocks, "  ");
+		if (perThread)
+		{
+			for (const ThreadRows& thread : threads)
+			{
+				if (thread.blocks.empty()) continue;
+				std::cout << std::endl << thread.name << " (" << thread.id << "):" << std::endl;
+				PrintBlocks(thread.blocks, "  ");
+			}
+		}
+		if (!strategies.empty())
+		{
+			std::cout << std::endl << "Phases of the strategies:" << std::endl;
+			PrintStrategies(strategies);
+		}
+		if (!jsonPath.empty()) WriteJson(*capture, blocks, threads, strategies, jsonPath);
+	}
+	catch (const std::runtime_error& e)
+	{
+		std::cerr << e.what() << std::endl;
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,216 @@
+#include <iostream>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <map>
+#include <cmath>
+#include <cstdlib>
+#include <stdexcept>
+
+#include "capture.h"
+#include "json.h"
+#include "statistics.h"
+
+/*
+	Compares two easy_profiler captures block name by block name, to tell whether a change made things faster or only moved the noise around.
+	For every name over every thread: the change in call count, in mean, median and total duration,
+	and a two-sided Mann-Whitney U test of whether the durations differ at all, since block timings are too skewed for a t-test.
+	Rows come sorted by how much total time moved, names only one of the captures has included.
+*/
+
+const char* DiffUsage()
+{
+	return
+		"Usage: ProfileDiff [settings] <before.prof> <after.prof>\n"
+		"  --alpha=<p>              Significance level below which a change is reported as real (default 0.01).\n"
+		"  --json=<file>            Also write the comparison as JSON.\n"
+		"  --help                   Print this message.\n";
+}
+
+struct DiffRow
+{
+	std::string name;
+	Summary before; // Nanoseconds, count 0 if the block isn't in that capture.
+	Summary after;
+	double totalBefore = 0.0;
+	double totalAfter = 0.0;
+	double pValue = 1.0; // Two-sided, 1 if either capture has no such block.
+
+	double MeanChange() const { return before.mean > 0.0 ? after.mean / before.mean - 1.0 : 0.0; }
+	double MedianChange() const { return before.median > 0.0 ? after.median / before.median - 1.0 : 0.0; }
+	double TotalDelta() const { return totalAfter - totalBefore; }
+	long long CountDelta() const { return (long long)after.count - (long long)before.count; }
+};
+
+double Total(const std::vector<double>& durations)
+{
+	double total = 0.0;
+	for (const double duration : durations) total += duration;
+	return total;
+}
+
+std::vector<DiffRow> Compare(const Capture& before, const Capture& after)
+{
+	const std::map<std::string, std::vector<double>> a = before.DurationsByName();
+	const std::map<std::string, std::vector<double>> b = after.DurationsByName();
+	std::map<std::string, DiffRow> rows;
+	for (const auto& [name, durations] : a)
+	{
+		DiffRow& row = rows[name];
+		row.name = name;
+		row.before = Summarize(durations);
+		row.totalBefore = Total(durations);
+	}
+	for (const auto& [name, durations] : b)
+	{
+		DiffRow& row = rows[name];
+		row.name = name;
+		row.after = Summarize(durations);
+		row.totalAfter = Total(durations);
+		const auto other = a.find(name);
+		if (other != a.end()) row.pValue = MannWhitneyTwoSided(other->second, durations).pValue;
+	}
+
+	std::vector<DiffRow> sorted;
+	for (auto& [name, row] : rows) sorted.push_back(std::move(row));
+	std::sort(sorted.begin(), sorted.end(), [](const DiffRow& x, const DiffRow& y) { return std::abs(x.TotalDelta()) > std::abs(y.TotalDelta()); });
+	return sorted;
+}
+
+std::string Ms(const double ns)
+{
+	std::ostringstream ss;
+	ss << std::fixed << std::setprecision(3) << ns * 1e-6;
+	return ss.str();
+}
+
+std::string Percent(const double change)
+{
+	std::ostringstream ss;
+	ss << std::showpos << std::fixed << std::setprecision(1) << change * 100.0 << "%";
+	return ss.str();
+}
+
+// Like papers put it: under the first usual level it clears, the value itself above them.
+std::string Significance(const double pValue)
+{
+	for (const double level : { 0.001, 0.01, 0.05 }) if (pValue < level)
+	{
+		std::ostringstream ss;
+		ss << "p < " << level;
+		return ss.str();
+	}
+	std::ostringstream ss;
+	ss << "p = " << std::fixed << std::setprecision(2) << pValue;
+	return ss.str();
+}
+
+void PrintRows(const std::vector<DiffRow>& rows, const double alpha)
+{
+	int width = 40;
+	for (const DiffRow& row : rows) width = std::max(width, (int)row.name.size() + 2);
+	std::cout << std::left << std::setw(width) << "Block" << std::right << std::setw(9) << "Count" << std::setw(11) << "Count chg" << std::setw(15) << "Avg ms before" << std::setw(14) << "Avg ms after"
+		<< std::setw(10) << "Avg chg" << std::setw(12) << "Median chg" << std::setw(15) << "Total chg ms" << "  Significance" << std::endl;
+	for (const DiffRow& row : rows)
+	{
+		std::cout << std::left << std::setw(width) << row.name << std::right << std::setw(9) << row.after.count << std::setw(11) << (row.CountDelta() > 0 ? "+" : "") + std::to_string(row.CountDelta());
+		if (row.before.count == 0 || row.after.count == 0)
+		{
+			std::cout << std::setw(15) << (row.before.count ? Ms(row.before.mean) : "-") << std::setw(14) << (row.after.count ? Ms(row.after.mean) : "-") << std::setw(22) << ""
+				<< std::setw(15) << Ms(row.TotalDelta()) << "  only " << (row.before.count ? "before" : "after") << std::endl;
+			continue;
+		}
+		std::cout << std::setw(15) << Ms(row.before.mean) << std::setw(14) << Ms(row.after.mean) << std::setw(10) << Percent(row.MeanChange()) << std::setw(12) << Percent(row.MedianChange())
+			<< std::setw(15) << Ms(row.TotalDelta()) << "  " << Significance(row.pValue) << (row.pValue < alpha ? " *" : "") << std::endl;
+	}
+
+	std::cout << std::endl;
+	size_t significant = 0;
+	for (const DiffRow& row : rows)
+	{
+		if (row.before.count == 0 || row.after.count == 0 || row.pValue >= alpha) continue;
+		std::cout << "\"" << row.name << "\" mean " << Percent(row.MeanChange()) << ", " << Significance(row.pValue) << "." << std::endl;
+		significant++;
+	}
+	if (significant == 0) std::cout << "No block changed significantly at alpha = " << alpha << "." << std::endl;
+}
+
+std::string SummaryJson(const Summary& summary, const double total)
+{
+	return "{ \"count\": " + std::to_string(summary.count) + ", \"totalNs\": " + JsonNumber(total) + ", \"meanNs\": " + JsonNumber(summary.mean) + ", \"medianNs\": " + JsonNumber(summary.median)
+		+ ", \"stddevNs\": " + JsonNumber(summary.stddev) + " }";
+}
+
+void WriteJson(const Capture& before, const Capture& after, const std::vector<DiffRow>& rows, const double alpha, const std::string& path)
+{
+	std::ofstream file(path);
+	if (!file) throw std::runtime_error("Can't write \"" + path + "\".");
+	file << "{\n  \"before\": " << JsonString(before.path) << ",\n  \"after\": " << JsonString(after.path) << ",\n  \"alpha\": " << JsonNumber(alpha) << ",\n  \"blocks\": [";
+	for (size_t i = 0; i < rows.size(); i++)
+	{
+		const DiffRow& row = rows[i];
+		const bool both = row.before.count && row.after.count;
+		file << (i ? ",\n" : "\n") << "    { \"name\": " << JsonString(row.name) << ", \"before\": " << SummaryJson(row.before, row.totalBefore) << ", \"after\": " << SummaryJson(row.after, row.totalAfter)
+			<< ", \"countDelta\": " << row.CountDelta() << ", \"meanChange\": " << (both ? JsonNumber(row.MeanChange()) : "null") << ", \"medianChange\": " << (both ? JsonNumber(row.MedianChange()) : "null")
+			<< ", \"totalDeltaNs\": " << JsonNumber(row.TotalDelta()) << ", \"pValue\": " << (both ? JsonNumber(row.pValue) : "null") << ", \"significant\": " << (both && row.pValue < alpha ? "true" : "false") << " }";
+	}
+	file << "\n  ]\n}\n";
+}
+
+int main(int argc, char* argv[])
+{
+	std::vector<std::string> paths;
+	std::string jsonPath;
+	double alpha = 0.01;
+	for (int i = 1; i < argc; i++)
+	{
+		const std::string arg = argv[i];
+		if (arg == "--help" || arg == "-h")
+		{
+			std::cout << DiffUsage();
+			return 0;
+		}
+		else if (arg.rfind("--json=", 0) == 0) jsonPath = arg.substr(7);
+		else if (arg.rfind("--alpha=", 0) == 0)
+		{
+			char* end = nullptr;
+			alpha = std::strtod(arg.c_str() + 8, &end);
+			if (*end != '\0' || !(alpha > 0.0 && alpha < 1.0))
+			{
+				std::cerr << "Unknown setting \"" << arg << "\"." << std::endl << DiffUsage();
+				return 1;
+			}
+		}
+		else if (arg.rfind("--", 0) == 0 || arg.empty())
+		{
+			std::cerr << "Unknown setting \"" << arg << "\"." << std::endl << DiffUsage();
+			return 1;
+		}
+		else paths.push_back(arg);
+	}
+	if (paths.size() != 2)
+	{
+		std::cerr << "Two captures are needed." << std::endl << DiffUsage();
+		return 1;
+	}
+
+	try
+	{
+		const std::unique_ptr<Capture> before = LoadCapture(paths[0], false);
+		const std::unique_ptr<Capture> after = LoadCapture(paths[1], false);
+		const std::vector<DiffRow> rows = Compare(*before, *after);
+
+		std::cout << paths[0] << " (" << Ms((double)(before->range.endTime - before->range.beginTime)) << " ms) -> " << paths[1] << " (" << Ms((double)(after->range.endTime - after->range.beginTime)) << " ms)."
+			<< std::endl << std::endl;
+		PrintRows(rows, alpha);
+		if (!jsonPath.empty()) WriteJson(*before, *after, rows, alpha, jsonPath);
+	}
+	catch (const std::runtime_error& e)
+	{
+		std::cerr << e.what() << std::endl;
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,339 @@
+#include <iostream>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <map>
+#include <tuple>
+#include <cstring>
+#include <cstdlib>
+#include <filesystem>
+#include <stdexcept>
+
+#include <easy/writer.h>
+
+#include "capture.h"
+#include "json.h"
+#include "statistics.h"
+
+/*
+	Combines the captures of many runs into one, to reason about performance over dozens of runs rather than a single noisy one.
+	The runs are laid out one after the other on the merged timeline, each starting with a bookmark named after its file,
+	and their threads are kept apart as "Run <n> - <thread>" so that the GUI groups them per run.
+	Also prints, for every block name, how its per-run mean and total duration spread across the runs.
+*/
+
+constexpr uint64_t RUN_SHIFT = 32; // Thread ids of run n get n in their high half, real ids stay well below 2^32.
+constexpr profiler::color_t RUN_BOOKMARK_COLOR = 0xff2196f3;
+
+const char* MergeUsage()
+{
+	return
+		"Usage: ProfileMerge [settings] <capture.prof|directory>...\n"
+		"  <capture.prof>           Capture to merge. Directories stand for the \"session_*.prof\" captures they hold, in name order.\n"
+		"  --output=<file>          Merged capture (default profilerOutputs/merged.prof).\n"
+		"  --gap=<ms>               Space left between runs on the merged timeline (default 100).\n"
+		"  --json=<file>            Also write the statistics across runs as JSON.\n"
+		"  --help                   Print this message.\n";
+}
+
+// How a block name fared over the runs that have it.
+struct RunsRow
+{
+	std::string name;
+	std::vector<double> counts; // Per run.
+	std::vector<double> means; // Nanoseconds.
+	std::vector<double> totals;
+};
+
+std::vector<std::string> ExpandPaths(const std::vector<std::string>& args)
+{
+	std::vector<std::string> paths;
+	for (const std::string& arg : args)
+	{
+		std::error_code error;
+		if (!std::filesystem::is_directory(arg, error))
+		{
+			paths.push_back(arg);
+			continue;
+		}
+		std::vector<std::string> found;
+		for (const auto& entry : std::filesystem::directory_iterator(arg, error))
+		{
+			const std::string name = entry.path().filename().string();
+			if (entry.is_regular_file() && name.rfind("session_", 0) == 0 && entry.path().extension() == ".prof") found.push_back(entry.path().string());
+		}
+		std::sort(found.begin(), found.end());
+		paths.insert(paths.end(), found.begin(), found.end());
+	}
+	return paths;
+}
+
+// Every record starts with its begin and end, see ProfileReader::ConvertTimes().
+void ShiftTimes(char* record, const int64_t shift)
+{
+	for (size_t i = 0; i < 2; i++)
+	{
+		profiler::timestamp_t time = 0;
+		std::memcpy(&time, record + i * sizeof(time), sizeof(time));
+		time = (profiler::timestamp_t)((int64_t)time + shift);
+		std::memcpy(record + i * sizeof(time), &time, sizeof(time));
+	}
+}
+
+void SetId(char* record, const profiler::block_id_t id)
+{
+	std::memcpy(record + 2 * sizeof(profiler::timestamp_t), &id, sizeof(id)); // After begin and end, see BaseBlockData.
+}
+
+/*
+	The captures merged into one set of trees. Their blocks stay where they were loaded, their indices are offset so that they don't collide:
+	block i of run n is index bases[n] + i of the merged trees.
+*/
+class Merge
+{
+public:
+	explicit Merge(const int64_t gapNs) : gapNs_(gapNs) {}
+
+	void Add(std::unique_ptr<Capture> capture)
+	{
+		const size_t run = runs_.size();
+		Capture& c = *capture;
+		const profiler::block_index_t base = runs_.empty() ? 0 : bases_.back() + (profiler::block_index_t)runs_.back()->blocks.size();
+
+		// Back to back on the merged timeline, the first run keeps its times.
+		if (runs_.empty()) range_ = c.range;
+		const profiler::timestamp_t start = runs_.empty() ? c.range.beginTime : range_.endTime + (profiler::timestamp_t)gapNs_;
+		const int64_t shift = (int64_t)start - (int64_t)c.range.beginTime;
+		range_.endTime = (profiler::timestamp_t)((int64_t)c.range.endTime + shift);
+		bookmarks_.push_back({ "Run " + std::to_string(run + 1) + ": " + c.path, start, RUN_BOOKMARK_COLOR });
+		for (const profiler::Bookmark& bookmark : c.bookmarks) bookmarks_.push_back({ bookmark.text, (profiler::timestamp_t)((int64_t)bookmark.pos + shift), bookmark.color });
+
+		// Descriptors with the same name, place and type are the same block whichever run they come from.
+		std::vector<profiler::block_id_t> ids(c.descriptors.size(), 0);
+		for (size_t id = 0; id < c.descriptors.size(); id++)
+		{
+			if (c.descriptors[id]) ids[id] = MergedId(*c.descriptors[id]);
+		}
+
+		for (const auto& [id, root] : c.threads)
+		{
+			profiler::BlocksTreeRoot merged;
+			merged.thread_id = ((uint64_t)(run + 1) << RUN_SHIFT) | root.thread_id;
+			merged.thread_name = "Run " + std::to_string(run + 1) + " - " + c.ThreadName(root);
+			for (const profiler::block_index_t index : root.sync)
+			{
+				ShiftTimes(reinterpret_cast<char*>(c.blocks[index].cs), shift);
+				merged.sync.push_back(base + index);
+			}
+			for (const profiler::block_index_t index : root.events) merged.events.push_back(base + index);
+			for (const profiler::block_index_t index : root.children) merged.children.push_back(base + index);
+			c.Walk(root, [&](const profiler::block_index_t index, size_t)
+			{
+				profiler::BlocksTree& tree = c.blocks[index];
+				char* record = reinterpret_cast<char*>(tree.node);
+				ShiftTimes(record, shift);
+				const profiler::block_id_t id = tree.node->id();
+				SetId(record, id < ids.size() ? ids[id] : id);
+			});
+			threads_[merged.thread_id] = std::move(merged);
+		}
+		for (profiler::BlocksTree& tree : c.blocks)
+		{
+			for (profiler::block_index_t& child : tree.children) child += base;
+		}
+		bases_.push_back(base);
+		runs_.push_back(std::move(capture));
+	}
+
+	// Throws std::runtime_error with the writer's explanation if the merged capture can't be written.
+	profiler::block_index_t Write(const std::string& path) const
+	{
+		profiler::SerializedData serialized;
+		serialized.set(descriptorsData_.size());
+		if (!descriptorsData_.empty()) std::memcpy(serialized.data(), descriptorsData_.data(), descriptorsData_.size());
+		profiler::descriptors_list_t descriptors;
+		for (const size_t at : descriptorOffsets_) descriptors.push_back(reinterpret_cast<profiler::SerializedBlockDescriptor*>(serialized[at]));
+
+		std::ostringstream log;
+		const profiler::block_index_t count = writeTreesToFile(path.c_str(), serialized, descriptors, (profiler::block_id_t)descriptors.size(), threads_, bookmarks_,
+			[this](const profiler::block_index_t index) -> const profiler::BlocksTree& { return Block(index); }, range_.beginTime, range_.endTime, runs_.front()->pid, log);
+		if (count == 0) throw std::runtime_error("Can't write \"" + path + "\": " + (log.str().empty() ? std::string("no blocks") : log.str()) + ".");
+		return count;
+	}
+
+	const std::vector<std::unique_ptr<Capture>>& Runs() const { return runs_; }
+
+private:
+	const profiler::BlocksTree& Block(const profiler::block_index_t index) const
+	{
+		const size_t run = (size_t)(std::upper_bound(bases_.begin(), bases_.end(), index) - bases_.begin()) - 1;
+		return runs_[run]->blocks[index - bases_[run]];
+	}
+
+	profiler::block_id_t MergedId(const profiler::SerializedBlockDescriptor& descriptor)
+	{
+		const auto key = std::make_tuple(std::string(descriptor.name()), std::string(descriptor.file()), descriptor.line(), (int)descriptor.type());
+		const auto [found, fresh] = ids_.try_emplace(key, (profiler::block_id_t)descriptorOffsets_.size());
+		if (fresh)
+		{
+			const size_t size = sizeof(profiler::BaseBlockDescriptor) + sizeof(uint16_t) + std::strlen(descriptor.name()) + 1 + std::strlen(descriptor.file()) + 1; // Base, name length, name, file.
+			descriptorOffsets_.push_back(descriptorsData_.size());
+			descriptorsData_.append(descriptor.data(), size);
+			std::memcpy(&descriptorsData_[descriptorOffsets_.back()], &found->second, sizeof(profiler::block_id_t)); // The id comes first.
+		}
+		return found->second;
+	}
+
+	int64_t gapNs_;
+	std::vector<std::unique_ptr<Capture>> runs_;
+	std::vector<profiler::block_index_t> bases_;
+	profiler::thread_blocks_tree_t threads_;
+	profiler::bookmarks_t bookmarks_;
+	profiler::BeginEndTime range_ = { 0, 0 };
+	std::map<std::tuple<std::string, std::string, int, int>, profiler::block_id_t> ids_;
+	std::string descriptorsData_;
+	std::vector<size_t> descriptorOffsets_;
+};
+
+// Before the capture is merged, the merge gives its records the merged descriptor ids.
+void AddRun(std::map<std::string, RunsRow>& rows, const Capture& capture)
+{
+	for (const auto& [name, durations] : capture.DurationsByName())
+	{
+		RunsRow& row = rows[name];
+		row.name = name;
+		const Summary summary = Summarize(durations);
+		row.counts.push_back((double)summary.count);
+		row.means.push_back(summary.mean);
+		row.totals.push_back(summary.mean * (double)summary.count);
+	}
+}
+
+std::vector<RunsRow> SortedRows(std::map<std::string, RunsRow>& rows)
+{
+	std::vector<RunsRow> sorted;
+	for (auto& [name, row] : rows) sorted.push_back(std::move(row));
+	std::sort(sorted.begin(), sorted.end(), [](const RunsRow& a, const RunsRow& b) { return Summarize(a.totals).mean > Summarize(b.totals).mean; });
+	return sorted;
+}
+
+std::string Ms(const double ns)
+{
+	std::ostringstream ss;
+	ss << std::fixed << std::setprecision(3) << ns * 1e-6;
+	return ss.str();
+}
+
+void PrintRows(const std::vector<RunsRow>& rows, const size_t runs)
+{
+	int width = 40;
+	for (const RunsRow& row : rows) width = std::max(width, (int)row.name.size() + 2);
+	std::cout << std::left << std::setw(width) << "Block" << std::right << std::setw(6) << "Runs" << std::setw(11) << "Count/run" << std::setw(12) << "Avg ms" << std::setw(12) << "Min avg"
+		<< std::setw(12) << "Max avg" << std::setw(8) << "CV" << std::setw(14) << "Total ms/run" << std::setw(8) << "CV" << std::endl;
+	for (const RunsRow& row : rows)
+	{
+		const Summary counts = Summarize(row.counts);
+		const Summary means = Summarize(row.means);
+		const Summary totals = Summarize(row.totals);
+		std::ostringstream meanCv, totalCv;
+		meanCv << std::fixed << std::setprecision(1) << means.Cv() * 100.0 << "%";
+		totalCv << std::fixed << std::setprecision(1) << totals.Cv() * 100.0 << "%";
+		std::cout << std::left << std::setw(width) << row.name << std::right << std::setw(6) << row.means.size() << std::setw(11) << std::fixed << std::setprecision(1) << counts.mean
+			<< std::setw(12) << Ms(means.mean) << std::setw(12) << Ms(means.min) << std::setw(12) << Ms(means.max) << std::setw(8) << meanCv.str()
+			<< std::setw(14) << Ms(totals.mean) << std::setw(8) << totalCv.str() << (row.means.size() < runs ? "  missing from some runs" : "") << std::endl;
+	}
+}
+
+std::string SummaryJson(const Summary& summary)
+{
+	return "{ \"mean\": " + JsonNumber(summary.mean) + ", \"median\": " + JsonNumber(summary.median) + ", \"min\": " + JsonNumber(summary.min) + ", \"max\": " + JsonNumber(summary.max)
+		+ ", \"stddev\": " + JsonNumber(summary.stddev) + ", \"cv\": " + JsonNumber(summary.Cv()) + " }";
+}
+
+void WriteJson(const std::vector<std::unique_ptr<Capture>>& runs, const std::vector<double>& durations, const std::vector<RunsRow>& rows, const std::string& output, const std::string& path)
+{
+	std::ofstream file(path);
+	if (!file) throw std::runtime_error("Can't write \"" + path + "\".");
+	file << "{\n  \"merged\": " << JsonString(output) << ",\n  \"runs\": [";
+	for (size_t i = 0; i < runs.size(); i++) file << (i ? ", " : "") << "{ \"capture\": " << JsonString(runs[i]->path) << ", \"durationNs\": " << JsonNumber(durations[i]) << " }";
+	file << "],\n  \"runDurationNs\": " << SummaryJson(Summarize(durations)) << ",\n  \"blocks\": [";
+	for (size_t i = 0; i < rows.size(); i++)
+	{
+		const RunsRow& row = rows[i];
+		file << (i ? ",\n" : "\n") << "    { \"name\": " << JsonString(row.name) << ", \"runs\": " << row.means.size() << ", \"countPerRun\": " << SummaryJson(Summarize(row.counts))
+			<< ", \"meanNs\": " << SummaryJson(Summarize(row.means)) << ", \"totalNsPerRun\": " << SummaryJson(Summarize(row.totals)) << " }";
+	}
+	file << "\n  ]\n}\n";
+}
+
+int main(int argc, char* argv[])
+{
+	std::vector<std::string> args;
+	std::string output = "profilerOutputs/merged.prof";
+	std::string jsonPath;
+	double gapMs = 100.0;
+	for (int i = 1; i < argc; i++)
+	{
+		const std::string arg = argv[i];
+		if (arg == "--help" || arg == "-h")
+		{
+			std::cout << MergeUsage();
+			return 0;
+		}
+		else if (arg.rfind("--output=", 0) == 0) output = arg.substr(9);
+		else if (arg.rfind("--json=", 0) == 0) jsonPath = arg.substr(7);
+		else if (arg.rfind("--gap=", 0) == 0)
+		{
+			char* end = nullptr;
+			gapMs = std::strtod(arg.c_str() + 6, &end);
+			if (*end != '\0' || !(gapMs >= 0.0))
+			{
+				std::cerr << "Unknown setting \"" << arg << "\"." << std::endl << MergeUsage();
+				return 1;
+			}
+		}
+		else if (arg.rfind("--", 0) == 0 || arg.empty())
+		{
+			std::cerr << "Unknown setting \"" << arg << "\"." << std::endl << MergeUsage();
+			return 1;
+		}
+		else args.push_back(arg);
+	}
+	const std::vector<std::string> paths = ExpandPaths(args);
+	if (paths.empty())
+	{
+		std::cerr << "No captures to merge." << std::endl << MergeUsage();
+		return 1;
+	}
+
+	try
+	{
+		Merge merge((int64_t)(gapMs * 1e6));
+		std::vector<double> durations;
+		std::map<std::string, RunsRow> byName;
+		for (const std::string& path : paths)
+		{
+			std::unique_ptr<Capture> capture = LoadCapture(path, false);
+			durations.push_back((double)(capture->range.endTime - capture->range.beginTime));
+			AddRun(byName, *capture);
+			merge.Add(std::move(capture));
+		}
+		const std::vector<RunsRow> rows = SortedRows(byName);
+		const profiler::block_index_t count = merge.Write(output);
+
+		const Summary runDurations = Summarize(durations);
+		std::cout << "Merged " << paths.size() << " captures, " << count << " records, into " << output << "." << std::endl;
+		std::cout << "Run duration: mean " << Ms(runDurations.mean) << " ms, min " << Ms(runDurations.min) << " ms, max " << Ms(runDurations.max) << " ms, CV " << std::fixed << std::setprecision(1)
+			<< runDurations.Cv() * 100.0 << "%." << std::endl << std::endl;
+		PrintRows(rows, paths.size());
+		if (!jsonPath.empty()) WriteJson(merge.Runs(), durations, rows, output, jsonPath);
+	}
+	catch (const std::runtime_error& e)
+	{
+		std::cerr << e.what() << std::endl;
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <ostream>
+#include <istream>
+
+#include <easy/profiler.h>
+#include <easy/serialized_block.h>
+
+/*
+	Layout of the .prof files the in-tree backend writes, modelled on easy_profiler 2.1's so that captures taken on Linux can be opened with its GUI on Windows.
+	All integers are little-endian and every structure is packed, a file is made of:
+		ProfileHeader
+		descriptorsCount times: uint16_t size, SerializedBlockDescriptor (BaseBlockDescriptor, uint16_t name length, name, file name)
+		per thread: uint64_t thread id, uint16_t name size, name,
+			uint32_t count, count times: uint16_t size, SerializedCSwitch (begin, end, thread id switched to, name),
+			uint32_t count, count times: uint16_t size, SerializedBlock (begin, end, descriptor id, run-time name) or ArbitraryValue when the descriptor is a Value
+		uint32_t PROFILE_SIGNATURE, marks the end of the threads
+		bookmarksCount times: uint16_t size, uint64_t position, uint32_t color, text
+	Blocks of a thread are stored in the order they ended, children before their parent, which is what the readers rebuild the trees from.
+*/
+
+constexpr uint32_t PROFILE_SIGNATURE = ((uint32_t)'E' << 24) | ((uint32_t)'a' << 16) | ((uint32_t)'s' << 8) | (uint32_t)'y';
+constexpr uint32_t PROFILE_VERSION = (2u << 24) | (1u << 16) | 0u; // 2.1.0, the version of the headers in thirdparty/easy_profiler/include.
+constexpr const char* PROFILE_VERSION_NAME = "v2.1.0";
+
+#pragma pack(push, 1)
+struct ProfileHeader
+{
+	uint32_t signature = PROFILE_SIGNATURE;
+	uint32_t version = PROFILE_VERSION;
+	uint64_t pid = 0;
+	int64_t cpuFrequency = 0; // Ticks per second of the timestamps, 0 if they're nanoseconds already.
+	uint64_t beginTime = 0;
+	uint64_t endTime = 0;
+	uint32_t blocksCount = 0; // Blocks, events, values and context switches of every thread.
+	uint64_t blocksMemory = 0; // Bytes they take, size prefixes excluded.
+	uint32_t descriptorsCount = 0;
+	uint64_t descriptorsMemory = 0; // Same, for the descriptors.
+	uint16_t bookmarksCount = 0;
+	uint16_t padding = 0;
+};
+#pragma pack(pop)
+
+constexpr size_t BLOCK_RECORD_SIZE = sizeof(profiler::BaseBlockData); // Begin, end and descriptor id, followed by the run-time name and its '\0'.
+constexpr size_t VALUE_RECORD_SIZE = sizeof(profiler::ArbitraryValue); // Followed by the value's bytes.
+constexpr size_t DESCRIPTOR_RECORD_SIZE = sizeof(profiler::BaseBlockDescriptor) + sizeof(uint16_t); // Followed by the name and the file name, both with their '\0'.
+
+template<typename T>
+inline void WritePod(std::ostream& out, const T& value)
+{
+	out.write(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+template<typename T>
+inline bool ReadPod(std::istream& in, T& value)
+{
+	return (bool)in.read(reinterpret_cast<char*>(&value), sizeof(T));
+}
+
+// Writes a record with its size prefix.
+inline void WriteRecord(std::ostream& out, const char* data, const uint16_t size)
+{
+	WritePod(out, size);
+	out.write(data, size);
+}
+
+// Appends a descriptor record, size prefix included.
+inline void AppendDescriptor(std::string& out, const profiler::BaseBlockDescriptor& descriptor, const std::string& name, const std::string& file)
+{
+	const uint16_t nameLength = (uint16_t)(name.size() + 1);
+	const uint16_t size = (uint16_t)(DESCRIPTOR_RECORD_SIZE + nameLength + file.size() + 1);
+	const size_t at = out.size();
+	out.resize(at + sizeof(size) + size);
+	char* p = &out[at];
+	const auto put = [&p](const auto& value)
+	{
+		std::memcpy(p, &value, sizeof(value));
+		p += sizeof(value);
+	};
+	put(size);
+	put(descriptor.id());
+	put(descriptor.line());
+	put(descriptor.color());
+	put(descriptor.type());
+	put(descriptor.status());
+	put(nameLength);
+	std::memcpy(p, name.c_str(), nameLength);
+	p += nameLength;
+	std::memcpy(p, file.c_str(), file.size() + 1);
+}
@@ -0,0 +1,13 @@
+#pragma once
+
+#include <cstdint>
+
+/*
+	Listening on a chosen interface, an addition of the in-tree backend to easy_profiler's API.
+	Anyone who can connect to the listener can take captures, and with them the program's block names and values, so profiler::startListen() only binds the loopback interface,
+	unlike easy_profiler's own library that binds every interface. Listening on another one, or on all of them with "0.0.0.0", is asked for explicitly here.
+	Programs linked against the backend get PI_LISTEN_ADDRESS defined.
+*/
+
+// False if the address isn't a dotted IPv4 address or the port can't be bound. Does nothing but return whether it listens if the program already does.
+bool StartListening(const char* address, uint16_t port);
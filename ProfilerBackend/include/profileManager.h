@@ -0,0 +1,251 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include <easy/profiler.h>
+#include <easy/arbitrary_value.h>
+
+#include "profileFormat.h"
+#include "profileStreaming.h"
+
+/*
+	In-tree implementation of easy_profiler's API, for the platforms the repository doesn't ship a pre-compiled easy_profiler for.
+	The EASY_* macros of thirdparty/easy_profiler/include expand to calls into this backend unchanged.
+	Every thread appends its finished blocks to a ring of its own without taking any lock, dumpBlocksToFile() drains the rings into a .prof file (see profileFormat.h).
+	Timestamps are raw TSC reads when the cpu has an invariant TSC, CLOCK_MONOTONIC nanoseconds otherwise.
+*/
+
+// Chunk of a thread's record ring.
+struct RecordChunk
+{
+	static constexpr uint32_t CAPACITY = 16 * 1024 - 128; // Biggest record is a block with a MAX_BLOCK_DATA_SIZE name, well below.
+
+	std::atomic<uint32_t> used{ 0 }; // Bytes published by the owning thread.
+	std::atomic<RecordChunk*> next{ nullptr }; // Set by the owning thread once the chunk is full, the chunk doesn't grow anymore after that.
+	RecordChunk* nextFree = nullptr; // Link in the ring's free list.
+	alignas(64) char data[CAPACITY]; // Records, each one a uint16_t size followed by the serialized block.
+};
+
+/*
+	Single producer single consumer ring of variable size records, made of chunks that go back to a free list once drained.
+	The owning thread appends records without ever blocking, a single drainer at a time reads whatever got published.
+	Memory grows by one chunk whenever the drainer falls behind and is reused afterwards.
+	Under a chunk cap, see SetChunkCap(), drained chunks are freed rather than kept and a ring that can't get a new chunk drops records.
+*/
+class RecordRing
+{
+public:
+	RecordRing() : head_(NewChunk()), tail_(head_) {}
+	~RecordRing();
+
+	RecordRing(const RecordRing&) = delete;
+	RecordRing& operator=(const RecordRing&) = delete;
+
+	// Caps the chunks of every ring together, 0 for no cap. Every ring keeps its current chunk whatever the cap.
+	static void SetChunkCap(size_t chunks);
+	static size_t ChunksInUse();
+
+	// Owning thread only. Returns where to write a record of the given size, Commit() publishes it. nullptr if the chunk cap is reached, the record is to be dropped.
+	char* Reserve(const uint16_t size)
+	{
+		if (reserved_ + sizeof(uint16_t) + size > RecordChunk::CAPACITY)
+		{
+			RecordChunk* fresh = TakeFreeChunk();
+			if (!fresh) return nullptr;
+			tail_->next.store(fresh, std::memory_order_release);
+			tail_ = fresh;
+			reserved_ = 0;
+		}
+		char* record = tail_->data + reserved_;
+		std::memcpy(record, &size, sizeof(size));
+		return record + sizeof(size);
+	}
+
+	void Commit(const uint16_t size)
+	{
+		reserved_ += (uint32_t)(sizeof(uint16_t) + size);
+		tail_->used.store(reserved_, std::memory_order_release);
+	}
+
+	// Drainer only. Calls visit(const char* record, uint16_t size) on every record published since the last drain, returns how many there were.
+	template<typename Visit>
+	size_t Drain(Visit&& visit)
+	{
+		size_t count = 0;
+		for (;;)
+		{
+			RecordChunk* next = head_->next.load(std::memory_order_acquire); // Loaded before used: once the owner has moved on, used is final.
+			const uint32_t used = head_->used.load(std::memory_order_acquire);
+			while (consumed_ < used)
+			{
+				uint16_t size = 0;
+				std::memcpy(&size, head_->data + consumed_, sizeof(size));
+				visit((const char*)head_->data + consumed_ + sizeof(size), size);
+				consumed_ += (uint32_t)(sizeof(size) + size);
+				count++;
+			}
+			if (!next) return count;
+			RecordChunk* drained = head_;
+			head_ = next;
+			consumed_ = 0;
+			Recycle(drained);
+		}
+	}
+
+private:
+	static RecordChunk* NewChunk();
+	RecordChunk* TakeFreeChunk();
+	void Recycle(RecordChunk* chunk);
+
+	RecordChunk* head_; // Drainer side.
+	uint32_t consumed_ = 0;
+	RecordChunk* tail_; // Owner side.
+	uint32_t reserved_ = 0;
+	std::atomic<RecordChunk*> free_{ nullptr }; // Pushed by the drainer, popped by the owner only, which rules out ABA.
+};
+
+// Descriptor of an EASY_BLOCK, EASY_EVENT or EASY_VALUE call site.
+class BlockDescriptor : public profiler::BaseBlockDescriptor
+{
+public:
+	BlockDescriptor(const profiler::block_id_t id, const profiler::EasyBlockStatus status, const char* name, const char* file, const int line, const profiler::block_type_t type, const profiler::color_t color)
+		: BaseBlockDescriptor(id, status, line, type, color), name(name), file(file) {}
+
+	const std::string name;
+	const std::string file;
+};
+
+class SwitchTracer; // See profileSwitches.h.
+
+// Everything the backend keeps about a thread. Outlives the thread until its blocks have been dumped.
+struct ThreadStorage
+{
+	explicit ThreadStorage(const profiler::thread_id_t id) : id(id) {}
+	~ThreadStorage();
+
+	// Owning thread only.
+	void StoreBlock(const profiler::Block& block);
+	void StoreValue(const profiler::BaseBlockDescriptor* desc, profiler::DataType type, const void* data, uint16_t size, bool isArray, const profiler::ValueId& vin);
+	void EndFrame(profiler::timestamp_t duration);
+	void TraceSwitches(); // Collects the thread's context switches while event tracing is enabled.
+
+	const profiler::thread_id_t id;
+	std::string name; // Guarded by the manager's mutex.
+	RecordRing blocks;
+	std::vector<profiler::Block*> openBlocks; // Scoped and non-scoped, in the order they began.
+	std::deque<profiler::Block> nonscopedBlocks; // Owned here since no scope owns them.
+	std::atomic<bool> expired{ false }; // The thread has exited.
+	std::atomic<uint64_t> dropped{ 0 }; // Records that didn't fit under the chunk cap, since the last drain.
+	std::atomic<SwitchTracer*> switches{ nullptr }; // Owned, set by the owning thread the first time it traces its context switches.
+	bool switchesOpened = false; // Owning thread only, whether opening the tracer was attempted.
+
+	// Top-level blocks are the thread's frames.
+	std::atomic<profiler::timestamp_t> lastFrame{ 0 };
+	std::atomic<profiler::timestamp_t> frameMax{ 0 }; // Since the last query of the local max.
+	std::atomic<profiler::timestamp_t> frameSum{ 0 }; // Since the last query of the local average.
+	std::atomic<uint32_t> frameCount{ 0 };
+};
+
+class ProfileManager
+{
+public:
+	static ProfileManager& Instance();
+	~ProfileManager(); // Stops the listener and finalizes the stream left running, if any.
+
+	profiler::timestamp_t Now() const;
+	int64_t TicksPerSecond() const; // 0 when timestamps are nanoseconds already.
+	profiler::timestamp_t ToNanoseconds(profiler::timestamp_t ticks) const;
+
+	const profiler::BaseBlockDescriptor* RegisterDescription(profiler::EasyBlockStatus status, const char* autogenUniqueId, const char* name, const char* file, int line, profiler::block_type_t type, profiler::color_t color, bool copyName);
+	void BeginBlock(profiler::Block& block);
+	void BeginNonScopedBlock(const profiler::BaseBlockDescriptor* desc, const char* runtimeName);
+	void EndBlock();
+	void StoreBlock(const profiler::BaseBlockDescriptor* desc, const char* runtimeName, profiler::timestamp_t begin, profiler::timestamp_t end);
+	void StoreValue(const profiler::BaseBlockDescriptor* desc, profiler::DataType type, const void* data, uint16_t size, bool isArray, const profiler::ValueId& vin);
+
+	void SetEnabled(const bool enabled) { enabled_.store(enabled, std::memory_order_relaxed); }
+	bool IsEnabled() const { return enabled_.load(std::memory_order_relaxed); }
+	uint32_t DumpBlocksToFile(const char* filename);
+	uint32_t DumpBlocksToStream(std::ostream& out);
+	void DiscardBlocks(); // Drops what the threads recorded so far, a capture started over the network starts from scratch.
+	void SetBlockStatus(profiler::block_id_t id, profiler::EasyBlockStatus status);
+
+	// Network listener of easy_profiler's protocol (easy_net.h), one client at a time, bound to an IPv4 address in host byte order.
+	void StartListen(uint32_t address, uint16_t port);
+	void StopListen();
+	bool IsListening() const { return listening_.load(std::memory_order_acquire); }
+
+	// See profileStreaming.h.
+	bool StartStreaming(const char* filename, size_t memoryCap, std::chrono::milliseconds interval);
+	uint32_t StopStreaming(StreamingCaptureStats* stats);
+
+	const char* RegisterThread(const char* name, profiler::ThreadGuard* guard);
+	void ExpireThread(profiler::thread_id_t id); // From the thread itself.
+	ThreadStorage& ThisThread();
+	ThreadStorage* FindThread(profiler::thread_id_t id); // Of a thread that's still running, nullptr if there's none.
+
+	// Context switch tracing, through perf_event_open rather than ETW (see profileSwitches.h). The priority and the log only matter to ETW, they're kept for the API's sake.
+	std::atomic<bool> eventTracing{ false };
+	std::atomic<bool> lowPriorityEventTracing{ true };
+	void SetContextSwitchLog(const char* filename);
+	const char* ContextSwitchLog();
+
+private:
+	// A capture being streamed to disk. Records go to a spool file as thread segments, the header and the descriptors can only be written once it's over.
+	struct Stream
+	{
+		std::string filename;
+		std::string spoolName;
+		std::ofstream spool;
+		ProfileHeader header; // Counts and time range of the records spooled so far.
+		StreamingCaptureStats stats;
+		std::chrono::milliseconds interval{ 0 };
+		std::thread flusher;
+		std::mutex wakeMutex;
+		std::condition_variable wake;
+		bool stop = false; // Guarded by wakeMutex.
+	};
+
+	ProfileManager();
+	uint32_t Dump(const std::function<std::ostream*()>& open); // Calls open() only once there are blocks to write.
+	void Listen(int server); // Listener thread, serves clients until stopListening_.
+	void Serve(int client);
+	void Flush(Stream& stream); // With dumpMutex_ held.
+	uint32_t DrainSwitches(ThreadStorage& thread, std::string& out, int64_t ticksPerSecond); // Appends size prefixed cswitch records, with dumpMutex_ held.
+	profiler::timestamp_t FromMonotonicNs(uint64_t ns, int64_t ticksPerSecond) const; // Context switches are timed by the kernel.
+	void AppendDescriptors(std::string& out, ProfileHeader& header); // With mutex_ held.
+	void ForgetThreads(const std::vector<ThreadStorage*>& finished); // Exited threads that were drained for the last time.
+
+	std::mutex mutex_; // Guards the descriptors, the list of threads, their names and the context switch log name.
+	std::string contextSwitchLog_;
+
+	bool useTsc_ = false;
+	profiler::timestamp_t calibrationTicks_ = 0; // A TSC read and a CLOCK_MONOTONIC read taken together, the frequency is measured against them.
+	uint64_t calibrationNs_ = 0;
+	std::atomic<bool> enabled_{ false };
+	std::vector<std::unique_ptr<BlockDescriptor>> descriptors_; // Indexed by block_id_t.
+	std::unordered_map<std::string, BlockDescriptor*> descriptorsBySite_;
+	std::vector<std::unique_ptr<ThreadStorage>> threads_;
+	std::mutex dumpMutex_; // Rings have a single drainer.
+	std::mutex streamMutex_; // Starting and stopping a stream.
+	std::unique_ptr<Stream> stream_; // Set while streaming, guarded by dumpMutex_.
+	std::mutex listenMutex_; // Starting and stopping the listener.
+	std::thread listener_;
+	std::atomic<bool> listening_{ false };
+	std::atomic<bool> stopListening_{ false };
+};
+
+profiler::thread_id_t CurrentThreadId();
@@ -0,0 +1,265 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <istream>
+#include <string>
+#include <vector>
+
+#include <easy/profiler.h>
+#include <easy/serialized_block.h>
+#include <easy/reader.h>
+
+#include "profileFormat.h"
+
+/*
+	Streaming reader of the .prof files described in profileFormat.h.
+	Only the descriptors are kept in memory, threads and their records are read one at a time so that captures of any size can be walked in bounded memory.
+	Timestamps are converted to nanoseconds as they're read, like easy_profiler's own reader does.
+	Header only and independent of the backend, tools can use it on every platform. fillTreesFromStream() of reader.h is built on it.
+*/
+
+// Thread the reader is in, see ProfileReader::NextThread().
+struct ProfileThread
+{
+	profiler::thread_id_t id = 0;
+	std::string name;
+};
+
+// Record the reader is at, see ProfileReader::NextRecord(). Points into the reader's buffer, valid until the next call.
+struct ProfileRecord
+{
+	const char* data = nullptr;
+	uint16_t size = 0;
+	const profiler::SerializedBlockDescriptor* descriptor = nullptr; // nullptr if the record's descriptor id is out of range.
+
+	profiler::BlockType Type() const { return descriptor ? descriptor->type() : profiler::BlockType::Block; }
+	const profiler::SerializedBlock& Block() const { return *reinterpret_cast<const profiler::SerializedBlock*>(data); } // Values start the same way, begin(), end() and id() hold for them too.
+	const profiler::ArbitraryValue& Value() const { return *reinterpret_cast<const profiler::ArbitraryValue*>(data); }
+	const char* Name() const { return Type() != profiler::BlockType::Value && Block().name()[0] ? Block().name() : (descriptor ? descriptor->name() : ""); } // Run-time name if there's one.
+};
+
+class ProfileReader
+{
+public:
+	explicit ProfileReader(std::istream& in) : in_(in) {}
+
+	// Reads the header and the descriptors. False if the stream isn't a capture this reader understands, Error() says why.
+	bool Open()
+	{
+		if (!ReadPod(in_, header_) || header_.signature != PROFILE_SIGNATURE) return Fail("not an easy_profiler capture");
+		if ((header_.version >> 24) != (PROFILE_VERSION >> 24)) return Fail("unsupported capture version " + std::to_string(header_.version >> 24) + "." + std::to_string((header_.version >> 16) & 0xff));
+
+		// Counts and ids come from the file, damaged ones mustn't make the reader allocate gigabytes. Unseekable streams get no reservation, reading runs out first.
+		const uint64_t left = RemainingBytes();
+		if (left != UINT64_MAX && header_.descriptorsCount > left / (sizeof(uint16_t) + DESCRIPTOR_RECORD_SIZE)) return Fail("more descriptors than the capture can hold");
+		if (left != UINT64_MAX && header_.blocksMemory > left) return Fail("more records than the capture can hold"); // Readers reserve that much upfront.
+		if (left != UINT64_MAX) offsets_.reserve(header_.descriptorsCount);
+		for (uint32_t i = 0; i < header_.descriptorsCount; i++)
+		{
+			uint16_t size = 0;
+			if (!ReadPod(in_, size) || size < DESCRIPTOR_RECORD_SIZE) return Fail("truncated descriptors");
+			const size_t at = descriptorsData_.size();
+			descriptorsData_.resize(at + size);
+			if (!in_.read(&descriptorsData_[at], size)) return Fail("truncated descriptors");
+			offsets_.push_back(at);
+		}
+		descriptors_.clear();
+		for (const size_t at : offsets_)
+		{
+			const profiler::SerializedBlockDescriptor* descriptor = reinterpret_cast<const profiler::SerializedBlockDescriptor*>(descriptorsData_.data() + at);
+			if (descriptor->id() >= header_.descriptorsCount) return Fail("descriptor id " + std::to_string(descriptor->id()) + " out of range"); // Ids are dense, 0 to the count.
+			if (descriptor->id() >= descriptors_.size()) descriptors_.resize(descriptor->id() + 1, nullptr);
+			descriptors_[descriptor->id()] = const_cast<profiler::SerializedBlockDescriptor*>(descriptor);
+		}
+
+		header_.beginTime = ToNanoseconds(header_.beginTime);
+		header_.endTime = ToNanoseconds(header_.endTime);
+		return true;
+	}
+
+	// Timestamps in nanoseconds, counts and sizes as written.
+	const ProfileHeader& Header() const { return header_; }
+	int64_t CpuFrequency() const { return header_.cpuFrequency; }
+
+	// Indexed by block id, entries of ids that weren't written are nullptr.
+	const profiler::descriptors_list_t& Descriptors() const { return descriptors_; }
+	const profiler::SerializedBlockDescriptor* Descriptor(const profiler::block_id_t id) const { return id < descriptors_.size() ? descriptors_[id] : nullptr; }
+	const std::string& DescriptorsData() const { return descriptorsData_; } // The descriptor records back to back, without their size prefix.
+
+	// Moves on to the next thread, skipping what's left of the current one. False once the threads are over.
+	bool NextThread(ProfileThread& thread)
+	{
+		if (threadsOver_ || !SkipThread()) return false;
+
+		uint32_t low = 0;
+		if (!ReadPod(in_, low)) return Stop("truncated thread");
+		if (low == PROFILE_SIGNATURE) // Can't be the low half of a thread id, they stay well below 2^30.
+		{
+			threadsOver_ = true;
+			return false;
+		}
+		uint32_t high = 0;
+		uint16_t nameSize = 0;
+		if (!ReadPod(in_, high) || !ReadPod(in_, nameSize)) return Stop("truncated thread");
+		thread.id = ((uint64_t)high << 32) | low;
+		thread.name.assign(nameSize, '\0');
+		if (nameSize && !in_.read(&thread.name[0], nameSize)) return Stop("truncated thread");
+		thread.name.resize(std::strlen(thread.name.c_str()));
+		if (!ReadPod(in_, cswitchesLeft_)) return Stop("truncated thread");
+		recordsLeft_ = 0;
+		recordsCountPending_ = true;
+		return cswitchesLeft_ > 0 || ReadRecordsCount();
+	}
+
+	// Context switches of the current thread, they come before its records. False once there are none left.
+	bool NextCSwitch(const profiler::SerializedCSwitch*& cswitch)
+	{
+		if (cswitchesLeft_ == 0) return false;
+		if (!ReadRecord()) return false;
+		cswitchesLeft_--;
+		if (lastSize_ < sizeof(profiler::SerializedCSwitch)) return Fail("context switch too small");
+		ConvertTimes(buffer_.data());
+		cswitch = reinterpret_cast<const profiler::SerializedCSwitch*>(buffer_.data());
+		if (cswitchesLeft_ == 0 && !ReadRecordsCount()) return false;
+		return true;
+	}
+
+	// Blocks, events and values of the current thread in the order they ended, children before their parent. False once there are none left.
+	bool NextRecord(ProfileRecord& record)
+	{
+		const profiler::SerializedCSwitch* cswitch = nullptr;
+		while (cswitchesLeft_ > 0) if (!NextCSwitch(cswitch)) return false;
+		if (recordsLeft_ == 0) return false;
+		if (!ReadRecord()) return false;
+		recordsLeft_--;
+		if (lastSize_ < sizeof(profiler::BaseBlockData)) return Fail("record too small");
+		ConvertTimes(buffer_.data());
+		record.data = buffer_.data();
+		record.size = lastSize_;
+		record.descriptor = Descriptor(record.Block().id());
+		return true;
+	}
+
+	// Bookmarks that follow the threads, once NextThread() returned false.
+	bool ReadBookmarks(profiler::bookmarks_t& bookmarks)
+	{
+		if (!threadsOver_ || failed_ || truncated_) return false;
+		for (uint16_t i = 0; i < header_.bookmarksCount; i++)
+		{
+			if (!ReadRecord()) return false;
+			if (lastSize_ < profiler::Bookmark::BaseSize) return Fail("bookmark too small");
+			profiler::Bookmark bookmark;
+			std::memcpy(&bookmark.pos, buffer_.data(), sizeof(bookmark.pos));
+			std::memcpy(&bookmark.color, buffer_.data() + sizeof(bookmark.pos), sizeof(bookmark.color));
+			bookmark.pos = ToNanoseconds(bookmark.pos);
+			bookmark.text.assign(buffer_.data() + sizeof(bookmark.pos) + sizeof(bookmark.color), lastSize_ - sizeof(bookmark.pos) - sizeof(bookmark.color));
+			bookmark.text.resize(std::strlen(bookmark.text.c_str()));
+			bookmarks.push_back(std::move(bookmark));
+		}
+		return true;
+	}
+
+	// Whether the threads ended with their signature rather than with the end of the stream.
+	bool Complete() const { return threadsOver_ && !truncated_; }
+	bool Failed() const { return failed_; }
+	const std::string& Error() const { return error_; }
+
+	profiler::timestamp_t ToNanoseconds(const profiler::timestamp_t ticks) const
+	{
+		const uint64_t frequency = (uint64_t)header_.cpuFrequency;
+		if (frequency == 0) return ticks;
+		return ticks / frequency * 1000000000ull + ticks % frequency * 1000000000ull / frequency; // Split so that neither product overflows.
+	}
+
+private:
+	bool Fail(const std::string& what)
+	{
+		failed_ = true;
+		threadsOver_ = true;
+		error_ = what;
+		return false;
+	}
+
+	// Captures cut short, by a crash or a copy of one still being written, end in the middle of a thread. Everything read up to there is fine.
+	bool Stop(const std::string& what)
+	{
+		if (!in_.eof()) return Fail(what);
+		threadsOver_ = truncated_ = true;
+		cswitchesLeft_ = recordsLeft_ = 0;
+		recordsCountPending_ = false;
+		return false;
+	}
+
+	// Bytes between the read position and the end of the stream, UINT64_MAX if the stream can't tell.
+	uint64_t RemainingBytes()
+	{
+		const std::streampos at = in_.tellg();
+		if (at == std::streampos(-1) || !in_.seekg(0, std::ios::end))
+		{
+			in_.clear();
+			return UINT64_MAX;
+		}
+		const std::streampos end = in_.tellg();
+		in_.seekg(at);
+		return end == std::streampos(-1) || end < at ? UINT64_MAX : (uint64_t)(end - at);
+	}
+
+	bool ReadRecordsCount()
+	{
+		if (!recordsCountPending_) return true;
+		recordsCountPending_ = false;
+		return ReadPod(in_, recordsLeft_) || Stop("truncated thread");
+	}
+
+	bool SkipThread()
+	{
+		const profiler::SerializedCSwitch* cswitch = nullptr;
+		while (cswitchesLeft_ > 0) if (!NextCSwitch(cswitch)) return false;
+		if (recordsCountPending_ && !ReadRecordsCount()) return false;
+		while (recordsLeft_ > 0)
+		{
+			if (!ReadRecord()) return false;
+			recordsLeft_--;
+		}
+		return true;
+	}
+
+	bool ReadRecord()
+	{
+		if (!ReadPod(in_, lastSize_)) return Stop("truncated record");
+		if (buffer_.size() < (size_t)lastSize_ + 1) buffer_.resize((size_t)lastSize_ + 1);
+		if (!in_.read(buffer_.data(), lastSize_)) return Stop("truncated record");
+		buffer_[lastSize_] = '\0'; // Names are terminated even in damaged records.
+		return true;
+	}
+
+	// Begin and end are the first two timestamps of blocks, values and context switches alike.
+	void ConvertTimes(char* record) const
+	{
+		if (header_.cpuFrequency == 0) return;
+		for (size_t i = 0; i < 2; i++)
+		{
+			profiler::timestamp_t time = 0;
+			std::memcpy(&time, record + i * sizeof(time), sizeof(time));
+			time = ToNanoseconds(time);
+			std::memcpy(record + i * sizeof(time), &time, sizeof(time));
+		}
+	}
+
+	std::istream& in_;
+	ProfileHeader header_;
+	std::string descriptorsData_;
+	std::vector<size_t> offsets_;
+	profiler::descriptors_list_t descriptors_;
+
+	std::vector<char> buffer_; // The last record read, big enough for any record there can be.
+	uint16_t lastSize_ = 0;
+	uint32_t cswitchesLeft_ = 0;
+	uint32_t recordsLeft_ = 0;
+	bool recordsCountPending_ = false;
+	bool threadsOver_ = false;
+	bool truncated_ = false;
+	bool failed_ = false;
+	std::string error_;
+};
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+/*
+	Streaming capture, an addition of the in-tree backend to easy_profiler's API for runs too long to keep every block in memory until dumpBlocksToFile().
+	A background thread drains the threads' record rings to disk every flush interval, while the rings together are held under a hard memory cap:
+	a thread that would need more drops its records instead, and the drops are counted.
+	The capture is written as "<filename>.part" meanwhile and becomes a regular .prof file, readable like any other, once StopStreamingCapture() finalizes it.
+	Programs linked against the backend get PI_STREAMING_CAPTURE defined.
+*/
+
+struct StreamingCaptureStats
+{
+	uint32_t records = 0; // Written to the capture.
+	uint64_t bytes = 0; // Records only, without their size prefix.
+	uint64_t dropped = 0; // Records that didn't fit under the memory cap.
+	uint32_t flushes = 0;
+	size_t peakMemory = 0; // Most bytes the record rings held at a flush.
+};
+
+// False if a stream is already running or the spool file can't be created. A memory cap of 0 means none, every thread keeps one chunk of its ring whatever the cap.
+bool StartStreamingCapture(const char* filename, size_t memoryCap, uint32_t flushIntervalMs);
+
+// Flushes what's left, writes the capture and returns how many records it holds, 0 if there was no stream or nothing got recorded.
+uint32_t StopStreamingCapture(StreamingCaptureStats* stats = nullptr);
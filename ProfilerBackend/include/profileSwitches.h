@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cstdint>
+
+#include "profileManager.h"
+
+/*
+	Context switches of the threads, what easy_profiler records through ETW on Windows while event tracing is enabled (EASY_SET_EVENT_TRACING_ENABLED).
+	Every thread opens a perf_event_open stream of its own switches (PERF_RECORD_SWITCH, allowed with the default perf_event_paranoid of 2)
+	and moves them from the kernel's buffer to a ring of cswitch records whenever it stores a block or a value, without ever blocking.
+	A cswitch spans the time its thread was switched out and is named after why: "Preempted" when the scheduler took the cpu away, "Waiting" when the thread blocked, slept or yielded.
+	Its timestamps stay CLOCK_MONOTONIC nanoseconds until the drainer converts them to the capture's clock.
+*/
+class SwitchTracer
+{
+public:
+	static SwitchTracer* Open(); // Of the calling thread, nullptr if perf_event_open refuses.
+	~SwitchTracer();
+
+	SwitchTracer(const SwitchTracer&) = delete;
+	SwitchTracer& operator=(const SwitchTracer&) = delete;
+
+	// Owning thread only. Turns the switches since the last poll into records, or drops them if keep is false.
+	void Poll(bool keep);
+
+	RecordRing records; // Serialized CSwitch records: begin, end, thread id switched to (unknown, 0), reason.
+
+private:
+	SwitchTracer(int fd, char* mapping) : fd_(fd), mapping_(mapping) {}
+	void Store(uint64_t begin, uint64_t end, const char* reason);
+
+	const int fd_;
+	char* const mapping_; // The kernel's metadata page followed by its buffer.
+	uint64_t switchedOut_ = 0; // When the thread was last switched out, 0 once it's back in.
+	bool preempted_ = false;
+};
@@ -0,0 +1,169 @@
+#include <cerrno>
+#include <cstring>
+
+#include <arpa/inet.h>
+#include <sys/time.h>
+
+#include <easy/easy_socket.h>
+
+/*
+	easy_socket.h's EasySocket over POSIX sockets, what easy_profiler's clients connect to listeners with.
+	Sends and receives go through the reply socket: the accepted connection of a server, the socket itself once a client is connected.
+*/
+
+EasySocket::EasySocket()
+{
+	init();
+}
+
+EasySocket::~EasySocket()
+{
+	if (checkSocket(m_replySocket) && m_replySocket != m_socket) ::close(m_replySocket);
+	if (checkSocket(m_socket)) ::close(m_socket);
+}
+
+void EasySocket::init()
+{
+	m_socket = ::socket(AF_INET, SOCK_STREAM, 0);
+	m_replySocket = -1;
+	if (!checkSocket(m_socket)) return;
+	const int reuse = 1;
+	setsockopt(m_socket, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+	m_state = ConnectionState::Unknown;
+}
+
+void EasySocket::flush()
+{
+	if (checkSocket(m_replySocket) && m_replySocket != m_socket) ::close(m_replySocket);
+	if (checkSocket(m_socket)) ::close(m_socket);
+	init();
+}
+
+void EasySocket::setReceiveTimeout(const int milliseconds)
+{
+	timeval timeout{};
+	timeout.tv_sec = milliseconds / 1000;
+	timeout.tv_usec = (milliseconds % 1000) * 1000;
+	if (checkSocket(m_socket)) setsockopt(m_socket, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+	if (checkSocket(m_replySocket) && m_replySocket != m_socket) setsockopt(m_replySocket, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+}
+
+int EasySocket::send(const void* buf, const size_t nbyte)
+{
+	if (!checkSocket(m_replySocket)) return -1;
+	const int result = (int)::send(m_replySocket, buf, nbyte, MSG_NOSIGNAL);
+	checkResult(result);
+	return result;
+}
+
+int EasySocket::receive(void* buf, const size_t nbyte)
+{
+	if (!checkSocket(m_replySocket)) return -1;
+	const int result = (int)::recv(m_replySocket, buf, nbyte, 0);
+	if (result == 0) m_state = ConnectionState::Disconnected; // Orderly shutdown of the other end.
+	else checkResult(result);
+	return result;
+}
+
+int EasySocket::listen(const int count)
+{
+	if (!checkSocket(m_socket)) return -1;
+	const int result = ::listen(m_socket, count);
+	checkResult(result);
+	return result;
+}
+
+int EasySocket::accept()
+{
+	if (!checkSocket(m_socket)) return -1;
+	m_replySocket = ::accept(m_socket, nullptr, nullptr);
+	checkResult(m_replySocket);
+	return m_replySocket;
+}
+
+int EasySocket::bind(const uint16_t portno)
+{
+	if (!checkSocket(m_socket)) return -1;
+	sockaddr_in address{};
+	address.sin_family = AF_INET;
+	address.sin_port = htons(portno);
+	address.sin_addr.s_addr = htonl(INADDR_ANY);
+	const int result = ::bind(m_socket, reinterpret_cast<const sockaddr*>(&address), sizeof(address));
+	checkResult(result);
+	return result;
+}
+
+bool EasySocket::setAddress(const char* serv, const uint16_t port)
+{
+	addrinfo hints{};
+	hints.ai_family = AF_INET;
+	hints.ai_socktype = SOCK_STREAM;
+	addrinfo* found = nullptr;
+	if (getaddrinfo(serv, nullptr, &hints, &found) != 0 || !found) return false;
+	std::memset(&m_serverAddress, 0, sizeof(m_serverAddress));
+	std::memcpy(&m_serverAddress, found->ai_addr, sizeof(m_serverAddress));
+	m_serverAddress.sin_port = htons(port);
+	freeaddrinfo(found);
+	return true;
+}
+
+int EasySocket::connect()
+{
+	if (!checkSocket(m_socket)) init();
+	m_state = ConnectionState::Connecting;
+	const int result = ::connect(m_socket, reinterpret_cast<const sockaddr*>(&m_serverAddress), sizeof(m_serverAddress));
+	checkResult(result);
+	if (result == 0) m_replySocket = m_socket;
+	return result;
+}
+
+EasySocket::ConnectionState EasySocket::state() const
+{
+	return m_state;
+}
+
+bool EasySocket::isDisconnected() const
+{
+	return m_state == ConnectionState::Disconnected;
+}
+
+bool EasySocket::isConnected() const
+{
+	return m_state == ConnectionState::Connected;
+}
+
+void EasySocket::checkResult(const int result)
+{
+	if (result >= 0)
+	{
+		m_state = ConnectionState::Connected;
+		return;
+	}
+	switch (errno)
+	{
+	case EAGAIN: // A receive timeout, the connection is still there.
+	case EINTR:
+		break;
+	case ECONNABORTED:
+	case ECONNREFUSED:
+	case ECONNRESET:
+	case ENOTCONN:
+	case EPIPE:
+		m_state = ConnectionState::Disconnected;
+		break;
+	default:
+		m_state = ConnectionState::Unknown;
+		break;
+	}
+}
+
+bool EasySocket::checkSocket(const socket_t s) const
+{
+	return s >= 0;
+}
+
+void EasySocket::setBlocking(const socket_t s, const bool blocking)
+{
+	const int flags = fcntl(s, F_GETFL, 0);
+	if (flags >= 0) fcntl(s, F_SETFL, blocking ? (flags & ~O_NONBLOCK) : (flags | O_NONBLOCK));
+}
@@ -0,0 +1,211 @@
+#include "profileManager.h"
+#include "profileListen.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <sstream>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <easy/easy_net.h>
+
+/*
+	Network listener of easy_profiler's protocol: the easy_profiler GUI, or the CaptureClient tool, connects to a running program and starts and stops captures remotely.
+	profiler::startListen() binds the loopback interface only, StartListening() of profileListen.h another one. One client is served at a time, on a thread of its own. A stopped capture is sent as the bytes of a .prof file, the same the program would have written with dumpBlocksToFile().
+*/
+
+namespace
+{
+
+using profiler::net::MessageType;
+
+constexpr int POLL_MS = 100; // How long the listener takes at most to notice it's stopped.
+constexpr size_t MAX_DATA_SIZE = 64u << 20; // Bigger captures are sent as several data messages, their size is 32 bits.
+
+bool SendAll(const int socket, const void* data, size_t size)
+{
+	const char* at = static_cast<const char*>(data);
+	while (size > 0)
+	{
+		const ssize_t sent = ::send(socket, at, size, MSG_NOSIGNAL); // A client gone away is an error, not a SIGPIPE.
+		if (sent < 0 && errno == EINTR) continue;
+		if (sent <= 0) return false;
+		at += sent;
+		size -= (size_t)sent;
+	}
+	return true;
+}
+
+template<typename Message>
+bool SendMessage(const int socket, const Message& message)
+{
+	return SendAll(socket, &message, sizeof(message));
+}
+
+// Data messages of the given type carrying the data, then the message that ends them.
+bool SendData(const int socket, const std::string& data, const MessageType type, const MessageType end)
+{
+	for (size_t at = 0; at < data.size(); at += MAX_DATA_SIZE)
+	{
+		const size_t size = std::min(data.size() - at, MAX_DATA_SIZE);
+		if (!SendMessage(socket, profiler::net::DataMessage((uint32_t)size, type)) || !SendAll(socket, data.data() + at, size)) return false;
+	}
+	return SendMessage(socket, profiler::net::Message(end));
+}
+
+// Size of a message a client sends, known from its type.
+size_t RequestSize(const MessageType type)
+{
+	switch (type)
+	{
+	case MessageType::Change_Block_Status: return sizeof(profiler::net::BlockStatusMessage);
+	case MessageType::Change_Event_Tracing_Status:
+	case MessageType::Change_Event_Tracing_Priority: return sizeof(profiler::net::BoolMessage);
+	default: return sizeof(profiler::net::Message);
+	}
+}
+
+} // namespace
+
+void ProfileManager::StartListen(const uint32_t host, const uint16_t port)
+{
+	std::lock_guard<std::mutex> lock(listenMutex_);
+	if (listener_.joinable()) return;
+
+	const int server = ::socket(AF_INET, SOCK_STREAM, 0);
+	if (server < 0) return;
+	const int reuse = 1;
+	setsockopt(server, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse)); // Restarting the program doesn't wait for the last connection to time out.
+	sockaddr_in address{};
+	address.sin_family = AF_INET;
+	address.sin_port = htons(port);
+	address.sin_addr.s_addr = htonl(host);
+	if (::bind(server, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) < 0 || ::listen(server, 1) < 0)
+	{
+		close(server);
+		return; // IsListening() stays false.
+	}
+
+	stopListening_.store(false);
+	listening_.store(true, std::memory_order_release);
+	listener_ = std::thread(&ProfileManager::Listen, this, server);
+}
+
+void ProfileManager::StopListen()
+{
+	std::lock_guard<std::mutex> lock(listenMutex_);
+	if (!listener_.joinable()) return;
+	stopListening_.store(true);
+	listener_.join();
+	listening_.store(false, std::memory_order_release);
+}
+
+void ProfileManager::Listen(const int server)
+{
+	while (!stopListening_.load())
+	{
+		pollfd waiting{ server, POLLIN, 0 };
+		if (poll(&waiting, 1, POLL_MS) <= 0) continue;
+		const int client = ::accept(server, nullptr, nullptr);
+		if (client < 0) continue;
+		Serve(client);
+		close(client);
+	}
+	close(server);
+}
+
+void ProfileManager::Serve(const int client)
+{
+	using namespace profiler::net;
+	if (!SendMessage(client, EasyProfilerStatus(IsEnabled(), eventTracing.load(), lowPriorityEventTracing.load()))) return;
+
+	std::vector<char> pending; // Received bytes not making a whole message yet.
+	char buffer[4096];
+	while (!stopListening_.load())
+	{
+		pollfd readable{ client, POLLIN, 0 };
+		const int ready = poll(&readable, 1, POLL_MS);
+		if (ready < 0 && errno != EINTR) return;
+		if (ready <= 0) continue;
+		const ssize_t received = ::recv(client, buffer, sizeof(buffer), 0);
+		if (received < 0 && errno == EINTR) continue;
+		if (received <= 0) return; // Disconnected.
+		pending.insert(pending.end(), buffer, buffer + received);
+
+		size_t at = 0;
+		while (pending.size() - at >= sizeof(Message))
+		{
+			Message message;
+			std::memcpy(&message, pending.data() + at, sizeof(message));
+			if (!message.isEasyNetMessage()) return; // Not speaking the protocol, nothing to do with that client.
+			const size_t size = RequestSize(message.type);
+			if (pending.size() - at < size) break;
+			const char* payload = pending.data() + at + sizeof(Message);
+			at += size;
+
+			bool sent = true;
+			switch (message.type)
+			{
+			case MessageType::Request_Start_Capture:
+				DiscardBlocks();
+				SetEnabled(true);
+				sent = SendMessage(client, Message(MessageType::Reply_Capturing_Started));
+				break;
+			case MessageType::Request_Stop_Capture:
+			{
+				SetEnabled(false);
+				std::ostringstream capture;
+				DumpBlocksToStream(capture); // Nothing is written without blocks, the client gets only Reply_Blocks_End.
+				sent = SendData(client, capture.str(), MessageType::Reply_Blocks, MessageType::Reply_Blocks_End);
+				break;
+			}
+			case MessageType::Request_Blocks_Description:
+			{
+				// A capture without any thread: the header and the descriptors.
+				std::string descriptors;
+				ProfileHeader header;
+				{
+					std::lock_guard<std::mutex> lock(mutex_);
+					AppendDescriptors(descriptors, header);
+				}
+				header.pid = (uint64_t)getpid();
+				header.cpuFrequency = TicksPerSecond();
+				std::ostringstream out;
+				WritePod(out, header);
+				out.write(descriptors.data(), (std::streamsize)descriptors.size());
+				WritePod(out, PROFILE_SIGNATURE);
+				sent = SendData(client, out.str(), MessageType::Reply_Blocks_Description, MessageType::Reply_Blocks_Description_End);
+				break;
+			}
+			case MessageType::Change_Block_Status:
+			{
+				uint32_t id = 0;
+				std::memcpy(&id, payload, sizeof(id)); // The messages are packed.
+				SetBlockStatus(id, (profiler::EasyBlockStatus)payload[sizeof(id)]);
+				break;
+			}
+			case MessageType::Change_Event_Tracing_Status: eventTracing.store(payload[0] != 0); break;
+			case MessageType::Change_Event_Tracing_Priority: lowPriorityEventTracing.store(payload[0] != 0); break;
+			case MessageType::Request_MainThread_FPS:
+				sent = SendMessage(client, TimestampMessage(MessageType::Reply_MainThread_FPS, (uint32_t)profiler::main_thread_frameTimeLocalMax(profiler::MICROSECONDS),
+					(uint32_t)profiler::main_thread_frameTimeLocalAvg(profiler::MICROSECONDS)));
+				break;
+			default: break; // Ping and anything unknown need no reply.
+			}
+			if (!sent) return;
+		}
+		pending.erase(pending.begin(), pending.begin() + (std::ptrdiff_t)at);
+	}
+}
+
+bool StartListening(const char* address, const uint16_t port)
+{
+	in_addr parsed{};
+	if (!address || inet_pton(AF_INET, address, &parsed) != 1) return false;
+	ProfileManager::Instance().StartListen(ntohl(parsed.s_addr), port);
+	return ProfileManager::Instance().IsListening();
+}
@@ -0,0 +1,483 @@
+#include "profileManager.h"
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <new>
+#include <thread>
+
+#include <time.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#include "profileFormat.h"
+#include "profileSwitches.h"
+
+namespace
+{
+
+thread_local ThreadStorage* t_storage = nullptr;
+
+std::atomic<size_t> g_chunks{ 0 }; // Of every ring.
+std::atomic<size_t> g_chunkCap{ 0 };
+
+// Marks the thread's storage expired when the thread exits, so that the next dump can let go of it.
+struct ThreadExpiry
+{
+	~ThreadExpiry()
+	{
+		if (!t_storage) return;
+		t_storage->TraceSwitches(); // The last ones, nobody polls them anymore.
+		t_storage->expired.store(true, std::memory_order_release);
+		t_storage = nullptr;
+	}
+};
+
+uint64_t MonotonicNs()
+{
+	timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+// TSC ticks are only a clock if they tick at a constant rate whatever the cpu's frequency and keep ticking in deep sleep states.
+bool HasInvariantTsc()
+{
+#if defined(__x86_64__) || defined(__i386__)
+	std::ifstream cpuinfo("/proc/cpuinfo");
+	std::string line;
+	while (std::getline(cpuinfo, line))
+	{
+		if (line.compare(0, 5, "flags") != 0) continue;
+		return line.find(" constant_tsc") != std::string::npos && line.find(" nonstop_tsc") != std::string::npos;
+	}
+#endif
+	return false;
+}
+
+} // namespace
+
+profiler::thread_id_t CurrentThreadId()
+{
+	return (profiler::thread_id_t)syscall(SYS_gettid);
+}
+
+//////////////////////////////////////////////////////////////////////////
+// RecordRing
+
+RecordRing::~RecordRing()
+{
+	size_t count = 0;
+	for (RecordChunk* chunk = head_; chunk; count++)
+	{
+		RecordChunk* next = chunk->next.load(std::memory_order_relaxed);
+		delete chunk;
+		chunk = next;
+	}
+	for (RecordChunk* chunk = free_.load(std::memory_order_relaxed); chunk; count++)
+	{
+		RecordChunk* next = chunk->nextFree;
+		delete chunk;
+		chunk = next;
+	}
+	g_chunks.fetch_sub(count, std::memory_order_relaxed);
+}
+
+void RecordRing::SetChunkCap(const size_t chunks) { g_chunkCap.store(chunks, std::memory_order_relaxed); }
+size_t RecordRing::ChunksInUse() { return g_chunks.load(std::memory_order_relaxed); }
+
+RecordChunk* RecordRing::NewChunk()
+{
+	g_chunks.fetch_add(1, std::memory_order_relaxed);
+	return new RecordChunk;
+}
+
+RecordChunk* RecordRing::TakeFreeChunk()
+{
+	RecordChunk* chunk = free_.load(std::memory_order_acquire);
+	while (chunk && !free_.compare_exchange_weak(chunk, chunk->nextFree, std::memory_order_acquire, std::memory_order_acquire)) {}
+	if (!chunk)
+	{
+		const size_t cap = g_chunkCap.load(std::memory_order_relaxed);
+		if (g_chunks.fetch_add(1, std::memory_order_relaxed) >= cap && cap)
+		{
+			g_chunks.fetch_sub(1, std::memory_order_relaxed);
+			return nullptr;
+		}
+		return new RecordChunk;
+	}
+	chunk->used.store(0, std::memory_order_relaxed); // Published along with the chunk by the release store of the previous chunk's next.
+	chunk->next.store(nullptr, std::memory_order_relaxed);
+	return chunk;
+}
+
+void RecordRing::Recycle(RecordChunk* chunk)
+{
+	if (g_chunkCap.load(std::memory_order_relaxed)) // Back to the budget of every ring, kept by this one it could starve the others.
+	{
+		delete chunk;
+		g_chunks.fetch_sub(1, std::memory_order_relaxed);
+		return;
+	}
+	chunk->nextFree = free_.load(std::memory_order_relaxed);
+	while (!free_.compare_exchange_weak(chunk->nextFree, chunk, std::memory_order_release, std::memory_order_relaxed)) {}
+}
+
+//////////////////////////////////////////////////////////////////////////
+// ThreadStorage
+
+ThreadStorage::~ThreadStorage()
+{
+	delete switches.load(std::memory_order_acquire);
+}
+
+void ThreadStorage::StoreBlock(const profiler::Block& block)
+{
+	TraceSwitches();
+	const char* name = block.name() ? block.name() : "";
+	const uint16_t nameLength = (uint16_t)strnlen(name, profiler::MAX_BLOCK_DATA_SIZE - 1);
+	const uint16_t size = (uint16_t)(BLOCK_RECORD_SIZE + nameLength + 1);
+	char* record = blocks.Reserve(size);
+	if (!record)
+	{
+		dropped.fetch_add(1, std::memory_order_relaxed);
+		return;
+	}
+	new (record) profiler::SerializedBlock(block, nameLength);
+	blocks.Commit(size);
+}
+
+void ThreadStorage::StoreValue(const profiler::BaseBlockDescriptor* desc, const profiler::DataType type, const void* data, uint16_t size, const bool isArray, const profiler::ValueId& vin)
+{
+	TraceSwitches();
+	size = std::min(size, profiler::MAX_BLOCK_DATA_SIZE);
+	const uint16_t recordSize = (uint16_t)(VALUE_RECORD_SIZE + size);
+	char* record = blocks.Reserve(recordSize);
+	if (!record)
+	{
+		dropped.fetch_add(1, std::memory_order_relaxed);
+		return;
+	}
+	new (record) profiler::ArbitraryValue(ProfileManager::Instance().Now(), (profiler::vin_t)(uintptr_t)vin.m_id, desc->id(), size, type, isArray);
+	std::memcpy(record + VALUE_RECORD_SIZE, data, size);
+	blocks.Commit(recordSize);
+}
+
+void ThreadStorage::EndFrame(const profiler::timestamp_t duration)
+{
+	lastFrame.store(duration, std::memory_order_relaxed);
+	if (duration > frameMax.load(std::memory_order_relaxed)) frameMax.store(duration, std::memory_order_relaxed);
+	frameSum.fetch_add(duration, std::memory_order_relaxed);
+	frameCount.fetch_add(1, std::memory_order_relaxed);
+}
+
+//////////////////////////////////////////////////////////////////////////
+// ProfileManager
+
+ProfileManager& ProfileManager::Instance()
+{
+	static ProfileManager instance;
+	return instance;
+}
+
+ProfileManager::ProfileManager()
+	: useTsc_(HasInvariantTsc())
+{
+	calibrationNs_ = MonotonicNs();
+	calibrationTicks_ = Now();
+}
+
+ProfileManager::~ProfileManager()
+{
+	StopListen();
+	StopStreaming(nullptr);
+}
+
+profiler::timestamp_t ProfileManager::Now() const
+{
+#if defined(__x86_64__) || defined(__i386__)
+	if (useTsc_) return __rdtsc();
+#endif
+	return MonotonicNs();
+}
+
+int64_t ProfileManager::TicksPerSecond() const
+{
+	if (!useTsc_) return 0;
+	// Ticks elapsed over nanoseconds elapsed since the manager got created, the longer the process has run the more precise.
+	uint64_t ns = MonotonicNs();
+	profiler::timestamp_t ticks = Now();
+	while (ns - calibrationNs_ < 10000000ull) // Less than 10 ms are too few for the time the two reads take to vanish.
+	{
+		std::this_thread::yield();
+		ns = MonotonicNs();
+		ticks = Now();
+	}
+	return (int64_t)((double)(ticks - calibrationTicks_) * 1e9 / (double)(ns - calibrationNs_));
+}
+
+profiler::timestamp_t ProfileManager::FromMonotonicNs(const uint64_t ns, const int64_t ticksPerSecond) const
+{
+	if (!useTsc_) return ns;
+	return calibrationTicks_ + (profiler::timestamp_t)((double)((int64_t)ns - (int64_t)calibrationNs_) * (double)ticksPerSecond / 1e9);
+}
+
+profiler::timestamp_t ProfileManager::ToNanoseconds(const profiler::timestamp_t ticks) const
+{
+	if (!useTsc_) return ticks;
+	return (profiler::timestamp_t)((double)ticks * 1e9 / (double)TicksPerSecond());
+}
+
+const profiler::BaseBlockDescriptor* ProfileManager::RegisterDescription(const profiler::EasyBlockStatus status, const char* autogenUniqueId, const char* name, const char* file, const int line, const profiler::block_type_t type, const profiler::color_t color, const bool copyName)
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	// Call sites register once per thread, the first registration of a site is shared by all. Sites with a run-time name all share their line's id, tell them apart by name.
+	const std::string site = copyName ? std::string(autogenUniqueId) + ":" + name : std::string(autogenUniqueId);
+	const auto found = descriptorsBySite_.find(site);
+	if (found != descriptorsBySite_.end()) return found->second;
+	descriptors_.push_back(std::make_unique<BlockDescriptor>((profiler::block_id_t)descriptors_.size(), status, name, file, line, type, color));
+	descriptorsBySite_.emplace(site, descriptors_.back().get());
+	return descriptors_.back().get();
+}
+
+ThreadStorage& ProfileManager::ThisThread()
+{
+	if (t_storage) return *t_storage;
+	static thread_local ThreadExpiry expiry; // Constructed now so that it's destroyed when the thread exits.
+	(void)expiry;
+	std::lock_guard<std::mutex> lock(mutex_);
+	threads_.push_back(std::make_unique<ThreadStorage>(CurrentThreadId()));
+	t_storage = threads_.back().get();
+	return *t_storage;
+}
+
+ThreadStorage* ProfileManager::FindThread(const profiler::thread_id_t id)
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	for (const auto& thread : threads_)
+	{
+		if (thread->id == id && !thread->expired.load(std::memory_order_acquire)) return thread.get();
+	}
+	return nullptr;
+}
+
+void ProfileManager::BeginBlock(profiler::Block& block)
+{
+	ThreadStorage& thread = ThisThread();
+	// Blocks get tracked even while disabled so that EASY_END_BLOCK and the destructors keep pairing with the right block when the profiler is toggled.
+	profiler::EasyBlockStatus status = IsEnabled() ? block.m_status : profiler::OFF;
+	if (!thread.openBlocks.empty() && (thread.openBlocks.back()->m_status & profiler::OFF_RECURSIVE) && (status & profiler::FORCE_ON) != profiler::FORCE_ON)
+	{
+		status = profiler::OFF_RECURSIVE; // Off, and so are its children.
+	}
+	block.m_status = status;
+	if (status & profiler::ON) block.start();
+	thread.openBlocks.push_back(&block);
+}
+
+void ProfileManager::BeginNonScopedBlock(const profiler::BaseBlockDescriptor* desc, const char* runtimeName)
+{
+	ThreadStorage& thread = ThisThread();
+	thread.nonscopedBlocks.emplace_back(desc, runtimeName, false);
+	BeginBlock(thread.nonscopedBlocks.back());
+}
+
+void ProfileManager::EndBlock()
+{
+	ThreadStorage& thread = ThisThread();
+	if (thread.openBlocks.empty()) return;
+	profiler::Block& block = *thread.openBlocks.back();
+	thread.openBlocks.pop_back();
+	if (block.m_status & profiler::ON)
+	{
+		block.finish();
+		thread.StoreBlock(block);
+		if (thread.openBlocks.empty()) thread.EndFrame(block.duration());
+	}
+	else
+	{
+		block.finish(block.begin()); // Only so that its destructor doesn't end another block.
+	}
+	if (!block.m_isScoped) thread.nonscopedBlocks.pop_back(); // Non-scoped blocks are nested like any other, the last one began is the one ending.
+}
+
+void ProfileManager::StoreBlock(const profiler::BaseBlockDescriptor* desc, const char* runtimeName, const profiler::timestamp_t begin, const profiler::timestamp_t end)
+{
+	if (!IsEnabled() || !(desc->status() & profiler::ON)) return;
+	const profiler::Block block(begin, end, desc->id(), runtimeName);
+	ThisThread().StoreBlock(block);
+}
+
+void ProfileManager::StoreValue(const profiler::BaseBlockDescriptor* desc, const profiler::DataType type, const void* data, const uint16_t size, const bool isArray, const profiler::ValueId& vin)
+{
+	if (!IsEnabled() || !(desc->status() & profiler::ON)) return;
+	ThisThread().StoreValue(desc, type, data, size, isArray, vin);
+}
+
+const char* ProfileManager::RegisterThread(const char* name, profiler::ThreadGuard* guard)
+{
+	ThreadStorage& thread = ThisThread();
+	std::lock_guard<std::mutex> lock(mutex_);
+	if (thread.name.empty()) thread.name = name ? name : "";
+	if (guard) guard->m_id = thread.id;
+	return thread.name.c_str();
+}
+
+void ProfileManager::ExpireThread(const profiler::thread_id_t id)
+{
+	if (!t_storage || t_storage->id != id) return; // Guards are destroyed by the thread they guard, anything else isn't safe to let go of.
+	t_storage->TraceSwitches();
+	t_storage->expired.store(true, std::memory_order_release);
+	t_storage = nullptr; // Should the thread record anything else, it gets a new storage.
+}
+
+void ProfileManager::SetContextSwitchLog(const char* filename)
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	contextSwitchLog_ = filename ? filename : "";
+}
+
+const char* ProfileManager::ContextSwitchLog()
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	return contextSwitchLog_.c_str();
+}
+
+void ProfileManager::AppendDescriptors(std::string& out, ProfileHeader& header)
+{
+	for (const auto& descriptor : descriptors_)
+	{
+		AppendDescriptor(out, *descriptor, descriptor->name, descriptor->file);
+	}
+	header.descriptorsCount = (uint32_t)descriptors_.size();
+	header.descriptorsMemory = out.size() - header.descriptorsCount * sizeof(uint16_t);
+}
+
+void ProfileManager::ForgetThreads(const std::vector<ThreadStorage*>& finished)
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	threads_.erase(std::remove_if(threads_.begin(), threads_.end(), [&finished](const std::unique_ptr<ThreadStorage>& thread) { return std::find(finished.begin(), finished.end(), thread.get()) != finished.end(); }), threads_.end());
+}
+
+void ProfileManager::DiscardBlocks()
+{
+	std::lock_guard<std::mutex> drainLock(dumpMutex_);
+	std::vector<ThreadStorage*> threads;
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		for (const auto& thread : threads_) threads.push_back(thread.get());
+	}
+	std::vector<ThreadStorage*> finished;
+	for (ThreadStorage* thread : threads)
+	{
+		if (thread->expired.load(std::memory_order_acquire)) finished.push_back(thread);
+		thread->blocks.Drain([](const char*, uint16_t) {});
+		if (SwitchTracer* tracer = thread->switches.load(std::memory_order_acquire)) tracer->records.Drain([](const char*, uint16_t) {});
+	}
+	ForgetThreads(finished);
+}
+
+void ProfileManager::SetBlockStatus(const profiler::block_id_t id, const profiler::EasyBlockStatus status)
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	if (id < descriptors_.size()) descriptors_[id]->m_status = status; // Read without the lock by the threads, like easy_profiler does.
+}
+
+uint32_t ProfileManager::DumpBlocksToFile(const char* filename)
+{
+	std::ofstream file;
+	return Dump([&]() -> std::ostream*
+	{
+		file.open(filename, std::ios::binary | std::ios::trunc);
+		return &file;
+	});
+}
+
+uint32_t ProfileManager::DumpBlocksToStream(std::ostream& out)
+{
+	return Dump([&out]() { return &out; });
+}
+
+uint32_t ProfileManager::Dump(const std::function<std::ostream*()>& open)
+{
+	StopStreaming(nullptr); // What a stream flushed goes to its own file, this one gets whatever is recorded from now on.
+	std::lock_guard<std::mutex> drainLock(dumpMutex_);
+
+	struct ThreadDump
+	{
+		profiler::thread_id_t id = 0;
+		std::string name;
+		std::string records; // Size prefixed, ready to be written.
+		uint32_t count = 0;
+		std::string switches; // Context switches, likewise.
+		uint32_t switchCount = 0;
+	};
+	std::vector<ThreadDump> dumps;
+	std::string descriptors;
+	ProfileHeader header;
+	header.beginTime = ~0ull;
+
+	std::vector<ThreadStorage*> threads;
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		AppendDescriptors(descriptors, header);
+		for (const auto& thread : threads_)
+		{
+			threads.push_back(thread.get());
+		}
+	}
+
+	const int64_t ticksPerSecond = TicksPerSecond();
+	std::vector<ThreadStorage*> finished; // Threads that had exited before getting drained, nothing will be added to them anymore.
+	for (ThreadStorage* thread : threads)
+	{
+		if (thread->expired.load(std::memory_order_acquire)) finished.push_back(thread);
+		ThreadDump dump;
+		dump.id = thread->id;
+		dump.count = (uint32_t)thread->blocks.Drain([&](const char* record, const uint16_t size)
+		{
+			const profiler::BaseBlockData& block = *reinterpret_cast<const profiler::BaseBlockData*>(record);
+			header.beginTime = std::min(header.beginTime, block.begin());
+			header.endTime = std::max(header.endTime, block.end());
+			header.blocksMemory += size;
+			dump.records.append((const char*)&size, sizeof(size));
+			dump.records.append(record, size);
+		});
+		dump.switchCount = DrainSwitches(*thread, dump.switches, ticksPerSecond);
+		if (dump.count == 0) continue; // Switches of a thread without blocks are of no interest.
+		header.blocksMemory += dump.switches.size() - dump.switchCount * sizeof(uint16_t);
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			dump.name = thread->name;
+		}
+		header.blocksCount += dump.count + dump.switchCount;
+		dumps.push_back(std::move(dump));
+	}
+
+	ForgetThreads(finished);
+
+	if (header.blocksCount == 0) return 0;
+	header.pid = (uint64_t)getpid();
+	header.cpuFrequency = ticksPerSecond;
+
+	std::ostream& file = *open(); // Only once there's something to write, no empty file otherwise.
+	if (!file) return 0;
+	WritePod(file, header);
+	file.write(descriptors.data(), (std::streamsize)descriptors.size());
+	for (const ThreadDump& dump : dumps)
+	{
+		WritePod(file, dump.id);
+		WritePod(file, (uint16_t)(dump.name.size() + 1));
+		file.write(dump.name.c_str(), (std::streamsize)dump.name.size() + 1);
+		WritePod(file, dump.switchCount);
+		file.write(dump.switches.data(), (std::streamsize)dump.switches.size());
+		WritePod(file, dump.count);
+		file.write(dump.records.data(), (std::streamsize)dump.records.size());
+	}
+	WritePod(file, PROFILE_SIGNATURE);
+	return file.good() ? header.blocksCount : 0;
+}
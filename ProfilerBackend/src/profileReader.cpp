@@ -0,0 +1,351 @@
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <unordered_map>
+#include <vector>
+
+#include <easy/reader.h>
+
+#include "profileReader.h"
+
+/*
+	easy_profiler's reader API: loads a whole capture into block trees, with statistics if asked for.
+	Built on ProfileReader, tools that don't need the trees should stream with it directly.
+*/
+
+namespace profiler
+{
+
+//////////////////////////////////////////////////////////////////////////
+// SerializedData
+
+SerializedData::SerializedData() : m_size(0), m_data(nullptr) {}
+
+SerializedData::SerializedData(SerializedData&& that) : m_size(that.m_size), m_data(that.m_data)
+{
+	that.m_size = 0;
+	that.m_data = nullptr;
+}
+
+SerializedData::~SerializedData() { clear(); }
+
+void SerializedData::set(const uint64_t _size)
+{
+	set(_size ? new char[_size] : nullptr, _size);
+}
+
+void SerializedData::extend(const uint64_t _size)
+{
+	char* data = new char[m_size + _size];
+	if (m_data) std::memcpy(data, m_data, m_size);
+	const uint64_t size = m_size + _size;
+	set(data, size);
+}
+
+SerializedData& SerializedData::operator=(SerializedData&& that)
+{
+	set(that.m_data, that.m_size);
+	that.m_size = 0;
+	that.m_data = nullptr;
+	return *this;
+}
+
+char* SerializedData::operator[](const uint64_t i) { return m_data + i; }
+const char* SerializedData::operator[](const uint64_t i) const { return m_data + i; }
+bool SerializedData::empty() const { return m_size == 0; }
+uint64_t SerializedData::size() const { return m_size; }
+char* SerializedData::data() { return m_data; }
+const char* SerializedData::data() const { return m_data; }
+void SerializedData::clear() { set(nullptr, 0); }
+
+void SerializedData::swap(SerializedData& other)
+{
+	std::swap(m_size, other.m_size);
+	std::swap(m_data, other.m_data);
+}
+
+void SerializedData::set(char* _data, const uint64_t _size)
+{
+	if (m_data != _data) delete[] m_data;
+	m_data = _data;
+	m_size = _size;
+}
+
+// Statistics are shared by every block they cover, each one lets go of its reference when destroyed.
+void release_stats(BlockStatistics*& _stats)
+{
+	if (_stats && --_stats->calls_number == 0) delete _stats;
+	_stats = nullptr;
+}
+
+} // namespace profiler
+
+namespace
+{
+
+using StatsMap = std::unordered_map<profiler::block_id_t, profiler::BlockStatistics*>;
+
+// Tree building state of a thread. A thread can show up more than once in a capture written in several flushes, its blocks keep nesting across them.
+struct ThreadTrees
+{
+	profiler::BlocksTreeRoot root;
+	std::vector<profiler::block_index_t> pending; // Blocks that haven't got a parent yet, in the order they ended.
+};
+
+// Where every record landed in the serialized blocks, the trees only point into them once they're all read since the buffer may still grow.
+struct Loaded
+{
+	std::vector<uint64_t> offsets; // Indexed like the blocks.
+	std::vector<profiler::timestamp_t> begins;
+	std::vector<bool> isBlock; // Only blocks can have children, events and values can't.
+};
+
+profiler::BlockStatistics* UpdateStatistics(StatsMap& stats, const profiler::blocks_t& blocks, const profiler::block_index_t index, const profiler::block_index_t parent)
+{
+	const profiler::BlocksTree& tree = blocks[index];
+	const profiler::timestamp_t duration = tree.node->duration();
+	profiler::timestamp_t childrenDuration = 0;
+	for (const profiler::block_index_t child : tree.children) childrenDuration += blocks[child].node->duration();
+
+	const auto found = stats.find(tree.node->id());
+	if (found == stats.end())
+	{
+		profiler::BlockStatistics* created = new profiler::BlockStatistics(duration, index, parent);
+		created->total_children_duration = childrenDuration;
+		stats.emplace(tree.node->id(), created);
+		return created;
+	}
+	profiler::BlockStatistics* existing = found->second;
+	existing->calls_number++;
+	existing->total_duration += duration;
+	existing->total_children_duration += childrenDuration;
+	if (duration > blocks[existing->max_duration_block].node->duration()) existing->max_duration_block = index;
+	if (duration < blocks[existing->min_duration_block].node->duration()) existing->min_duration_block = index;
+	return existing;
+}
+
+void UpdateFrameStatistics(StatsMap& stats, profiler::blocks_t& blocks, const profiler::block_index_t index, const profiler::block_index_t frame)
+{
+	blocks[index].per_frame_stats = UpdateStatistics(stats, blocks, index, frame);
+	for (const profiler::block_index_t child : blocks[index].children) UpdateFrameStatistics(stats, blocks, child, frame);
+}
+
+// Median of every statistics, from the durations of the blocks that share it.
+void ComputeMedians(profiler::blocks_t& blocks)
+{
+	std::unordered_map<profiler::BlockStatistics*, std::vector<profiler::timestamp_t>> durations;
+	for (const profiler::BlocksTree& tree : blocks)
+	{
+		for (profiler::BlockStatistics* stats : { tree.per_thread_stats, tree.per_parent_stats, tree.per_frame_stats })
+		{
+			if (stats) durations[stats].push_back(tree.node->duration());
+		}
+	}
+	for (auto& [stats, values] : durations)
+	{
+		auto middle = values.begin() + values.size() / 2;
+		std::nth_element(values.begin(), middle, values.end());
+		stats->median_duration = *middle;
+		if (values.size() % 2 == 0) // The mean of the two middle durations, the lower one is the largest of the lower half.
+		{
+			const profiler::timestamp_t lower = *std::max_element(values.begin(), middle);
+			stats->median_duration = lower + (*middle - lower) / 2;
+		}
+	}
+}
+
+// The descriptors outlive the reader, in the caller's serialized data.
+void CopyDescriptors(const ProfileReader& reader, profiler::SerializedData& serialized_descriptors, profiler::descriptors_list_t& descriptors)
+{
+	const std::string& data = reader.DescriptorsData();
+	serialized_descriptors.set(data.size());
+	if (!data.empty()) std::memcpy(serialized_descriptors.data(), data.data(), data.size());
+	descriptors.assign(reader.Descriptors().size(), nullptr);
+	for (size_t id = 0; id < descriptors.size(); id++)
+	{
+		if (reader.Descriptors()[id]) descriptors[id] = reinterpret_cast<profiler::SerializedBlockDescriptor*>(serialized_descriptors[(uint64_t)(reader.Descriptors()[id]->data() - data.data())]);
+	}
+}
+
+} // namespace
+
+extern "C"
+{
+
+profiler::block_index_t fillTreesFromFile(std::atomic<int>& progress, const char* filename, profiler::BeginEndTime& begin_end_time, profiler::SerializedData& serialized_blocks,
+	profiler::SerializedData& serialized_descriptors, profiler::descriptors_list_t& descriptors, profiler::blocks_t& _blocks, profiler::thread_blocks_tree_t& threaded_trees,
+	profiler::bookmarks_t& bookmarks, uint32_t& descriptors_count, uint32_t& version, profiler::processid_t& pid, bool gather_statistics, std::ostream& _log)
+{
+	std::ifstream file(filename, std::ios::binary);
+	if (!file)
+	{
+		_log << "Can not open file " << filename;
+		return 0;
+	}
+	return fillTreesFromStream(progress, file, begin_end_time, serialized_blocks, serialized_descriptors, descriptors, _blocks, threaded_trees, bookmarks, descriptors_count, version, pid, gather_statistics, _log);
+}
+
+profiler::block_index_t fillTreesFromStream(std::atomic<int>& progress, std::istream& str, profiler::BeginEndTime& begin_end_time, profiler::SerializedData& serialized_blocks,
+	profiler::SerializedData& serialized_descriptors, profiler::descriptors_list_t& descriptors, profiler::blocks_t& _blocks, profiler::thread_blocks_tree_t& threaded_trees,
+	profiler::bookmarks_t& bookmarks, uint32_t& descriptors_count, uint32_t& version, profiler::processid_t& pid, bool gather_statistics, std::ostream& _log)
+{
+	progress.store(0);
+	ProfileReader reader(str);
+	if (!reader.Open())
+	{
+		_log << reader.Error();
+		return 0;
+	}
+	CopyDescriptors(reader, serialized_descriptors, descriptors);
+	descriptors_count = reader.Header().descriptorsCount;
+	version = reader.Header().version;
+	pid = reader.Header().pid;
+
+	serialized_blocks.set(reader.Header().blocksMemory);
+	uint64_t used = 0;
+	Loaded loaded;
+	std::unordered_map<profiler::thread_id_t, ThreadTrees> threads;
+	std::vector<profiler::thread_id_t> threadOrder;
+	profiler::BeginEndTime range = { ~0ull, 0 };
+
+	const auto store = [&](const char* data, const uint16_t size) -> profiler::block_index_t
+	{
+		if (used + size > serialized_blocks.size()) serialized_blocks.extend(std::max<uint64_t>(size, serialized_blocks.size() / 2 + 4096)); // Streamed captures don't know their size upfront.
+		std::memcpy(serialized_blocks[used], data, size);
+		loaded.offsets.push_back(used);
+		used += size;
+		_blocks.emplace_back();
+		return (profiler::block_index_t)(_blocks.size() - 1);
+	};
+
+	ProfileThread thread;
+	while (reader.NextThread(thread))
+	{
+		if (progress.load() < 0)
+		{
+			_log << "Reading was interrupted";
+			return 0;
+		}
+		auto [found, fresh] = threads.try_emplace(thread.id);
+		ThreadTrees& trees = found->second;
+		if (fresh)
+		{
+			threadOrder.push_back(thread.id);
+			trees.root.thread_id = thread.id;
+		}
+		if (!thread.name.empty()) trees.root.thread_name = thread.name;
+
+		const profiler::SerializedCSwitch* cswitch = nullptr;
+		while (reader.NextCSwitch(cswitch))
+		{
+			const uint16_t size = (uint16_t)(sizeof(profiler::CSwitchEvent) + std::strlen(cswitch->name()) + 1);
+			trees.root.sync.push_back(store(cswitch->data(), size));
+			loaded.begins.push_back(cswitch->begin());
+			loaded.isBlock.push_back(false);
+			trees.root.wait_time += cswitch->duration();
+		}
+
+		ProfileRecord record;
+		while (reader.NextRecord(record))
+		{
+			const profiler::block_index_t index = store(record.data, record.size);
+			const profiler::timestamp_t begin = record.Block().begin();
+			const bool isBlock = record.Type() == profiler::BlockType::Block;
+			loaded.begins.push_back(begin);
+			loaded.isBlock.push_back(isBlock);
+			range.beginTime = std::min(range.beginTime, begin);
+			range.endTime = std::max(range.endTime, record.Block().end());
+			if (record.Type() == profiler::BlockType::Event) trees.root.events.push_back(index);
+			trees.root.blocks_number++;
+
+			if (isBlock) // Whatever ended before it and began after it is nested in it.
+			{
+				auto firstChild = trees.pending.end();
+				while (firstChild != trees.pending.begin() && loaded.begins[*(firstChild - 1)] >= begin) --firstChild;
+				_blocks[index].children.assign(firstChild, trees.pending.end());
+				trees.pending.erase(firstChild, trees.pending.end());
+			}
+			trees.pending.push_back(index);
+		}
+	}
+	if (reader.Failed())
+	{
+		_log << reader.Error();
+		return 0;
+	}
+	if (!reader.Complete()) _log << "The capture is truncated, its last thread may be missing blocks.\n";
+	reader.ReadBookmarks(bookmarks);
+	progress.store(50);
+
+	// The serialized blocks are final, point the trees into them.
+	for (size_t i = 0; i < _blocks.size(); i++)
+	{
+		_blocks[i].node = reinterpret_cast<profiler::SerializedBlock*>(serialized_blocks[loaded.offsets[i]]);
+	}
+	for (size_t i = 0; i < _blocks.size(); i++) // Children come before their parents.
+	{
+		uint8_t depth = 0;
+		for (const profiler::block_index_t child : _blocks[i].children) depth = std::max<uint8_t>(depth, (uint8_t)std::min(_blocks[child].depth + 1, 255));
+		_blocks[i].depth = depth;
+	}
+
+	for (const profiler::thread_id_t id : threadOrder)
+	{
+		ThreadTrees& trees = threads[id];
+		profiler::BlocksTreeRoot& root = trees.root;
+		root.children = std::move(trees.pending);
+		for (const profiler::block_index_t child : root.children)
+		{
+			root.profiled_time += _blocks[child].node->duration();
+			if (loaded.isBlock[child]) root.frames_number++;
+			root.depth = std::max<uint8_t>(root.depth, (uint8_t)std::min(_blocks[child].depth + 1, 255));
+		}
+
+		if (gather_statistics)
+		{
+			StatsMap perThread;
+			StatsMap topLevel;
+			for (const profiler::block_index_t frame : root.children)
+			{
+				StatsMap perFrame;
+				UpdateFrameStatistics(perFrame, _blocks, frame, frame);
+				_blocks[frame].per_parent_stats = UpdateStatistics(topLevel, _blocks, frame, ~0u);
+			}
+			std::vector<profiler::block_index_t> stack(root.children.begin(), root.children.end());
+			while (!stack.empty())
+			{
+				const profiler::block_index_t index = stack.back();
+				stack.pop_back();
+				_blocks[index].per_thread_stats = UpdateStatistics(perThread, _blocks, index, (profiler::block_index_t)id);
+				StatsMap perParent;
+				for (const profiler::block_index_t child : _blocks[index].children)
+				{
+					_blocks[child].per_parent_stats = UpdateStatistics(perParent, _blocks, child, index);
+					stack.push_back(child);
+				}
+			}
+		}
+		threaded_trees[id] = std::move(root);
+	}
+	if (gather_statistics) ComputeMedians(_blocks);
+
+	begin_end_time = range.beginTime <= range.endTime ? range : profiler::BeginEndTime{ reader.Header().beginTime, reader.Header().endTime };
+	progress.store(100);
+	return (profiler::block_index_t)_blocks.size();
+}
+
+bool readDescriptionsFromStream(std::atomic<int>& progress, std::istream& str, profiler::SerializedData& serialized_descriptors, profiler::descriptors_list_t& descriptors, std::ostream& _log)
+{
+	progress.store(0);
+	ProfileReader reader(str);
+	if (!reader.Open())
+	{
+		_log << reader.Error();
+		return false;
+	}
+	CopyDescriptors(reader, serialized_descriptors, descriptors);
+	progress.store(100);
+	return true;
+}
+
+} // extern "C"
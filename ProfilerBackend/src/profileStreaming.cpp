@@ -0,0 +1,174 @@
+#include "profileManager.h"
+
+#include <algorithm>
+#include <cstdio>
+
+#include <unistd.h>
+
+/*
+	Streaming capture: a flusher thread drains the record rings into a spool file every interval, under a cap on the memory the rings take altogether.
+	The spool holds thread segments laid out like those of a .prof file, a thread appearing once per flush it had records at.
+	Stopping the stream writes the header and the descriptors, known only then, followed by the spool: a regular capture the readers load like any other.
+*/
+
+bool ProfileManager::StartStreaming(const char* filename, const size_t memoryCap, const std::chrono::milliseconds interval)
+{
+	std::lock_guard<std::mutex> streamLock(streamMutex_);
+	std::lock_guard<std::mutex> drainLock(dumpMutex_);
+	if (stream_) return false;
+
+	std::unique_ptr<Stream> stream = std::make_unique<Stream>();
+	stream->filename = filename;
+	stream->spoolName = stream->filename + ".part";
+	stream->spool.open(stream->spoolName, std::ios::binary | std::ios::trunc);
+	if (!stream->spool) return false;
+	stream->header.beginTime = ~0ull;
+	stream->interval = std::max(interval, std::chrono::milliseconds(1));
+	RecordRing::SetChunkCap(memoryCap ? std::max<size_t>(memoryCap / sizeof(RecordChunk), 1) : 0);
+
+	Stream* flushed = stream.get();
+	stream_ = std::move(stream);
+	flushed->flusher = std::thread([this, flushed]()
+	{
+		std::unique_lock<std::mutex> lock(flushed->wakeMutex);
+		while (!flushed->wake.wait_for(lock, flushed->interval, [flushed]() { return flushed->stop; }))
+		{
+			lock.unlock();
+			{
+				std::lock_guard<std::mutex> drainLock(dumpMutex_);
+				Flush(*flushed);
+			}
+			lock.lock();
+		}
+	});
+	return true;
+}
+
+void ProfileManager::Flush(Stream& stream)
+{
+	stream.stats.peakMemory = std::max(stream.stats.peakMemory, RecordRing::ChunksInUse() * sizeof(RecordChunk)); // Right before draining is when the rings hold the most.
+
+	std::vector<ThreadStorage*> threads;
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		for (const auto& thread : threads_) threads.push_back(thread.get());
+	}
+
+	ProfileHeader& header = stream.header;
+	const int64_t ticksPerSecond = TicksPerSecond();
+	std::vector<ThreadStorage*> finished;
+	for (ThreadStorage* thread : threads)
+	{
+		if (thread->expired.load(std::memory_order_acquire)) finished.push_back(thread);
+		std::string switches;
+		const uint32_t switchCount = DrainSwitches(*thread, switches, ticksPerSecond);
+		std::streampos countAt = -1;
+		const auto beginSegment = [&]() // Threads without records this time get no segment.
+		{
+			std::string name;
+			{
+				std::lock_guard<std::mutex> lock(mutex_);
+				name = thread->name;
+			}
+			WritePod(stream.spool, thread->id);
+			WritePod(stream.spool, (uint16_t)(name.size() + 1));
+			stream.spool.write(name.c_str(), (std::streamsize)name.size() + 1);
+			WritePod(stream.spool, switchCount);
+			stream.spool.write(switches.data(), (std::streamsize)switches.size());
+			countAt = stream.spool.tellp();
+			WritePod(stream.spool, (uint32_t)0); // Known once drained.
+		};
+		const uint32_t count = (uint32_t)thread->blocks.Drain([&](const char* record, const uint16_t size)
+		{
+			if (countAt == std::streampos(-1)) beginSegment();
+			const profiler::BaseBlockData& block = *reinterpret_cast<const profiler::BaseBlockData*>(record);
+			header.beginTime = std::min(header.beginTime, block.begin());
+			header.endTime = std::max(header.endTime, block.end());
+			header.blocksMemory += size;
+			WriteRecord(stream.spool, record, size);
+		});
+		stream.stats.dropped += thread->dropped.exchange(0, std::memory_order_relaxed);
+		if (count == 0)
+		{
+			if (switchCount == 0) continue;
+			beginSegment(); // The thread's blocks may come in a later flush, its switches are kept.
+		}
+		stream.spool.seekp(countAt);
+		WritePod(stream.spool, count);
+		stream.spool.seekp(0, std::ios::end);
+		header.blocksCount += count + switchCount;
+		header.blocksMemory += switches.size() - switchCount * sizeof(uint16_t);
+	}
+	ForgetThreads(finished);
+	stream.spool.flush();
+	stream.stats.flushes++;
+}
+
+uint32_t ProfileManager::StopStreaming(StreamingCaptureStats* stats)
+{
+	std::lock_guard<std::mutex> streamLock(streamMutex_);
+	Stream* running = nullptr;
+	{
+		std::lock_guard<std::mutex> drainLock(dumpMutex_);
+		running = stream_.get();
+	}
+	if (!running) return 0;
+	{
+		std::lock_guard<std::mutex> lock(running->wakeMutex);
+		running->stop = true;
+	}
+	running->wake.notify_all();
+	running->flusher.join();
+
+	std::unique_ptr<Stream> stream;
+	{
+		std::lock_guard<std::mutex> drainLock(dumpMutex_);
+		Flush(*running);
+		RecordRing::SetChunkCap(0);
+		stream = std::move(stream_);
+	}
+	stream->spool.close();
+
+	ProfileHeader& header = stream->header;
+	if (stats)
+	{
+		*stats = stream->stats;
+		stats->records = header.blocksCount;
+		stats->bytes = header.blocksMemory;
+	}
+	if (header.blocksCount == 0 || !stream->spool)
+	{
+		std::remove(stream->spoolName.c_str());
+		return 0;
+	}
+
+	std::string descriptors;
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		AppendDescriptors(descriptors, header);
+	}
+	header.pid = (uint64_t)getpid();
+	header.cpuFrequency = TicksPerSecond();
+
+	std::ofstream file(stream->filename, std::ios::binary | std::ios::trunc);
+	std::ifstream spool(stream->spoolName, std::ios::binary);
+	if (!file || !spool) return 0; // The spool stays, it holds every record.
+	WritePod(file, header);
+	file.write(descriptors.data(), (std::streamsize)descriptors.size());
+	file << spool.rdbuf(); // Copied through the stream buffers, whatever the size of the capture.
+	WritePod(file, PROFILE_SIGNATURE);
+	if (!file) return 0;
+	spool.close();
+	std::remove(stream->spoolName.c_str());
+	return header.blocksCount;
+}
+
+bool StartStreamingCapture(const char* filename, const size_t memoryCap, const uint32_t flushIntervalMs)
+{
+	return ProfileManager::Instance().StartStreaming(filename, memoryCap, std::chrono::milliseconds(flushIntervalMs));
+}
+
+uint32_t StopStreamingCapture(StreamingCaptureStats* stats)
+{
+	return ProfileManager::Instance().StopStreaming(stats);
+}
@@ -0,0 +1,158 @@
+#include "profileSwitches.h"
+
+#include <algorithm>
+
+#include <linux/perf_event.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#ifndef PERF_RECORD_MISC_SWITCH_OUT_PREEMPT
+#define PERF_RECORD_MISC_SWITCH_OUT_PREEMPT (1 << 14) // Linux 4.17, older kernels never set it: every switch reads as waiting.
+#endif
+
+namespace
+{
+
+constexpr size_t BUFFER_PAGES = 32; // A power of 2. Switches take 48 bytes per round trip, 128 KiB hold thousands between two polls.
+constexpr const char* PREEMPTED = "Preempted";
+constexpr const char* WAITING = "Waiting";
+
+size_t PageSize()
+{
+	static const size_t size = (size_t)sysconf(_SC_PAGESIZE);
+	return size;
+}
+
+size_t MappingSize()
+{
+	return (1 + BUFFER_PAGES) * PageSize();
+}
+
+// Copies from the kernel's circular buffer, records may wrap around its end.
+void CopyOut(const char* buffer, const uint64_t size, const uint64_t position, void* out, const size_t count)
+{
+	const uint64_t offset = position % size;
+	const size_t first = (size_t)std::min<uint64_t>(count, size - offset);
+	std::memcpy(out, buffer + offset, first);
+	std::memcpy(static_cast<char*>(out) + first, buffer, count - first);
+}
+
+} // namespace
+
+SwitchTracer* SwitchTracer::Open()
+{
+	perf_event_attr attr = {};
+	attr.size = sizeof(attr);
+	attr.type = PERF_TYPE_SOFTWARE;
+	attr.config = PERF_COUNT_SW_DUMMY; // Counts nothing, only there for the switch records.
+	attr.sample_type = PERF_SAMPLE_TID | PERF_SAMPLE_TIME;
+	attr.sample_id_all = 1; // The switch records get the tid and the time.
+	attr.context_switch = 1;
+	attr.exclude_kernel = 1;
+	attr.exclude_hv = 1;
+	attr.use_clockid = 1;
+	attr.clockid = CLOCK_MONOTONIC; // The backend's clock, or what its TSC gets calibrated against.
+	const int fd = (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, PERF_FLAG_FD_CLOEXEC);
+	if (fd < 0) return nullptr;
+	void* mapping = mmap(nullptr, MappingSize(), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0); // Writable, so that the kernel doesn't overwrite what wasn't read yet.
+	if (mapping == MAP_FAILED)
+	{
+		close(fd);
+		return nullptr;
+	}
+	return new SwitchTracer(fd, static_cast<char*>(mapping));
+}
+
+SwitchTracer::~SwitchTracer()
+{
+	munmap(mapping_, MappingSize());
+	close(fd_);
+}
+
+void SwitchTracer::Poll(const bool keep)
+{
+	perf_event_mmap_page& meta = *reinterpret_cast<perf_event_mmap_page*>(mapping_);
+	const uint64_t head = __atomic_load_n(&meta.data_head, __ATOMIC_ACQUIRE);
+	uint64_t tail = meta.data_tail;
+	if (head == tail) return;
+
+	const char* buffer = mapping_ + PageSize();
+	const uint64_t size = BUFFER_PAGES * PageSize();
+	while (tail < head)
+	{
+		perf_event_header header;
+		CopyOut(buffer, size, tail, &header, sizeof(header));
+		if (header.size < sizeof(header)) break; // Can't happen, but would loop forever.
+		if (keep && header.type == PERF_RECORD_SWITCH && header.size >= sizeof(header) + 2 * sizeof(uint64_t))
+		{
+			uint64_t time = 0;
+			CopyOut(buffer, size, tail + sizeof(header) + sizeof(uint64_t), &time, sizeof(time)); // After the pid and tid.
+			if (header.misc & PERF_RECORD_MISC_SWITCH_OUT)
+			{
+				switchedOut_ = time;
+				preempted_ = (header.misc & PERF_RECORD_MISC_SWITCH_OUT_PREEMPT) != 0;
+			}
+			else if (switchedOut_)
+			{
+				Store(switchedOut_, time, preempted_ ? PREEMPTED : WAITING);
+				switchedOut_ = 0;
+			}
+		}
+		else if (!keep || header.type == PERF_RECORD_LOST)
+		{
+			switchedOut_ = 0; // The switch back in, or out, may be gone.
+		}
+		tail += header.size;
+	}
+	__atomic_store_n(&meta.data_tail, head, __ATOMIC_RELEASE);
+}
+
+void SwitchTracer::Store(const uint64_t begin, const uint64_t end, const char* reason)
+{
+	const size_t reasonSize = std::strlen(reason) + 1;
+	const uint16_t size = (uint16_t)(sizeof(profiler::CSwitchEvent) + reasonSize);
+	char* record = records.Reserve(size);
+	if (!record) return; // Over the memory cap of a streamed capture.
+	const profiler::thread_id_t switchedTo = 0; // Unknown, only the switches of this thread are traced.
+	std::memcpy(record, &begin, sizeof(begin));
+	std::memcpy(record + sizeof(begin), &end, sizeof(end));
+	std::memcpy(record + 2 * sizeof(uint64_t), &switchedTo, sizeof(switchedTo));
+	std::memcpy(record + sizeof(profiler::CSwitchEvent), reason, reasonSize);
+	records.Commit(size);
+}
+
+void ThreadStorage::TraceSwitches()
+{
+	ProfileManager& manager = ProfileManager::Instance();
+	const bool keep = manager.IsEnabled() && manager.eventTracing.load(std::memory_order_relaxed);
+	SwitchTracer* tracer = switches.load(std::memory_order_relaxed);
+	if (!tracer)
+	{
+		if (!keep || switchesOpened) return;
+		switchesOpened = true; // Once, perf_event_open won't change its mind.
+		tracer = SwitchTracer::Open();
+		if (!tracer) return;
+		switches.store(tracer, std::memory_order_release);
+	}
+	tracer->Poll(keep);
+}
+
+uint32_t ProfileManager::DrainSwitches(ThreadStorage& thread, std::string& out, const int64_t ticksPerSecond)
+{
+	SwitchTracer* tracer = thread.switches.load(std::memory_order_acquire);
+	if (!tracer) return 0;
+	return (uint32_t)tracer->records.Drain([&](const char* record, const uint16_t size)
+	{
+		out.append((const char*)&size, sizeof(size));
+		const size_t at = out.size();
+		out.append(record, size);
+		for (size_t i = 0; i < 2; i++) // Begin and end.
+		{
+			uint64_t time = 0;
+			std::memcpy(&time, &out[at + i * sizeof(time)], sizeof(time));
+			time = FromMonotonicNs(time, ticksPerSecond);
+			std::memcpy(&out[at + i * sizeof(time)], &time, sizeof(time));
+		}
+	});
+}
@@ -0,0 +1,157 @@
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <vector>
+
+#include <easy/writer.h>
+
+#include "profileFormat.h"
+
+/*
+	easy_profiler's writer API: saves block trees, loaded with reader.h or put together by a tool, back to a .prof file.
+	Timestamps of the trees are nanoseconds, the file is written with a frequency of 0 to say so.
+*/
+
+namespace
+{
+
+uint16_t RecordSize(const profiler::BlocksTree& tree, const profiler::descriptors_list_t& descriptors)
+{
+	const profiler::block_id_t id = tree.node->id();
+	if (id < descriptors.size() && descriptors[id] && descriptors[id]->type() == profiler::BlockType::Value) return (uint16_t)(VALUE_RECORD_SIZE + tree.value->data_size());
+	return (uint16_t)(BLOCK_RECORD_SIZE + std::strlen(tree.node->name()) + 1);
+}
+
+uint16_t CSwitchSize(const profiler::BlocksTree& tree)
+{
+	return (uint16_t)(sizeof(profiler::CSwitchEvent) + std::strlen(tree.cs->name()) + 1);
+}
+
+uint16_t DescriptorSize(const profiler::SerializedBlockDescriptor& descriptor)
+{
+	return (uint16_t)(DESCRIPTOR_RECORD_SIZE + std::strlen(descriptor.name()) + 1 + std::strlen(descriptor.file()) + 1);
+}
+
+// Records of a thread in the order they ended, children before their parent, like the backend writes them.
+std::vector<profiler::block_index_t> EndOrder(const profiler::BlocksTreeRoot& root, const profiler::block_getter_fn& block_getter)
+{
+	std::vector<profiler::block_index_t> order;
+	std::vector<std::pair<profiler::block_index_t, size_t>> stack; // Block, how many of its children were visited.
+	for (const profiler::block_index_t top : root.children)
+	{
+		stack.emplace_back(top, 0);
+		while (!stack.empty())
+		{
+			auto& [index, visited] = stack.back();
+			const profiler::BlocksTree& tree = block_getter(index);
+			if (visited < tree.children.size())
+			{
+				stack.emplace_back(tree.children[visited++], 0);
+				continue;
+			}
+			order.push_back(index);
+			stack.pop_back();
+		}
+	}
+	return order;
+}
+
+} // namespace
+
+extern "C"
+{
+
+profiler::block_index_t writeTreesToFile(std::atomic<int>& progress, const char* filename, const profiler::SerializedData& serialized_descriptors, const profiler::descriptors_list_t& descriptors,
+	profiler::block_id_t descriptors_count, const profiler::thread_blocks_tree_t& trees, const profiler::bookmarks_t& bookmarks, profiler::block_getter_fn block_getter,
+	profiler::timestamp_t begin_time, profiler::timestamp_t end_time, profiler::processid_t pid, std::ostream& log)
+{
+	std::ofstream file(filename, std::ios::binary | std::ios::trunc);
+	if (!file)
+	{
+		log << "Can not open file " << filename;
+		return 0;
+	}
+	return writeTreesToStream(progress, file, serialized_descriptors, descriptors, descriptors_count, trees, bookmarks, std::move(block_getter), begin_time, end_time, pid, log);
+}
+
+profiler::block_index_t writeTreesToStream(std::atomic<int>& progress, std::ostream& str, const profiler::SerializedData&, const profiler::descriptors_list_t& descriptors,
+	profiler::block_id_t, const profiler::thread_blocks_tree_t& trees, const profiler::bookmarks_t& bookmarks, profiler::block_getter_fn block_getter,
+	profiler::timestamp_t begin_time, profiler::timestamp_t end_time, profiler::processid_t pid, std::ostream& log)
+{
+	progress.store(0);
+
+	// The header comes first and holds the totals, the records are counted before anything is written.
+	ProfileHeader header;
+	header.pid = pid;
+	header.beginTime = begin_time;
+	header.endTime = end_time;
+	for (const profiler::SerializedBlockDescriptor* descriptor : descriptors)
+	{
+		if (!descriptor) continue;
+		header.descriptorsCount++;
+		header.descriptorsMemory += DescriptorSize(*descriptor);
+	}
+	std::vector<std::pair<const profiler::BlocksTreeRoot*, std::vector<profiler::block_index_t>>> threads;
+	for (const auto& [id, root] : trees) threads.emplace_back(&root, std::vector<profiler::block_index_t>());
+	std::sort(threads.begin(), threads.end(), [](const auto& a, const auto& b) { return a.first->thread_id < b.first->thread_id; }); // Same file for the same trees, the map has no order.
+	for (auto& [root, order] : threads)
+	{
+		order = EndOrder(*root, block_getter);
+		for (const profiler::block_index_t index : root->sync) header.blocksMemory += CSwitchSize(block_getter(index));
+		for (const profiler::block_index_t index : order) header.blocksMemory += RecordSize(block_getter(index), descriptors);
+		header.blocksCount += (uint32_t)(root->sync.size() + order.size());
+	}
+	header.bookmarksCount = (uint16_t)std::min<size_t>(bookmarks.size(), UINT16_MAX);
+	progress.store(10);
+
+	WritePod(str, header);
+	for (const profiler::SerializedBlockDescriptor* descriptor : descriptors)
+	{
+		if (descriptor) WriteRecord(str, descriptor->data(), DescriptorSize(*descriptor));
+	}
+	for (const auto& [root, order] : threads)
+	{
+		if (progress.load() < 0)
+		{
+			log << "Writing was interrupted";
+			return 0;
+		}
+		WritePod(str, (uint64_t)root->thread_id);
+		WritePod(str, (uint16_t)(root->thread_name.size() + 1));
+		str.write(root->thread_name.c_str(), root->thread_name.size() + 1);
+		WritePod(str, (uint32_t)root->sync.size());
+		for (const profiler::block_index_t index : root->sync)
+		{
+			const profiler::BlocksTree& tree = block_getter(index);
+			WriteRecord(str, tree.cs->data(), CSwitchSize(tree));
+		}
+		WritePod(str, (uint32_t)order.size());
+		for (const profiler::block_index_t index : order)
+		{
+			const profiler::BlocksTree& tree = block_getter(index);
+			WriteRecord(str, reinterpret_cast<const char*>(tree.node), RecordSize(tree, descriptors));
+		}
+	}
+	WritePod(str, PROFILE_SIGNATURE);
+	for (size_t i = 0; i < header.bookmarksCount; i++)
+	{
+		const profiler::Bookmark& bookmark = bookmarks[i];
+		const size_t textSize = std::min<size_t>(bookmark.text.size(), UINT16_MAX - profiler::Bookmark::BaseSize);
+		WritePod(str, (uint16_t)(profiler::Bookmark::BaseSize + textSize));
+		WritePod(str, bookmark.pos);
+		WritePod(str, bookmark.color);
+		str.write(bookmark.text.c_str(), textSize);
+		str.put('\0');
+	}
+
+	if (!str)
+	{
+		log << "Failed to write the capture";
+		return 0;
+	}
+	progress.store(100);
+	return (profiler::block_index_t)header.blocksCount;
+}
+
+} // extern "C"
@@ -0,0 +1,176 @@
+#include <cstring>
+
+#include <easy/profiler.h>
+#include <easy/arbitrary_value.h>
+#include <easy/serialized_block.h>
+
+#include "profileFormat.h"
+#include "profileManager.h"
+
+/*
+	easy_profiler's public API and the out-of-line members of its public types, forwarded to the ProfileManager.
+*/
+
+namespace
+{
+
+const profiler::thread_id_t MAIN_THREAD_ID = CurrentThreadId(); // Static initialization runs on the main thread.
+
+profiler::timestamp_t CastDuration(const profiler::timestamp_t ticks, const profiler::Duration durationCast)
+{
+	return durationCast == profiler::TICKS ? ticks : ProfileManager::Instance().ToNanoseconds(ticks) / 1000;
+}
+
+profiler::timestamp_t LocalMax(ThreadStorage* thread)
+{
+	return thread ? thread->frameMax.exchange(0, std::memory_order_relaxed) : 0;
+}
+
+profiler::timestamp_t LocalAverage(ThreadStorage* thread)
+{
+	if (!thread) return 0;
+	const uint32_t count = thread->frameCount.exchange(0, std::memory_order_relaxed);
+	const profiler::timestamp_t sum = thread->frameSum.exchange(0, std::memory_order_relaxed);
+	return count ? sum / count : 0;
+}
+
+} // namespace
+
+namespace profiler
+{
+
+//////////////////////////////////////////////////////////////////////////
+// Public types
+
+BaseBlockDescriptor::BaseBlockDescriptor(const block_id_t _id, const EasyBlockStatus _status, const int _line, const block_type_t _block_type, const color_t _color) EASY_NOEXCEPT
+	: m_id(_id), m_line(_line), m_color(_color), m_type(_block_type), m_status(_status)
+{
+}
+
+Event::Event(const timestamp_t _begin_time) EASY_NOEXCEPT : m_begin(_begin_time), m_end(_begin_time) {}
+Event::Event(const timestamp_t _begin_time, const timestamp_t _end_time) EASY_NOEXCEPT : m_begin(_begin_time), m_end(_end_time) {}
+
+BaseBlockData::BaseBlockData(const timestamp_t _begin_time, const block_id_t _id) EASY_NOEXCEPT : Event(_begin_time), m_id(_id) {}
+BaseBlockData::BaseBlockData(const timestamp_t _begin_time, const timestamp_t _end_time, const block_id_t _id) EASY_NOEXCEPT : Event(_begin_time, _end_time), m_id(_id) {}
+
+// A block that hasn't begun yet has its end before its begin, see Block::finished().
+Block::Block(const BaseBlockDescriptor* _desc, const char* _runtimeName, const bool _scoped) EASY_NOEXCEPT
+	: BaseBlockData(1ull, 0ull, _desc ? _desc->id() : 0), m_name(_runtimeName), m_status(_desc ? _desc->status() : OFF), m_isScoped(_scoped)
+{
+}
+
+Block::Block(const timestamp_t _begin_time, const block_id_t _id, const char* _runtimeName) EASY_NOEXCEPT
+	: BaseBlockData(_begin_time, _id), m_name(_runtimeName), m_status(ON), m_isScoped(true)
+{
+}
+
+Block::Block(const timestamp_t _begin_time, const timestamp_t _end_time, const block_id_t _id, const char* _runtimeName) EASY_NOEXCEPT
+	: BaseBlockData(_begin_time, _end_time, _id), m_name(_runtimeName), m_status(ON), m_isScoped(true)
+{
+}
+
+Block::Block(Block&& that) EASY_NOEXCEPT
+	: BaseBlockData(that.m_begin, that.m_end, that.m_id), m_name(that.m_name), m_status(that.m_status), m_isScoped(that.m_isScoped)
+{
+	that.m_end = that.m_begin; // The moved from block must not end anything when destroyed.
+}
+
+Block::~Block()
+{
+	if (!finished()) ProfileManager::Instance().EndBlock();
+}
+
+void Block::start() { m_begin = ProfileManager::Instance().Now(); }
+void Block::start(const timestamp_t _time) EASY_NOEXCEPT { m_begin = _time; }
+void Block::finish() { m_end = ProfileManager::Instance().Now(); }
+void Block::finish(const timestamp_t _time) EASY_NOEXCEPT { m_end = _time; }
+
+ThreadGuard::~ThreadGuard()
+{
+	if (m_id != 0) ProfileManager::Instance().ExpireThread(m_id);
+}
+
+SerializedBlock::SerializedBlock(const Block& block, const uint16_t name_length)
+	: BaseBlockData(block)
+{
+	char* name = const_cast<char*>(this->name());
+	if (name_length) std::memcpy(name, block.name(), name_length);
+	name[name_length] = 0;
+}
+
+CSwitchEvent::CSwitchEvent(const timestamp_t _begin_time, const thread_id_t _tid) EASY_NOEXCEPT : Event(_begin_time), m_thread_id(_tid) {}
+
+//////////////////////////////////////////////////////////////////////////
+// Core API
+
+timestamp_t now() { return ProfileManager::Instance().Now(); }
+timestamp_t toNanoseconds(const timestamp_t _ticks) { return ProfileManager::Instance().ToNanoseconds(_ticks); }
+timestamp_t toMicroseconds(const timestamp_t _ticks) { return ProfileManager::Instance().ToNanoseconds(_ticks) / 1000; }
+
+const BaseBlockDescriptor* registerDescription(const EasyBlockStatus _status, const char* _autogenUniqueId, const char* _compiletimeName, const char* _filename, const int _line, const block_type_t _block_type, const color_t _color, const bool _copyName)
+{
+	return ProfileManager::Instance().RegisterDescription(_status, _autogenUniqueId, _compiletimeName, _filename, _line, _block_type, _color, _copyName);
+}
+
+void storeEvent(const BaseBlockDescriptor* _desc, const char* _runtimeName)
+{
+	ProfileManager& manager = ProfileManager::Instance();
+	const timestamp_t time = manager.Now();
+	manager.StoreBlock(_desc, _runtimeName, time, time);
+}
+
+void storeBlock(const BaseBlockDescriptor* _desc, const char* _runtimeName, const timestamp_t _beginTime, const timestamp_t _endTime)
+{
+	ProfileManager::Instance().StoreBlock(_desc, _runtimeName, _beginTime, _endTime);
+}
+
+void storeValue(const BaseBlockDescriptor* _desc, const DataType _type, const void* _data, const uint16_t _size, const bool _isArray, const ValueId _vin)
+{
+	ProfileManager::Instance().StoreValue(_desc, _type, _data, _size, _isArray, _vin);
+}
+
+void beginBlock(Block& _block) { ProfileManager::Instance().BeginBlock(_block); }
+void beginNonScopedBlock(const BaseBlockDescriptor* _desc, const char* _runtimeName) { ProfileManager::Instance().BeginNonScopedBlock(_desc, _runtimeName); }
+void endBlock() { ProfileManager::Instance().EndBlock(); }
+
+void setEnabled(const bool _isEnable) { ProfileManager::Instance().SetEnabled(_isEnable); }
+bool isEnabled() { return ProfileManager::Instance().IsEnabled(); }
+
+uint32_t dumpBlocksToFile(const char* _filename) { return ProfileManager::Instance().DumpBlocksToFile(_filename); }
+
+const char* registerThreadScoped(const char* _name, ThreadGuard& _guard) { return ProfileManager::Instance().RegisterThread(_name, &_guard); }
+const char* registerThread(const char* _name) { return ProfileManager::Instance().RegisterThread(_name, nullptr); }
+
+void setEventTracingEnabled(const bool _isEnable) { ProfileManager::Instance().eventTracing.store(_isEnable); }
+bool isEventTracingEnabled() { return ProfileManager::Instance().eventTracing.load(); }
+void setLowPriorityEventTracing(const bool _isLowPriority) { ProfileManager::Instance().lowPriorityEventTracing.store(_isLowPriority); }
+bool isLowPriorityEventTracing() { return ProfileManager::Instance().lowPriorityEventTracing.load(); }
+void setContextSwitchLogFilename(const char* _name) { ProfileManager::Instance().SetContextSwitchLog(_name); }
+const char* getContextSwitchLogFilename() { return ProfileManager::Instance().ContextSwitchLog(); }
+
+void startListen(const uint16_t _port) { ProfileManager::Instance().StartListen(0x7f000001, _port); } // 127.0.0.1, see profileListen.h for other interfaces.
+void stopListen() { ProfileManager::Instance().StopListen(); }
+bool isListening() { return ProfileManager::Instance().IsListening(); }
+
+uint8_t versionMajor() { return (uint8_t)(PROFILE_VERSION >> 24); }
+uint8_t versionMinor() { return (uint8_t)((PROFILE_VERSION >> 16) & 0xff); }
+uint16_t versionPatch() { return (uint16_t)(PROFILE_VERSION & 0xffff); }
+uint32_t version() { return PROFILE_VERSION; }
+const char* versionName() { return PROFILE_VERSION_NAME; }
+
+bool isMainThread() { return CurrentThreadId() == MAIN_THREAD_ID; }
+
+timestamp_t this_thread_frameTime(const Duration _durationCast) { return CastDuration(ProfileManager::Instance().ThisThread().lastFrame.load(std::memory_order_relaxed), _durationCast); }
+timestamp_t this_thread_frameTimeLocalMax(const Duration _durationCast) { return CastDuration(LocalMax(&ProfileManager::Instance().ThisThread()), _durationCast); }
+timestamp_t this_thread_frameTimeLocalAvg(const Duration _durationCast) { return CastDuration(LocalAverage(&ProfileManager::Instance().ThisThread()), _durationCast); }
+
+timestamp_t main_thread_frameTime(const Duration _durationCast)
+{
+	const ThreadStorage* main = ProfileManager::Instance().FindThread(MAIN_THREAD_ID);
+	return CastDuration(main ? main->lastFrame.load(std::memory_order_relaxed) : 0, _durationCast);
+}
+
+timestamp_t main_thread_frameTimeLocalMax(const Duration _durationCast) { return CastDuration(LocalMax(ProfileManager::Instance().FindThread(MAIN_THREAD_ID)), _durationCast); }
+timestamp_t main_thread_frameTimeLocalAvg(const Duration _durationCast) { return CastDuration(LocalAverage(ProfileManager::Instance().FindThread(MAIN_THREAD_ID)), _durationCast); }
+
+} // namespace profiler
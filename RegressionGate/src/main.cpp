@@ -0,0 +1,338 @@
+#include <algorithm>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <stdexcept>
+
+#include "config.h"
+#include "fingerprint.h"
+#include "harness.h"
+#include "json.h"
+#include "statistics.h"
+#include "strategies.h"
+
+/*
+	Performance regression gate.
+	Runs a fixed benchmark profile of every strategy, engine and kernel and compares the throughput of every repetition against a baseline recorded earlier.
+	A combination regresses when a one-sided Mann-Whitney U test says its samples/s are lower than the baseline's with p < alpha
+	and its median dropped by more than the tolerance, so that neither noise nor a statistically significant but negligible change fails the gate.
+	The profile is fixed, worker count included, so that the baseline's entries can be found whatever machine the gate runs on: a combination missing from the baseline fails the gate rather than passing unchecked.
+	Baselines are recorded from optimized builds only, the throughput of a debug build says nothing about the code that ships, and on a budget of at least PROFILE_WORKERS cpus so that the workers don't time-share.
+	A baseline recorded on another cpu, another cpu budget, another build type or instrumentation level isn't compared against at all: record one on the gating machine.
+	Exit code: 0 when nothing regressed, 2 when something did, 1 on usage errors and on baselines that can't be compared against.
+*/
+
+constexpr const size_t PROFILE_ITERATIONS = 1000000;
+constexpr const size_t PROFILE_WORKERS = 4; // Not the detected cpu budget, which differs from host to host.
+
+#ifndef PI_BASELINE_PATH
+#define PI_BASELINE_PATH "baseline.json" // CMake points this to RegressionGate/baseline.json in the source tree.
+#endif // PI_BASELINE_PATH
+
+struct GateSettings
+{
+	std::string mode = "check"; // "check" or "record".
+	std::string baselinePath = PI_BASELINE_PATH;
+	double alpha = 0.01; // Significance level of the test.
+	double tolerance = 0.03; // Smallest relative drop of the median worth failing the gate for.
+};
+
+// Measured throughput of one combination of the profile.
+struct GateEntry
+{
+	std::string key; // Identifies the combination, entries of the baseline and of the current run are matched on it.
+	std::string strategy;
+	std::string engine;
+	std::string kernel;
+	size_t iterations = 0;
+	size_t workers = 0;
+	std::vector<double> samplesPerSecond; // One value per repetition.
+};
+
+const char* GateUsage()
+{
+	return
+		"Regression gate specific settings:\n"
+		"  --mode=<check|record>    Compare against the baseline, or overwrite it with this run (default check).\n"
+		"  --baseline=<file>        Baseline to compare against or to record (default: RegressionGate/baseline.json in the source tree).\n"
+		"  --alpha=<p>              Significance level of the Mann-Whitney U test (default 0.01).\n"
+		"  --tolerance=<ratio>      Smallest median drop that counts as a regression, 0.03 for 3% (default 0.03).\n"
+		"The profile defaults to the working implementation, 1e6 iterations, 4 workers, 2 warmups and 10 repetitions, the other settings are the Application's.\n"
+		"Combinations missing from the baseline fail the gate, record a new baseline from a Release build after changing the profile.\n";
+}
+
+double ParseFraction(const std::string& name, const std::string& value)
+{
+	size_t consumed = 0;
+	double parsed = -1.0;
+	try
+	{
+		parsed = std::stod(value, &consumed);
+	}
+	catch (const std::exception&)
+	{
+		consumed = 0;
+	}
+	if (consumed != value.size() || parsed < 0.0 || parsed >= 1.0) throw std::invalid_argument("--" + name + " expects a number in [0, 1), got \"" + value + "\".");
+	return parsed;
+}
+
+// Fields of the fingerprint that make throughputs meaningless to compare when they differ, the gate refuses to.
+constexpr const char* REQUIRED_FIELDS[] = { "cpu_model", "hardware_threads", "affinity_cpus", "build_type", "instrumentation" };
+// Fields of the fingerprint that make throughputs less comparable when they differ, the gate warns about them.
+constexpr const char* COMPARABILITY_FIELDS[] = { "microcode", "kernel", "compiler", "compiler_flags", "isa_compiled", "cgroup_cpu_quota", "governor", "turbo", "smt" };
+
+// Whether the fingerprint's build had optimizations, false for baselines predating the compiler_flags field too.
+bool Optimized(const EnvironmentFingerprint& fingerprint)
+{
+	for (const std::string& warning : fingerprint.warnings)
+	{
+		if (warning.find("built without optimizations") != std::string::npos) return false;
+	}
+	return fingerprint.Get("compiler_flags").find("(optimized)") != std::string::npos;
+}
+
+void WriteBaseline(const std::vector<GateEntry>& entries, const EnvironmentFingerprint& fingerprint, const std::string& path)
+{
+	std::ofstream file(path);
+	if (!file) throw std::runtime_error("Can't write baseline \"" + path + "\".");
+	file << "{\n\t\"version\": 1,\n\t\"environment\": " << FingerprintJson(fingerprint) << ",\n\t\"entries\": [\n";
+	for (size_t i = 0; i < entries.size(); i++)
+	{
+		const GateEntry& entry = entries[i];
+		file << "\t\t{ \"key\": " << JsonString(entry.key) << ", \"strategy\": " << JsonString(entry.strategy) << ", \"engine\": " << JsonString(entry.engine)
+			<< ", \"kernel\": " << JsonString(entry.kernel) << ", \"iterations\": " << entry.iterations << ", \"workers\": " << entry.workers << ", \"samples_per_second\": [";
+		for (size_t j = 0; j < entry.samplesPerSecond.size(); j++)
+		{
+			file << (j ? ", " : "") << JsonNumber(entry.samplesPerSecond[j]);
+		}
+		file << "] }" << (i + 1 < entries.size() ? "," : "") << "\n";
+	}
+	file << "\t]\n}\n";
+}
+
+std::vector<GateEntry> ReadBaseline(const std::string& path, EnvironmentFingerprint& fingerprint)
+{
+	std::ifstream file(path);
+	if (!file) throw std::runtime_error("Can't open baseline \"" + path + "\", record one with --mode=record.");
+	std::stringstream text;
+	text << file.rdbuf();
+
+	const JsonValue root = ParseJson(text.str());
+	const JsonValue* list = root.Find("entries");
+	if (!list || list->type != JsonValue::Type::Array) throw std::runtime_error("Baseline \"" + path + "\" has no entries.");
+
+	if (const JsonValue* environment = root.Find("environment")) fingerprint = FingerprintFromJson(*environment);
+
+	std::vector<GateEntry> entries;
+	for (const JsonValue& item : list->items)
+	{
+		GateEntry entry;
+		entry.key = item.StringOr("key", "");
+		entry.strategy = item.StringOr("strategy", "");
+		entry.engine = item.StringOr("engine", "");
+		entry.kernel = item.StringOr("kernel", "");
+		entry.iterations = (size_t)item.NumberOr("iterations", 0.0);
+		entry.workers = (size_t)item.NumberOr("workers", 0.0);
+		if (const JsonValue* values = item.Find("samples_per_second"))
+		{
+			for (const JsonValue& value : values->items)
+			{
+				if (value.type == JsonValue::Type::Number) entry.samplesPerSecond.push_back(value.number);
+			}
+		}
+		entries.push_back(entry);
+	}
+	return entries;
+}
+
+int main(int argc, char* argv[])
+{
+	BenchmarkConfig defaults;
+	defaults.implementations = { "working" }; // The exercise is meant to be work in progress.
+	defaults.iterations = { PROFILE_ITERATIONS };
+	defaults.workers = { PROFILE_WORKERS };
+	defaults.warmups = 2;
+	defaults.repetitions = 10;
+	defaults.counters = false;
+
+	GateSettings gate;
+	BenchmarkConfig config;
+	try
+	{
+		config = ParseConfig(argc, argv, defaults, [&gate](const std::string& name, const std::string& value)
+		{
+			if (name == "mode")
+			{
+				static constexpr const char* MODES[] = { "check", "record" };
+				const std::vector<std::string> mode = ParseChoices(name, value, MODES);
+				if (mode.size() != 1) throw std::invalid_argument("--mode takes a single value.");
+				gate.mode = mode[0];
+			}
+			else if (name == "baseline") gate.baselinePath = value;
+			else if (name == "alpha") gate.alpha = ParseFraction(name, value);
+			else if (name == "tolerance") gate.tolerance = ParseFraction(name, value);
+			else return false;
+			return true;
+		});
+	}
+	catch (const std::invalid_argument& e)
+	{
+		std::cerr << e.what() << std::endl << ConfigUsage() << GateUsage();
+		return 1;
+	}
+	if (config.help)
+	{
+		std::cout << ConfigUsage() << GateUsage();
+		return 0;
+	}
+	if (config.repetitions < 3) std::cout << "Warning: with fewer than 3 repetitions the test can't reach significance, nothing will be flagged." << std::endl;
+
+	const EnvironmentFingerprint fingerprint = CaptureFingerprint(config);
+	PrintFingerprint(std::cout, fingerprint);
+	if (gate.mode == "record" && !Optimized(fingerprint))
+	{
+		std::cerr << "Refusing to record a baseline from a build without optimizations, build in Release." << std::endl;
+		return 1;
+	}
+	const size_t budget = DetectCpuBudget().effective;
+	if (gate.mode == "record" && budget < *std::max_element(config.workers.begin(), config.workers.end()))
+	{
+		std::cerr << "Refusing to record a baseline on a budget of " << budget << " cpus, the workers would time-share: record it on the gating machine." << std::endl;
+		return 1;
+	}
+
+	// Read before measuring, a baseline that can't be compared against fails the gate right away.
+	EnvironmentFingerprint recorded;
+	std::vector<GateEntry> baseline;
+	if (gate.mode != "record")
+	{
+		try
+		{
+			baseline = ReadBaseline(gate.baselinePath, recorded);
+			if (!Optimized(recorded)) throw std::runtime_error("Baseline \"" + gate.baselinePath + "\" was recorded from a build without optimizations, record it again from a Release build.");
+			for (const char* field : REQUIRED_FIELDS)
+			{
+				if (recorded.Get(field) != fingerprint.Get(field))
+				{
+					throw std::runtime_error(std::string(field) + " differs from the baseline's (\"" + recorded.Get(field) + "\" then, \"" + fingerprint.Get(field) + "\" now), record a baseline on this machine.");
+				}
+			}
+		}
+		catch (const std::runtime_error& e)
+		{
+			std::cerr << e.what() << std::endl;
+			return 1;
+		}
+	}
+
+	StrategyOptions options;
+	options.placement = config.placement;
+
+	std::vector<GateEntry> current;
+	for (const Strategy* strategy : SelectStrategies(config))
+	{
+		for (const std::string& engine : config.engines)
+		{
+			for (const std::string& kernel : config.kernels)
+			{
+				for (const size_t iterations : config.iterations)
+				{
+					const std::vector<size_t> workerCounts = strategy->multithreaded ? config.workers : std::vector<size_t>{ 1 };
+					for (const size_t workers : workerCounts)
+					{
+						GateEntry entry;
+						entry.strategy = strategy->FullName();
+						entry.engine = engine;
+						entry.kernel = kernel;
+						entry.iterations = iterations;
+						entry.workers = workers;
+						entry.key = entry.strategy + " engine=" + engine + " kernel=" + kernel + " iterations=" + std::to_string(iterations) + " workers=" + std::to_string(workers);
+
+						const size_t samples = iterations;
+						const Measurement measurement = Measure([&]() { return strategy->run(iterations, workers, options); }, samples, config.warmups, config.repetitions);
+						for (const double ns : measurement.runs)
+						{
+							entry.samplesPerSecond.push_back((double)samples / (ns * 1e-9));
+						}
+						std::cout << "Measured " << entry.key << ": median " << std::fixed << std::setprecision(0) << (double)samples / (measurement.ns.median * 1e-9) << " samples/s" << std::endl;
+						std::cout.unsetf(std::ios::floatfield);
+						current.push_back(entry);
+					}
+				}
+			}
+		}
+	}
+
+	try
+	{
+		if (gate.mode == "record")
+		{
+			WriteBaseline(current, fingerprint, gate.baselinePath);
+			std::cout << "Recorded " << current.size() << " entries as the new baseline in " << gate.baselinePath << "." << std::endl;
+			return 0;
+		}
+
+		for (const char* field : COMPARABILITY_FIELDS)
+		{
+			if (recorded.Get(field) != fingerprint.Get(field))
+			{
+				std::cout << "Warning: " << field << " differs from the baseline's (\"" << recorded.Get(field) << "\" then, \"" << fingerprint.Get(field) << "\" now), the comparison may not be meaningful." << std::endl;
+			}
+		}
+		size_t regressions = 0;
+		size_t missing = 0;
+		std::cout << std::endl;
+		for (const GateEntry& entry : current)
+		{
+			const GateEntry* reference = nullptr;
+			for (const GateEntry& candidate : baseline)
+			{
+				if (candidate.key == entry.key) reference = &candidate;
+			}
+			if (!reference || reference->samplesPerSecond.empty())
+			{
+				std::cout << "NO BASELINE " << entry.key << std::endl;
+				missing++;
+				continue;
+			}
+
+			const double before = Summarize(reference->samplesPerSecond).median;
+			const double after = Summarize(entry.samplesPerSecond).median;
+			const double change = before > 0.0 ? after / before - 1.0 : 0.0;
+			const RankTest slower = MannWhitneyLess(entry.samplesPerSecond, reference->samplesPerSecond);
+			const RankTest faster = MannWhitneyLess(reference->samplesPerSecond, entry.samplesPerSecond);
+
+			const char* verdict = "ok         ";
+			if (slower.pValue < gate.alpha && change < -gate.tolerance)
+			{
+				verdict = "REGRESSION ";
+				regressions++;
+			}
+			else if (faster.pValue < gate.alpha && change > gate.tolerance)
+			{
+				verdict = "improvement";
+			}
+			std::cout << verdict << " " << entry.key << ": " << std::fixed << std::setprecision(1) << std::showpos << change * 100.0 << std::noshowpos
+				<< "% median samples/s, p = " << std::setprecision(4) << std::min(slower.pValue, faster.pValue) << (slower.exact ? " (exact)" : " (normal approximation)") << std::endl;
+			std::cout.unsetf(std::ios::floatfield);
+		}
+
+		std::cout << std::endl << (regressions ? std::to_string(regressions) + " significant regression(s) against " : std::string("No significant regression against ")) << gate.baselinePath << "." << std::endl;
+		if (regressions) return 2;
+		if (missing)
+		{
+			std::cerr << missing << " combination(s) of the profile have no baseline, they went unchecked." << std::endl;
+			return 1;
+		}
+		return 0;
+	}
+	catch (const std::runtime_error& e)
+	{
+		std::cerr << e.what() << std::endl;
+		return 1;
+	}
+}
@@ -0,0 +1,284 @@
+#include <iostream>
+#include <fstream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <limits>
+#include <stdexcept>
+
+#include "config.h"
+#include "fingerprint.h"
+#include "harness.h"
+#include "json.h"
+#include "precision.h"
+#include "strategies.h"
+
+/*
+	Strong and weak scaling sweep of every strategy.
+	Strong scaling keeps the total number of samples fixed while adding workers, weak scaling keeps the number of samples per worker fixed.
+	Speedups are relative to the same strategy running with a single worker, which is why 1 is always part of the worker counts.
+*/
+
+constexpr const double NOT_APPLICABLE = std::numeric_limits<double>::quiet_NaN();
+
+struct SweepPoint
+{
+	std::string mode; // "strong" or "weak".
+	const Strategy* strategy = nullptr;
+	size_t workers = 1;
+	size_t iterations = 0; // Swept value, the total in strong mode and per worker in weak mode.
+	size_t samplesPerWorker = 0; // Even share of a worker, the first samples % workers draw one more.
+	size_t samples = 0; // Total number of samples the last run actually drew, the work the cell is credited with.
+	Measurement measurement;
+	double speedup = NOT_APPLICABLE; // Strong: T(1) / T(p). Weak: the scaled speedup p * T(1) / T(p).
+	double efficiency = NOT_APPLICABLE; // Speedup / p.
+	double karpFlatt = NOT_APPLICABLE; // Experimentally determined serial fraction (1/S - 1/p) / (1 - 1/p), only defined for p > 1.
+	Precision precision; // Configurations are ranked by precision.secondsToTarget.
+};
+
+struct SweepSettings
+{
+	std::vector<std::string> modes = { "strong", "weak" };
+	std::string csvPath;
+	std::string jsonPath;
+};
+
+const char* SweepUsage()
+{
+	return
+		"Scaling sweep specific settings:\n"
+		"  --modes=<...>            strong, weak (default: both).\n"
+		"  --csv=<file>             Also write the results as CSV.\n"
+		"  --json=<file>            Also write the results as JSON.\n"
+		"Defaults differ from the Application's: iterations sweep 1e3 to 1e11 in decades, workers sweep powers of two up to all usable logical CPUs, 3 repetitions.\n"
+		"In weak mode the iteration counts are per worker.\n"
+		"Configurations are ranked by the time they need to reach the --precision target.\n";
+}
+
+// Fills in speedup, efficiency and serial fraction from the 1 worker point of the same mode, strategy and iteration count.
+// Speedups are ratios of the samples drawn per second, so that a cell is only credited with the work it actually did: T(1) / T(p) in strong mode, p * T(1) / T(p) in weak mode, when every sample is drawn.
+void ComputeScaling(std::vector<SweepPoint>& points)
+{
+	for (SweepPoint& point : points)
+	{
+		for (const SweepPoint& baseline : points)
+		{
+			if (baseline.workers != 1 || baseline.mode != point.mode || baseline.strategy != point.strategy || baseline.iterations != point.iterations) continue;
+			if (point.measurement.ns.median <= 0.0) break;
+
+			const double p = (double)point.workers;
+			point.speedup = ((double)point.samples / point.measurement.ns.median) / ((double)baseline.samples / baseline.measurement.ns.median);
+			point.efficiency = point.speedup / p;
+			if (point.workers > 1) point.karpFlatt = (1.0 / point.speedup - 1.0 / p) / (1.0 - 1.0 / p);
+			break;
+		}
+	}
+}
+
+std::string Format(const double value, const int precision)
+{
+	if (value != value) return "-"; // NaN, not applicable.
+	std::ostringstream ss;
+	ss << std::fixed << std::setprecision(precision) << value;
+	return ss.str();
+}
+
+void PrintTable(const std::vector<SweepPoint>& points)
+{
+	std::cout << std::endl << std::left
+		<< std::setw(7) << "mode" << std::setw(24) << "strategy" << std::right << std::setw(8) << "workers" << std::setw(16) << "samples" << std::setw(16) << "median ns"
+		<< std::setw(16) << "samples/s" << std::setw(9) << "speedup" << std::setw(11) << "efficiency" << std::setw(11) << "karp-flatt" << "  stability" << std::endl;
+	for (const SweepPoint& point : points)
+	{
+		std::cout << std::left << std::setw(7) << point.mode << std::setw(24) << point.strategy->FullName() << std::right
+			<< std::setw(8) << point.workers << std::setw(16) << point.samples << std::setw(16) << Format(point.measurement.ns.median, 0)
+			<< std::setw(16) << Format(point.measurement.samplesPerSecond, 0) << std::setw(9) << Format(point.speedup, 2)
+			<< std::setw(11) << Format(point.efficiency, 3) << std::setw(11) << Format(point.karpFlatt, 3)
+			<< "  " << (point.measurement.TooFewRuns() ? "too few runs" : point.measurement.Unstable() ? "UNSTABLE" : "ok") << std::endl;
+	}
+}
+
+// Lists the configurations of every mode from the fastest to reach the precision target to the slowest.
+void PrintRanking(const std::vector<SweepPoint>& points, const std::vector<std::string>& modes)
+{
+	for (const std::string& mode : modes)
+	{
+		std::vector<const SweepPoint*> ranked;
+		for (const SweepPoint& point : points)
+		{
+			if (point.mode == mode) ranked.push_back(&point);
+		}
+		if (ranked.empty()) continue;
+		std::stable_sort(ranked.begin(), ranked.end(), [](const SweepPoint* a, const SweepPoint* b)
+		{
+			const double x = a->precision.secondsToTarget, y = b->precision.secondsToTarget;
+			return x == x && (y != y || x < y); // Unknown times last.
+		});
+
+		std::cout << std::endl << "Ranking of the " << mode << " scaling configurations by time to +-" << ranked.front()->precision.target << " at 95% confidence:" << std::endl;
+		for (size_t i = 0; i < ranked.size(); i++)
+		{
+			const SweepPoint& point = *ranked[i];
+			std::cout << std::right << std::setw(4) << i + 1 << ". " << std::left << std::setw(24) << point.strategy->FullName() << std::right << std::setw(5) << point.workers << " workers"
+				<< std::setw(16) << point.samples << " samples: " << std::setw(12) << Format(point.precision.secondsToTarget, 3) << " s, standard error "
+				<< std::scientific << std::setprecision(2) << point.precision.standardError << ", observed error " << point.precision.observedError << std::endl;
+			std::cout.unsetf(std::ios::floatfield);
+		}
+	}
+}
+
+// False if the file can't be opened or written.
+bool WriteCsv(const std::vector<SweepPoint>& points, const EnvironmentFingerprint& fingerprint, const std::string& path)
+{
+	std::ofstream file(path);
+	if (!file) return false;
+	for (const auto& [name, value] : fingerprint.fields)
+	{
+		file << "# " << name << ": " << value << "\n"; // The environment as comment lines, most CSV readers can skip them.
+	}
+	file << "mode,implementation,strategy,workers,samples_per_worker,samples,runs,min_ns,median_ns,mean_ns,stddev_ns,p99_ns,samples_per_second,speedup,efficiency,karp_flatt,unstable,standard_error,observed_error,precision_target,seconds_to_target\n";
+	for (const SweepPoint& point : points)
+	{
+		const Summary& ns = point.measurement.ns;
+		file << point.mode << ',' << point.strategy->implementation << ',' << point.strategy->name << ',' << point.workers << ',' << point.samplesPerWorker << ',' << point.samples << ','
+			<< ns.count << ',' << JsonNumber(ns.min) << ',' << JsonNumber(ns.median) << ',' << JsonNumber(ns.mean) << ',' << JsonNumber(ns.stddev) << ',' << JsonNumber(ns.p99) << ','
+			<< JsonNumber(point.measurement.samplesPerSecond) << ',' << (point.speedup == point.speedup ? JsonNumber(point.speedup) : "") << ','
+			<< (point.efficiency == point.efficiency ? JsonNumber(point.efficiency) : "") << ',' << (point.karpFlatt == point.karpFlatt ? JsonNumber(point.karpFlatt) : "") << ','
+			<< (point.measurement.Unstable() ? "true" : "false") << ',' << JsonNumber(point.precision.standardError) << ',' << JsonNumber(point.precision.observedError) << ','
+			<< JsonNumber(point.precision.target) << ',' << JsonNumber(point.precision.secondsToTarget) << '\n';
+	}
+	return (bool)file.flush();
+}
+
+bool WriteJson(const std::vector<SweepPoint>& points, const EnvironmentFingerprint& fingerprint, const std::string& path)
+{
+	std::ofstream file(path);
+	if (!file) return false;
+	file << "{\n\t\"environment\": " << FingerprintJson(fingerprint) << ",\n\t\"points\": [\n";
+	for (size_t i = 0; i < points.size(); i++)
+	{
+		const SweepPoint& point = points[i];
+		const Summary& ns = point.measurement.ns;
+		file << "\t\t{ \"mode\": " << JsonString(point.mode) << ", \"implementation\": " << JsonString(point.strategy->implementation) << ", \"strategy\": " << JsonString(point.strategy->name)
+			<< ", \"workers\": " << point.workers << ", \"samples_per_worker\": " << point.samplesPerWorker << ", \"samples\": " << point.samples
+			<< ", \"runs\": " << ns.count << ", \"min_ns\": " << JsonNumber(ns.min) << ", \"median_ns\": " << JsonNumber(ns.median) << ", \"mean_ns\": " << JsonNumber(ns.mean)
+			<< ", \"stddev_ns\": " << JsonNumber(ns.stddev) << ", \"p99_ns\": " << JsonNumber(ns.p99) << ", \"samples_per_second\": " << JsonNumber(point.measurement.samplesPerSecond)
+			<< ", \"speedup\": " << JsonNumber(point.speedup) << ", \"efficiency\": " << JsonNumber(point.efficiency) << ", \"karp_flatt\": " << JsonNumber(point.karpFlatt)
+			<< ", \"unstable\": " << (point.measurement.Unstable() ? "true" : "false") << ", \"standard_error\": " << JsonNumber(point.precision.standardError)
+			<< ", \"observed_error\": " << JsonNumber(point.precision.observedError) << ", \"precision_target\": " << JsonNumber(point.precision.target)
+			<< ", \"seconds_to_target\": " << JsonNumber(point.precision.secondsToTarget) << " }" << (i + 1 < points.size() ? "," : "") << "\n";
+	}
+	file << "\t]\n}\n";
+	return (bool)file.flush();
+}
+
+int main(int argc, char* argv[])
+{
+	BenchmarkConfig defaults;
+	defaults.iterations.clear();
+	for (double decade = 1e3; decade <= 1e11; decade *= 10.0)
+	{
+		defaults.iterations.push_back((size_t)decade);
+	}
+	defaults.workers.clear();
+	const size_t logicalCpus = AllowedCpus().size();
+	for (size_t workers = 1; workers < logicalCpus; workers *= 2)
+	{
+		defaults.workers.push_back(workers);
+	}
+	defaults.workers.push_back(logicalCpus);
+	defaults.repetitions = 3;
+
+	SweepSettings sweep;
+	BenchmarkConfig config;
+	try
+	{
+		config = ParseConfig(argc, argv, defaults, [&sweep](const std::string& name, const std::string& value)
+		{
+			if (name == "modes")
+			{
+				static constexpr const char* MODES[] = { "strong", "weak" };
+				sweep.modes = ParseChoices(name, value, MODES);
+			}
+			else if (name == "csv") sweep.csvPath = value;
+			else if (name == "json") sweep.jsonPath = value;
+			else return false;
+			return true;
+		});
+	}
+	catch (const std::invalid_argument& e)
+	{
+		std::cerr << e.what() << std::endl << ConfigUsage() << SweepUsage();
+		return 1;
+	}
+	if (config.help)
+	{
+		std::cout << ConfigUsage() << SweepUsage();
+		return 0;
+	}
+	if (std::find(config.workers.begin(), config.workers.end(), 1) == config.workers.end())
+	{
+		config.workers.insert(config.workers.begin(), 1); // Every speedup is relative to the 1 worker run.
+	}
+
+	const EnvironmentFingerprint fingerprint = CaptureFingerprint(config);
+	PrintFingerprint(std::cout, fingerprint);
+
+	StrategyOptions options;
+	options.placement = config.placement;
+	ProgressBoard progress; // What the last run of a cell actually drew, grown by the strategies as needed since nothing reads it concurrently.
+	options.progress = &progress;
+
+	std::vector<SweepPoint> points;
+	for (const std::string& mode : sweep.modes)
+	{
+		for (const Strategy* strategy : SelectStrategies(config))
+		{
+			for (const size_t iterations : config.iterations)
+			{
+				const std::vector<size_t> workerCounts = strategy->multithreaded ? config.workers : std::vector<size_t>{ 1 };
+				for (const size_t workers : workerCounts)
+				{
+					SweepPoint point;
+					point.mode = mode;
+					point.strategy = strategy;
+					point.workers = workers;
+					point.iterations = iterations;
+					const size_t total = mode == "strong" ? iterations : iterations * workers;
+					if (workers > total)
+					{
+						std::cout << mode << " " << strategy->FullName() << ", " << workers << " workers: skipped, fewer than " << workers << " samples to share." << std::endl;
+						continue;
+					}
+					point.samplesPerWorker = total / workers;
+					const std::function<size_t()> samplesDrawn = strategy->publishesProgress ? std::function<size_t()>([&progress]() { return progress.Totals().samples; }) : std::function<size_t()>();
+					point.measurement = Measure([&]() { return strategy->run(total, workers, options); }, total, config.warmups, config.repetitions, {}, samplesDrawn);
+					const ProgressTotals drawn = progress.Totals();
+					point.samples = strategy->publishesProgress ? drawn.samples : total;
+					const double estimate = strategy->publishesProgress ? PiEstimate(drawn.hits, drawn.samples) : (double)point.measurement.lastResult;
+					point.precision = ComputePrecision(strategy->variancePerSample, point.samples, estimate, point.measurement.samplesPerSecond, PrecisionTarget(config.precisionDigits));
+					points.push_back(point);
+
+					std::cout << mode << " " << strategy->FullName() << ", " << workers << " workers, " << point.samples << " samples: median " << Format(point.measurement.ns.median, 0)
+						<< " ns, " << Format(point.measurement.samplesPerSecond, 0) << " samples/s" << std::endl;
+				}
+			}
+		}
+	}
+
+	ComputeScaling(points);
+	PrintTable(points);
+	PrintRanking(points, sweep.modes);
+	if (!sweep.csvPath.empty() && !WriteCsv(points, fingerprint, sweep.csvPath))
+	{
+		std::cerr << "Can't write the sweep to " << sweep.csvPath << "." << std::endl;
+		return 1;
+	}
+	if (!sweep.jsonPath.empty() && !WriteJson(points, fingerprint, sweep.jsonPath))
+	{
+		std::cerr << "Can't write the sweep to " << sweep.jsonPath << "." << std::endl;
+		return 1;
+	}
+
+	return 0;
+}
@@ -0,0 +1,611 @@
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <map>
+#include <algorithm>
+#include <memory>
+#include <unordered_map>
+#include <utility>
+#include <cstdio>
+#include <cstring>
+
+#include "json.h"
+#include "profileReader.h"
+
+/*
+	Converts an easy_profiler capture to a trace a browser can open: Chrome's trace event JSON (chrome://tracing, ui.perfetto.dev) or a Perfetto protobuf trace (ui.perfetto.dev),
+	or to folded stacks for flame graphs, the format of "Application --sampling".
+	The capture is streamed a record at a time with ProfileReader, the same reader fillTreesFromFile() is built on, so memory only grows with the number of threads and descriptors, never with the size of the capture.
+	Blocks nest through their begin and end times, as in the capture. Thread names are kept, colours and source locations become arguments of the blocks, numeric values become counter tracks of their thread
+	and strings and arrays become instant events carrying the value.
+*/
+
+const char* ExportUsage()
+{
+	return
+		"Usage: TraceExport [settings] [<capture.prof>]\n"
+		"  <capture.prof>           Capture to convert (default profilerOutputs/session.prof).\n"
+		"  --format=<format>        json: Chrome trace event JSON, perfetto: Perfetto protobuf trace, folded: folded stacks of the blocks' self time in us (default json).\n"
+		"  --output=<file>          Where to write the trace (default: the capture's path with a .json, .perfetto-trace or .blocks.folded extension).\n"
+		"  --help                   Print this message.\n";
+}
+
+// "#rrggbb" of an easy_profiler ARGB colour.
+std::string ColorString(const profiler::color_t color)
+{
+	char buffer[8];
+	std::snprintf(buffer, sizeof(buffer), "#%06x", (unsigned)(color & 0xffffff));
+	return buffer;
+}
+
+std::string SourceString(const profiler::SerializedBlockDescriptor* descriptor)
+{
+	return descriptor ? std::string(descriptor->file()) + ":" + std::to_string(descriptor->line()) : std::string();
+}
+
+// Decoding of arbitrary values, see easy/arbitrary_value.h.
+size_t ElementSize(const profiler::DataType type)
+{
+	switch (type)
+	{
+		case profiler::DataType::Int16: case profiler::DataType::Uint16: return 2;
+		case profiler::DataType::Int32: case profiler::DataType::Uint32: case profiler::DataType::Float: return 4;
+		case profiler::DataType::Int64: case profiler::DataType::Uint64: case profiler::DataType::Double: return 8;
+		default: return 1;
+	}
+}
+
+template<typename T>
+double Load(const char* data)
+{
+	T value;
+	std::memcpy(&value, data, sizeof(T));
+	return (double)value;
+}
+
+double Element(const profiler::DataType type, const char* data)
+{
+	switch (type)
+	{
+		case profiler::DataType::Bool: return *data ? 1.0 : 0.0;
+		case profiler::DataType::Char: return (double)*data;
+		case profiler::DataType::Int8: return Load<int8_t>(data);
+		case profiler::DataType::Uint8: return Load<uint8_t>(data);
+		case profiler::DataType::Int16: return Load<int16_t>(data);
+		case profiler::DataType::Uint16: return Load<uint16_t>(data);
+		case profiler::DataType::Int32: return Load<int32_t>(data);
+		case profiler::DataType::Uint32: return Load<uint32_t>(data);
+		case profiler::DataType::Int64: return Load<int64_t>(data);
+		case profiler::DataType::Uint64: return Load<uint64_t>(data);
+		case profiler::DataType::Float: return Load<float>(data);
+		case profiler::DataType::Double: return Load<double>(data);
+		default: return 0.0;
+	}
+}
+
+// A scalar number fits a counter track, anything else is carried as text.
+bool IsScalar(const profiler::ArbitraryValue& value)
+{
+	return !value.isArray() && value.type() != profiler::DataType::String && value.data_size() >= ElementSize(value.type());
+}
+
+// JSON text of a string or array value.
+std::string ValueJson(const profiler::ArbitraryValue& value)
+{
+	if (value.type() == profiler::DataType::String) return JsonString(std::string(value.data(), strnlen(value.data(), value.data_size())));
+	const size_t size = ElementSize(value.type());
+	std::string json = "[";
+	for (size_t at = 0; at + size <= value.data_size(); at += size)
+	{
+		json += (at ? "," : "") + JsonNumber(Element(value.type(), value.data() + at));
+	}
+	return json + "]";
+}
+
+// Receives the capture as it's read and writes it out in some trace format.
+class TraceWriter
+{
+public:
+	virtual ~TraceWriter() = default;
+
+	virtual void Process(uint64_t pid, const std::string& name) = 0;
+	virtual void Thread(profiler::thread_id_t tid, const std::string& name) = 0; // The records that follow belong to it.
+	virtual void Slice(const ProfileRecord& record) = 0;
+	virtual void Instant(const ProfileRecord& record) = 0;
+	virtual void Value(const ProfileRecord& record) = 0;
+	virtual bool Finish() = 0;
+};
+
+/*
+	Chrome's trace event format, https://docs.google.com/document/d/1CvAClvFfyA5R-PhYUmn5OOQtYMH4h6I0nSsKchNAySU
+	Blocks are complete ("X") events, viewers nest them by time on their own whatever order they come in.
+*/
+class JsonTraceWriter : public TraceWriter
+{
+public:
+	JsonTraceWriter(std::ostream& out, const std::string& capture) : out_(out)
+	{
+		out_ << "{\"displayTimeUnit\":\"ns\",\"otherData\":{\"capture\":" << JsonString(capture) << ",\"version\":" << JsonString(PROFILE_VERSION_NAME) << "},\"traceEvents\":[\n";
+	}
+
+	void Process(const uint64_t pid, const std::string& name) override
+	{
+		pid_ = pid;
+		Metadata("process_name", 0, name);
+	}
+
+	void Thread(const profiler::thread_id_t tid, const std::string& name) override
+	{
+		tid_ = tid;
+		threadName_ = name.empty() ? "Thread " + std::to_string(tid) : name;
+		Metadata("thread_name", tid, threadName_);
+	}
+
+	void Slice(const ProfileRecord& record) override
+	{
+		Open(record.Name(), "X", record.Block().begin());
+		out_ << ",\"dur\":" << Microseconds(record.Block().duration()) << ",\"cat\":\"block\"";
+		Args(record, std::string());
+	}
+
+	void Instant(const ProfileRecord& record) override
+	{
+		Open(record.Name(), "i", record.Block().begin());
+		out_ << ",\"s\":\"t\",\"cat\":\"event\"";
+		Args(record, std::string());
+	}
+
+	void Value(const ProfileRecord& record) override
+	{
+		const profiler::ArbitraryValue& value = record.Value();
+		if (IsScalar(value))
+		{
+			// Counters belong to the process in this format, the thread's name keeps those of every worker apart.
+			Open(std::string(record.Name()) + " (" + threadName_ + ")", "C", value.begin());
+			out_ << ",\"cat\":\"value\",\"args\":{\"value\":" << JsonNumber(Element(value.type(), value.data())) << "}}";
+			return;
+		}
+		Open(record.Name(), "i", value.begin());
+		out_ << ",\"s\":\"t\",\"cat\":\"value\"";
+		Args(record, ValueJson(value));
+	}
+
+	bool Finish() override
+	{
+		out_ << "\n]}\n";
+		return (bool)out_.flush();
+	}
+
+private:
+	// Trace event timestamps are microseconds, written with their nanoseconds rather than through a double that would round them.
+	static std::string Microseconds(const profiler::timestamp_t ns)
+	{
+		char buffer[32];
+		std::snprintf(buffer, sizeof(buffer), "%llu.%03u", (unsigned long long)(ns / 1000), (unsigned)(ns % 1000));
+		return buffer;
+	}
+
+	void Separate()
+	{
+		if (!first_) out_ << ",\n";
+		first_ = false;
+	}
+
+	void Metadata(const char* kind, const profiler::thread_id_t tid, const std::string& name)
+	{
+		Separate();
+		out_ << "{\"name\":\"" << kind << "\",\"ph\":\"M\",\"pid\":" << pid_ << ",\"tid\":" << tid << ",\"args\":{\"name\":" << JsonString(name) << "}}";
+	}
+
+	void Open(const std::string& name, const char* phase, const profiler::timestamp_t ns)
+	{
+		Separate();
+		out_ << "{\"name\":" << JsonString(name) << ",\"ph\":\"" << phase << "\",\"pid\":" << pid_ << ",\"tid\":" << tid_ << ",\"ts\":" << Microseconds(ns);
+	}
+
+	void Args(const ProfileRecord& record, const std::string& valueJson)
+	{
+		out_ << ",\"args\":{";
+		if (record.descriptor) out_ << "\"color\":\"" << ColorString(record.descriptor->color()) << "\",\"source\":" << JsonString(SourceString(record.descriptor));
+		if (!valueJson.empty()) out_ << (record.descriptor ? "," : "") << "\"value\":" << valueJson;
+		out_ << "}}";
+	}
+
+	std::ostream& out_;
+	bool first_ = true;
+	uint64_t pid_ = 0;
+	profiler::thread_id_t tid_ = 0;
+	std::string threadName_;
+};
+
+// Just enough protobuf writing for Perfetto's trace packets, there's no need for the whole protobuf library.
+class ProtoMessage
+{
+public:
+	ProtoMessage& Varint(const uint32_t field, const uint64_t value)
+	{
+		Key(field, 0);
+		PutVarint(value);
+		return *this;
+	}
+
+	ProtoMessage& Double(const uint32_t field, const double value)
+	{
+		Key(field, 1);
+		char bytes[sizeof(value)];
+		std::memcpy(bytes, &value, sizeof(value)); // Little-endian like the captures themselves.
+		data_.append(bytes, sizeof(bytes));
+		return *this;
+	}
+
+	ProtoMessage& Bytes(const uint32_t field, const std::string& bytes)
+	{
+		Key(field, 2);
+		PutVarint(bytes.size());
+		data_ += bytes;
+		return *this;
+	}
+
+	ProtoMessage& Message(const uint32_t field, const ProtoMessage& message) { return Bytes(field, message.data_); }
+
+	const std::string& Data() const { return data_; }
+
+private:
+	void Key(const uint32_t field, const uint32_t wireType) { PutVarint(((uint64_t)field << 3) | wireType); }
+
+	void PutVarint(uint64_t value)
+	{
+		while (value >= 0x80)
+		{
+			data_ += (char)((value & 0x7f) | 0x80);
+			value >>= 7;
+		}
+		data_ += (char)value;
+	}
+
+	std::string data_;
+};
+
+/*
+	Perfetto's protobuf trace, https://perfetto.dev/docs/reference/trace-packet-proto
+	A trace is a sequence of TracePacket, each written as soon as its record is read: track descriptors for the process, its threads and their counters, and track events on them.
+	Blocks are a begin and an end event, the trace processor sorts events by time when it loads the trace.
+*/
+class PerfettoTraceWriter : public TraceWriter
+{
+public:
+	explicit PerfettoTraceWriter(std::ostream& out) : out_(out) {}
+
+	void Process(const uint64_t pid, const std::string& name) override
+	{
+		pid_ = pid;
+		ProtoMessage process;
+		process.Varint(PROCESS_PID, pid).Bytes(PROCESS_NAME, name);
+		ProtoMessage track;
+		track.Varint(TRACK_UUID, PROCESS_UUID).Message(TRACK_PROCESS, process);
+		ProtoMessage packet;
+		packet.Varint(PACKET_SEQUENCE_ID, SEQUENCE_ID).Varint(PACKET_SEQUENCE_FLAGS, SEQ_INCREMENTAL_STATE_CLEARED).Message(PACKET_TRACK_DESCRIPTOR, track);
+		Write(packet);
+	}
+
+	void Thread(const profiler::thread_id_t tid, const std::string& name) override
+	{
+		tid_ = tid;
+		const auto [found, fresh] = threadTracks_.try_emplace(tid, nextUuid_);
+		threadTrack_ = found->second;
+		if (!fresh) return; // Already described, threads can show up more than once in a capture.
+		nextUuid_++;
+		ProtoMessage thread;
+		thread.Varint(THREAD_PID, pid_).Varint(THREAD_TID, tid);
+		if (!name.empty()) thread.Bytes(THREAD_NAME, name);
+		ProtoMessage track;
+		track.Varint(TRACK_UUID, threadTrack_).Varint(TRACK_PARENT_UUID, PROCESS_UUID).Message(TRACK_THREAD, thread);
+		ProtoMessage packet;
+		packet.Varint(PACKET_SEQUENCE_ID, SEQUENCE_ID).Message(PACKET_TRACK_DESCRIPTOR, track);
+		Write(packet);
+	}
+
+	void Slice(const ProfileRecord& record) override
+	{
+		Event(record.Block().begin(), Described(record, EVENT_SLICE_BEGIN, threadTrack_, "block"));
+		ProtoMessage end;
+		end.Varint(EVENT_TYPE, EVENT_SLICE_END).Varint(EVENT_TRACK_UUID, threadTrack_);
+		Event(record.Block().end(), end);
+	}
+
+	void Instant(const ProfileRecord& record) override
+	{
+		Event(record.Block().begin(), Described(record, EVENT_INSTANT, threadTrack_, "event"));
+	}
+
+	void Value(const ProfileRecord& record) override
+	{
+		const profiler::ArbitraryValue& value = record.Value();
+		if (!IsScalar(value))
+		{
+			ProtoMessage event = Described(record, EVENT_INSTANT, threadTrack_, "value");
+			event.Message(EVENT_DEBUG_ANNOTATIONS, Annotation("value", ValueJson(value)));
+			Event(value.begin(), event);
+			return;
+		}
+		ProtoMessage event;
+		event.Varint(EVENT_TYPE, EVENT_COUNTER).Varint(EVENT_TRACK_UUID, CounterTrack(record)).Double(EVENT_DOUBLE_COUNTER_VALUE, Element(value.type(), value.data()));
+		Event(value.begin(), event);
+	}
+
+	bool Finish() override { return (bool)out_.flush(); }
+
+private:
+	// Field numbers and enum values of perfetto/protos/perfetto/trace/.
+	static constexpr uint32_t TRACE_PACKET = 1;
+	static constexpr uint32_t PACKET_TIMESTAMP = 8;
+	static constexpr uint32_t PACKET_SEQUENCE_ID = 10;
+	static constexpr uint32_t PACKET_TRACK_EVENT = 11;
+	static constexpr uint32_t PACKET_SEQUENCE_FLAGS = 13;
+	static constexpr uint32_t PACKET_TRACK_DESCRIPTOR = 60;
+	static constexpr uint32_t TRACK_UUID = 1;
+	static constexpr uint32_t TRACK_NAME = 2;
+	static constexpr uint32_t TRACK_PROCESS = 3;
+	static constexpr uint32_t TRACK_THREAD = 4;
+	static constexpr uint32_t TRACK_PARENT_UUID = 5;
+	static constexpr uint32_t TRACK_COUNTER = 8;
+	static constexpr uint32_t PROCESS_PID = 1;
+	static constexpr uint32_t PROCESS_NAME = 6;
+	static constexpr uint32_t THREAD_PID = 1;
+	static constexpr uint32_t THREAD_TID = 2;
+	static constexpr uint32_t THREAD_NAME = 5;
+	static constexpr uint32_t EVENT_DEBUG_ANNOTATIONS = 4;
+	static constexpr uint32_t EVENT_TYPE = 9;
+	static constexpr uint32_t EVENT_TRACK_UUID = 11;
+	static constexpr uint32_t EVENT_CATEGORIES = 22;
+	static constexpr uint32_t EVENT_NAME = 23;
+	static constexpr uint32_t EVENT_DOUBLE_COUNTER_VALUE = 44;
+	static constexpr uint32_t ANNOTATION_STRING_VALUE = 6;
+	static constexpr uint32_t ANNOTATION_NAME = 10;
+	static constexpr uint64_t EVENT_SLICE_BEGIN = 1;
+	static constexpr uint64_t EVENT_SLICE_END = 2;
+	static constexpr uint64_t EVENT_INSTANT = 3;
+	static constexpr uint64_t EVENT_COUNTER = 4;
+	static constexpr uint64_t SEQ_INCREMENTAL_STATE_CLEARED = 1;
+	static constexpr uint64_t SEQUENCE_ID = 1; // Everything is written by a single writer.
+	static constexpr uint64_t PROCESS_UUID = 1;
+
+	static ProtoMessage Annotation(const std::string& name, const std::string& value)
+	{
+		ProtoMessage annotation;
+		annotation.Bytes(ANNOTATION_NAME, name).Bytes(ANNOTATION_STRING_VALUE, value);
+		return annotation;
+	}
+
+	// Named event on a track, with the colour and the source location of its descriptor.
+	static ProtoMessage Described(const ProfileRecord& record, const uint64_t type, const uint64_t track, const std::string& category)
+	{
+		ProtoMessage event;
+		event.Varint(EVENT_TYPE, type).Varint(EVENT_TRACK_UUID, track).Bytes(EVENT_CATEGORIES, category).Bytes(EVENT_NAME, record.Name());
+		if (record.descriptor)
+		{
+			event.Message(EVENT_DEBUG_ANNOTATIONS, Annotation("color", ColorString(record.descriptor->color())));
+			event.Message(EVENT_DEBUG_ANNOTATIONS, Annotation("source", SourceString(record.descriptor)));
+		}
+		return event;
+	}
+
+	// Counter track of a value of the current thread, described the first time it's needed.
+	uint64_t CounterTrack(const ProfileRecord& record)
+	{
+		const auto [found, fresh] = counterTracks_.try_emplace({ tid_, record.Value().id() }, nextUuid_);
+		if (!fresh) return found->second;
+		nextUuid_++;
+		ProtoMessage track;
+		track.Varint(TRACK_UUID, found->second).Varint(TRACK_PARENT_UUID, threadTrack_).Bytes(TRACK_NAME, record.Name()).Message(TRACK_COUNTER, ProtoMessage());
+		ProtoMessage packet;
+		packet.Varint(PACKET_SEQUENCE_ID, SEQUENCE_ID).Message(PACKET_TRACK_DESCRIPTOR, track);
+		Write(packet);
+		return found->second;
+	}
+
+	void Event(const profiler::timestamp_t ns, const ProtoMessage& event)
+	{
+		ProtoMessage packet;
+		packet.Varint(PACKET_TIMESTAMP, ns).Varint(PACKET_SEQUENCE_ID, SEQUENCE_ID).Message(PACKET_TRACK_EVENT, event);
+		Write(packet);
+	}
+
+	void Write(const ProtoMessage& packet)
+	{
+		ProtoMessage trace;
+		trace.Message(TRACE_PACKET, packet); // A Trace is nothing but its repeated packets, they can be appended one by one.
+		out_.write(trace.Data().data(), (std::streamsize)trace.Data().size());
+	}
+
+	std::ostream& out_;
+	uint64_t pid_ = 0;
+	profiler::thread_id_t tid_ = 0;
+	uint64_t threadTrack_ = 0;
+	uint64_t nextUuid_ = PROCESS_UUID + 1;
+	std::unordered_map<profiler::thread_id_t, uint64_t> threadTracks_;
+	std::map<std::pair<profiler::thread_id_t, profiler::block_id_t>, uint64_t> counterTracks_;
+};
+
+/*
+	Folded stacks, "thread;block;nested block <weight>" per line, what flamegraph.pl, speedscope and inferno read and what "Application --sampling" writes.
+	Weights are the microseconds of the blocks' self time, their duration minus that of the blocks nested in them, summed over every block of the same path.
+	Threads of the same name fold together. Nesting needs all the blocks of a thread at once, so they're kept until the next thread starts.
+*/
+class FoldedTraceWriter : public TraceWriter
+{
+public:
+	explicit FoldedTraceWriter(std::ostream& out) : out_(out) {}
+
+	void Process(uint64_t, const std::string&) override {}
+
+	void Thread(const profiler::thread_id_t tid, const std::string& name) override
+	{
+		Fold();
+		threadName_ = name.empty() ? "Thread " + std::to_string(tid) : name;
+	}
+
+	void Slice(const ProfileRecord& record) override
+	{
+		blocks_.push_back({ record.Block().begin(), record.Block().end(), Frame(record.Name()) });
+	}
+
+	void Instant(const ProfileRecord&) override {}
+	void Value(const ProfileRecord&) override {}
+
+	bool Finish() override
+	{
+		Fold();
+		for (const auto& [path, ns] : selfNs_)
+		{
+			if (ns >= 1000) out_ << path << " " << ns / 1000 << "\n"; // Integer weights, as every flame graph tool reads them.
+		}
+		return (bool)out_.flush();
+	}
+
+private:
+	struct Block
+	{
+		profiler::timestamp_t begin;
+		profiler::timestamp_t end;
+		std::string name;
+	};
+
+	// Block names may hold the separators of the format.
+	static std::string Frame(const char* name)
+	{
+		std::string frame = name && *name ? name : "(unnamed)";
+		std::replace(frame.begin(), frame.end(), ';', ':');
+		std::replace(frame.begin(), frame.end(), '\n', ' ');
+		return frame;
+	}
+
+	// Nests the blocks of the thread read last by time and adds their self time to their paths.
+	void Fold()
+	{
+		std::sort(blocks_.begin(), blocks_.end(), [](const Block& a, const Block& b) { return a.begin != b.begin ? a.begin < b.begin : a.end > b.end; }); // Parents before their children.
+		std::vector<std::pair<const Block*, std::string>> open; // Enclosing blocks and their paths.
+		for (const Block& block : blocks_)
+		{
+			while (!open.empty() && (open.back().first->end < block.end || open.back().first->end <= block.begin)) open.pop_back();
+			const std::string& parent = open.empty() ? threadName_ : open.back().second;
+			const int64_t duration = (int64_t)(block.end - block.begin);
+			selfNs_[parent + ";" + block.name] += duration;
+			if (!open.empty()) selfNs_[parent] -= duration;
+			open.emplace_back(&block, parent + ";" + block.name);
+		}
+		blocks_.clear();
+	}
+
+	std::ostream& out_;
+	std::string threadName_;
+	std::vector<Block> blocks_;
+	std::map<std::string, int64_t> selfNs_; // Sorted, like the sampler's output.
+};
+
+// Path with its extension, if any, replaced.
+std::string ReplaceExtension(const std::string& path, const std::string& extension)
+{
+	const size_t slash = path.find_last_of("/\\");
+	const size_t dot = path.find_last_of('.');
+	const bool hasExtension = dot != std::string::npos && (slash == std::string::npos || dot > slash);
+	return (hasExtension ? path.substr(0, dot) : path) + extension;
+}
+
+std::string FileStem(const std::string& path)
+{
+	const size_t slash = path.find_last_of("/\\");
+	const std::string name = slash == std::string::npos ? path : path.substr(slash + 1);
+	return name.substr(0, name.find_last_of('.'));
+}
+
+int main(int argc, char* argv[])
+{
+	std::string capture = "profilerOutputs/session.prof";
+	std::string format = "json";
+	std::string output;
+	for (int i = 1; i < argc; i++)
+	{
+		const std::string arg = argv[i];
+		if (arg == "--help" || arg == "-h")
+		{
+			std::cout << ExportUsage();
+			return 0;
+		}
+		else if (arg.rfind("--format=", 0) == 0) format = arg.substr(9);
+		else if (arg.rfind("--output=", 0) == 0) output = arg.substr(9);
+		else if (arg.rfind("--", 0) == 0 || arg.empty())
+		{
+			std::cerr << "Unknown setting \"" << arg << "\"." << std::endl << ExportUsage();
+			return 1;
+		}
+		else capture = arg;
+	}
+	if (format != "json" && format != "perfetto" && format != "folded")
+	{
+		std::cerr << "Unknown format \"" << format << "\"." << std::endl << ExportUsage();
+		return 1;
+	}
+	if (output.empty()) output = ReplaceExtension(capture, format == "json" ? ".json" : format == "perfetto" ? ".perfetto-trace" : ".blocks.folded"); // Not the .folded the sampler writes next to the capture.
+
+	std::ifstream in(capture, std::ios::binary);
+	if (!in)
+	{
+		std::cerr << "Can't open \"" << capture << "\"." << std::endl;
+		return 1;
+	}
+	ProfileReader reader(in);
+	if (!reader.Open())
+	{
+		std::cerr << capture << ": " << reader.Error() << "." << std::endl;
+		return 1;
+	}
+	std::ofstream out(output, std::ios::binary | std::ios::trunc);
+	if (!out)
+	{
+		std::cerr << "Can't write \"" << output << "\"." << std::endl;
+		return 1;
+	}
+
+	std::unique_ptr<TraceWriter> writer;
+	if (format == "json") writer = std::make_unique<JsonTraceWriter>(out, capture);
+	else if (format == "perfetto") writer = std::make_unique<PerfettoTraceWriter>(out);
+	else writer = std::make_unique<FoldedTraceWriter>(out);
+
+	writer->Process(reader.Header().pid, FileStem(capture));
+	size_t threads = 0;
+	size_t records = 0;
+	ProfileThread thread;
+	while (reader.NextThread(thread))
+	{
+		threads++;
+		writer->Thread(thread.id, thread.name);
+		ProfileRecord record;
+		while (reader.NextRecord(record))
+		{
+			records++;
+			switch (record.Type())
+			{
+				case profiler::BlockType::Event: writer->Instant(record); break;
+				case profiler::BlockType::Value: writer->Value(record); break;
+				default: writer->Slice(record);
+			}
+		}
+	}
+	if (reader.Failed())
+	{
+		std::cerr << capture << ": " << reader.Error() << ", the trace stops there." << std::endl;
+	}
+	else if (!reader.Complete())
+	{
+		std::cerr << capture << " is truncated, the trace has everything up to where it stops." << std::endl;
+	}
+	if (!writer->Finish())
+	{
+		std::cerr << "Failed writing \"" << output << "\"." << std::endl;
+		return 1;
+	}
+	std::cout << "Wrote " << records << " records of " << threads << " threads to " << output << std::endl;
+	return reader.Failed() ? 1 : 0;
+}
@@ -1,2 +1,18 @@
 xcopy %~dp0\thirdparty\easy_profiler\bin\*.dll %~dp0\build\Application\bin\Release\. /y /i
-xcopy %~dp0\thirdparty\easy_profiler\bin\*.dll %~dp0\build\Application\bin\Debug\. /y /i
\ No newline at end of file
+xcopy %~dp0\thirdparty\easy_profiler\bin\*.dll %~dp0\build\Application\bin\Debug\. /y /i
+xcopy %~dp0\thirdparty\easy_profiler\bin\*.dll %~dp0\build\ScalingSweep\bin\Release\. /y /i
+xcopy %~dp0\thirdparty\easy_profiler\bin\*.dll %~dp0\build\ScalingSweep\bin\Debug\. /y /i
+xcopy %~dp0\thirdparty\easy_profiler\bin\*.dll %~dp0\build\Microbenchmarks\bin\Release\. /y /i
+xcopy %~dp0\thirdparty\easy_profiler\bin\*.dll %~dp0\build\Microbenchmarks\bin\Debug\. /y /i
+xcopy %~dp0\thirdparty\easy_profiler\bin\*.dll %~dp0\build\RegressionGate\bin\Release\. /y /i
+xcopy %~dp0\thirdparty\easy_profiler\bin\*.dll %~dp0\build\RegressionGate\bin\Debug\. /y /i
+xcopy %~dp0\thirdparty\easy_profiler\bin\*.dll %~dp0\build\InstrumentationOverhead\bin\Release\. /y /i
+xcopy %~dp0\thirdparty\easy_profiler\bin\*.dll %~dp0\build\InstrumentationOverhead\bin\Debug\. /y /i
+xcopy %~dp0\thirdparty\easy_profiler\bin\*.dll %~dp0\build\ProfileAnalyzer\bin\Release\. /y /i
+xcopy %~dp0\thirdparty\easy_profiler\bin\*.dll %~dp0\build\ProfileAnalyzer\bin\Debug\. /y /i
+xcopy %~dp0\thirdparty\easy_profiler\bin\*.dll %~dp0\build\ProfileDiff\bin\Release\. /y /i
+xcopy %~dp0\thirdparty\easy_profiler\bin\*.dll %~dp0\build\ProfileDiff\bin\Debug\. /y /i
+xcopy %~dp0\thirdparty\easy_profiler\bin\*.dll %~dp0\build\ProfileMerge\bin\Release\. /y /i
+xcopy %~dp0\thirdparty\easy_profiler\bin\*.dll %~dp0\build\ProfileMerge\bin\Debug\. /y /i
+xcopy %~dp0\thirdparty\easy_profiler\bin\*.dll %~dp0\build\CaptureClient\bin\Release\. /y /i
+xcopy %~dp0\thirdparty\easy_profiler\bin\*.dll %~dp0\build\CaptureClient\bin\Debug\. /y /i